@@ -43,6 +43,9 @@ static int init_stage_reg_writes = 1;
 
 unsigned int opl_sample_rate = 22050;
 
+opl_stats_t opl_stats;
+SDL_atomic_t opl_callback_defers;
+
 //
 // Init/shutdown code.
 //
@@ -506,3 +509,9 @@ void OPL_AdjustCallbacks(float value)
     }
 }
 
+void OPL_GetStats(opl_stats_t *stats)
+{
+    *stats = opl_stats;
+    stats->callback_defers = SDL_AtomicGet(&opl_callback_defers);
+}
+
@@ -149,5 +149,28 @@ void OPL_Delay(uint64_t us);
 
 void OPL_SetPaused(int paused);
 
+//
+// Statistics.
+//
+
+// Command queue and lock statistics of the software emulation driver,
+// which passes register writes and callback changes from other threads
+// to the mixing thread through a lock-free command queue.
+
+typedef struct
+{
+    unsigned int queue_size;        // Capacity of the command queue.
+    unsigned int queue_peak;        // Most commands waiting at once.
+    unsigned int queue_waits;       // Commands that waited for room.
+    unsigned int queue_drops;       // Commands dropped, queue stayed full.
+    unsigned int callback_defers;   // Mixes that left callbacks to OPL_Lock.
+    uint64_t lock_wait_us;          // Total time spent waiting in OPL_Lock.
+    uint64_t lock_max_us;           // Longest single wait in OPL_Lock.
+} opl_stats_t;
+
+// Get a copy of the statistics.
+
+void OPL_GetStats(opl_stats_t *stats);
+
 #endif
 
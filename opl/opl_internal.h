@@ -19,6 +19,8 @@
 #ifndef OPL_INTERNAL_H
 #define OPL_INTERNAL_H
 
+#include "SDL.h"
+
 #include "opl.h"
 
 typedef int (*opl_init_func)(unsigned int port_base);
@@ -54,6 +56,13 @@ typedef struct
 
 extern unsigned int opl_sample_rate;
 
+// Driver statistics. Every counter has a single writer: the mixing
+// thread only counts deferred callbacks, atomically; the game thread
+// counts everything else.
+
+extern opl_stats_t opl_stats;
+extern SDL_atomic_t opl_callback_defers;
+
 
 #if (defined(__i386__) || defined(__x86_64__)) && defined(HAVE_IOPERM)
 extern opl_driver_t opl_linux_driver;
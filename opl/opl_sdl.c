@@ -49,8 +49,82 @@ typedef struct
     uint64_t expire_time;     // Calculated time that timer will expire.
 } opl_timer_t;
 
+// Commands passed from the game thread to the mixing thread. Everything
+// the emulator and the callback queue hold is owned by the mixing thread;
+// other threads only ever append commands to a lock-free
+// single-producer/single-consumer ring. The timers are not part of the
+// emulator and belong to the game thread, see WriteTimerRegister.
+
+typedef enum
+{
+    CMD_WRITE_REGISTER,
+    CMD_SET_CALLBACK,
+    CMD_SET_PAUSED,
+    CMD_ADJUST_CALLBACKS,
+} opl_command_type_t;
+
+typedef struct
+{
+    opl_command_type_t type;
+
+    // Sample position at which the command takes effect.
+    uint64_t time;
+
+    unsigned int reg;
+    unsigned int value;
+
+    uint64_t us;
+    opl_callback_t callback;
+    void *data;
+    int generation;
+
+    float factor;
+} opl_command_t;
+
+#define COMMAND_RING_SIZE 1024
+
+static opl_command_t command_ring[COMMAND_RING_SIZE];
+
+// Number of commands ever written and read. Only the game thread
+// advances the head, only the mixing thread advances the tail.
+
+static SDL_atomic_t command_head;
+static SDL_atomic_t command_tail;
+
+// Longest time (in ms) to wait for room in a full ring.
+
+#define COMMAND_RING_WAIT 200
+
+// Mixing position, published by the mixing thread at every mix callback
+// so that commands can be timestamped. Guarded by a sequence counter:
+// odd while being written.
+
+static SDL_atomic_t clock_sequence;
+static uint64_t clock_position;     // Sample where the current slice ends
+static uint64_t clock_counter;      // Performance counter when published
+static unsigned int clock_slice;    // Length of the current slice
+
+// Samples generated so far, owned by the mixing thread.
+
+static uint64_t render_position;
+
+// Thread that runs the mixing callback.
+
+static SDL_threadID mix_thread;
+
+// OPL_ClearCallbacks only bumps this generation, callbacks set before it
+// are dropped by the mixing thread before any callback runs again.
+
+static SDL_atomic_t clear_generation;
+static int cleared_generation;
+
+// Set if OPL_Lock was held while callbacks were due, so they have
+// been left for the next mix callback.
+
+static int callbacks_deferred;
+
 // When the callback mutex is locked using OPL_Lock, callback functions
-// are not invoked.
+// are not invoked. The mixing thread never waits for it.
 
 static SDL_mutex *callback_mutex = NULL;
 
@@ -58,10 +132,6 @@ static SDL_mutex *callback_mutex = NULL;
 
 static opl_callback_queue_t *callback_queue;
 
-// Mutex used to control access to the callback queue.
-
-static SDL_mutex *callback_queue_mutex = NULL;
-
 // Current time, in us since startup:
 
 static uint64_t current_time;
@@ -84,11 +154,13 @@ static int opl_opl3mode;
 
 static uint8_t *mix_buffer = NULL;
 
-// Register number that was written.
+// Register number that was written, by the mixing thread and by others.
 
 static int register_num = 0;
+static int game_register_num = 0;
 
-// Timers; DBOPL does not do timer stuff itself.
+// Timers; DBOPL does not do timer stuff itself. Owned by the game
+// thread, their expiry is on the same clock commands are stamped with.
 
 static opl_timer_t timer1 = { 12500, 0, 0, 0 };
 static opl_timer_t timer2 = { 3125, 0, 0, 0 };
@@ -107,6 +179,22 @@ static int SDLIsInitialized(void)
     return Mix_QuerySpec(&freq, &format, &channels);
 }
 
+static void WriteRegister(unsigned int reg_num, unsigned int value);
+static int OnMixThread(void);
+
+// Drop callbacks set before the last OPL_ClearCallbacks.
+
+static void CheckClearedCallbacks(void)
+{
+    const int generation = SDL_AtomicGet(&clear_generation);
+
+    if (generation != cleared_generation)
+    {
+        OPL_Queue_Clear(callback_queue);
+        cleared_generation = generation;
+    }
+}
+
 // Advance time by the specified number of samples, invoking any
 // callback functions as appropriate.
 
@@ -116,8 +204,6 @@ static void AdvanceTime(unsigned int nsamples)
     void *callback_data;
     uint64_t us;
 
-    SDL_LockMutex(callback_queue_mutex);
-
     // Advance time.
 
     us = ((uint64_t) nsamples * OPL_SECOND) / mixing_freq;
@@ -128,36 +214,166 @@ static void AdvanceTime(unsigned int nsamples)
         pause_offset += us;
     }
 
+    if (callbacks_deferred || OPL_Queue_IsEmpty(callback_queue)
+     || current_time < OPL_Queue_Peek(callback_queue) + pause_offset)
+    {
+        return;
+    }
+
+    // Callbacks must not run while another thread holds OPL_Lock. Rather
+    // than waiting for it here, leave them for the next mix callback.
+
+    if (SDL_TryLockMutex(callback_mutex) != 0)
+    {
+        callbacks_deferred = 1;
+        SDL_AtomicAdd(&opl_callback_defers, 1);
+        return;
+    }
+
+    CheckClearedCallbacks();
+
     // Are there callbacks to invoke now?  Keep invoking them
-    // until there are no more left.
+    // until there are no more left. Callbacks run on this thread,
+    // so they schedule new callbacks directly.
 
     while (!OPL_Queue_IsEmpty(callback_queue)
         && current_time >= OPL_Queue_Peek(callback_queue) + pause_offset)
     {
-        // Pop the callback from the queue to invoke it.
-
         if (!OPL_Queue_Pop(callback_queue, &callback, &callback_data))
         {
             break;
         }
 
-        // The mutex stuff here is a bit complicated.  We must
-        // hold callback_mutex when we invoke the callback (so that
-        // the control thread can use OPL_Lock() to prevent callbacks
-        // from being invoked), but we must not be holding
-        // callback_queue_mutex, as the callback must be able to
-        // call OPL_SetCallback to schedule new callbacks.
+        callback(callback_data);
+    }
 
-        SDL_UnlockMutex(callback_queue_mutex);
+    SDL_UnlockMutex(callback_mutex);
+}
 
-        SDL_LockMutex(callback_mutex);
-        callback(callback_data);
-        SDL_UnlockMutex(callback_mutex);
+// Publish where the mixing thread is, for timestamping commands.
+
+static void PublishClock(unsigned int slice)
+{
+    SDL_AtomicIncRef(&clock_sequence);
+    clock_position = render_position + slice;
+    clock_counter = SDL_GetPerformanceCounter();
+    clock_slice = slice;
+    SDL_AtomicIncRef(&clock_sequence);
+}
+
+// Sample position for a command issued now. The mixing thread renders
+// one slice ahead, so commands land in the next slice at the same offset
+// they were issued at, which keeps their spacing sample accurate.
+
+static uint64_t CommandTime(void)
+{
+    uint64_t position, counter, elapsed;
+    unsigned int slice;
+    int sequence;
+
+    do
+    {
+        sequence = SDL_AtomicGet(&clock_sequence);
+        position = clock_position;
+        counter = clock_counter;
+        slice = clock_slice;
+    } while ((sequence & 1) != 0 || sequence != SDL_AtomicGet(&clock_sequence));
+
+    elapsed = ((SDL_GetPerformanceCounter() - counter) * mixing_freq)
+            / SDL_GetPerformanceFrequency();
+
+    return position + (elapsed < slice ? elapsed : slice);
+}
+
+// Append a command to the ring, called by the game thread only.
 
-        SDL_LockMutex(callback_queue_mutex);
+static void PushCommand(opl_command_t *command)
+{
+    const int head = SDL_AtomicGet(&command_head);
+    int waited = 0;
+    int pending;
+
+    command->time = CommandTime();
+
+    while (head - SDL_AtomicGet(&command_tail) >= COMMAND_RING_SIZE)
+    {
+        if (waited == 0)
+        {
+            ++opl_stats.queue_waits;
+        }
+
+        // The mixing thread has stalled, rather drop the command
+        // than hang the game.
+
+        if (waited >= COMMAND_RING_WAIT)
+        {
+            ++opl_stats.queue_drops;
+            return;
+        }
+
+        SDL_Delay(1);
+        ++waited;
     }
 
-    SDL_UnlockMutex(callback_queue_mutex);
+    command_ring[head % COMMAND_RING_SIZE] = *command;
+    SDL_AtomicSet(&command_head, head + 1);
+
+    pending = head + 1 - SDL_AtomicGet(&command_tail);
+
+    if (pending > (int) opl_stats.queue_peak)
+    {
+        opl_stats.queue_peak = pending;
+    }
+}
+
+// Apply every command that is due at the current position. Returns the
+// number of samples until the next one, or 0 if the ring is empty.
+
+static uint64_t RunCommands(void)
+{
+    const int head = SDL_AtomicGet(&command_head);
+    int tail = SDL_AtomicGet(&command_tail);
+
+    for (; tail != head; ++tail)
+    {
+        const opl_command_t *command = &command_ring[tail % COMMAND_RING_SIZE];
+
+        if (command->time > render_position)
+        {
+            SDL_AtomicSet(&command_tail, tail);
+            return command->time - render_position;
+        }
+
+        switch (command->type)
+        {
+            case CMD_WRITE_REGISTER:
+                WriteRegister(command->reg, command->value);
+                break;
+
+            case CMD_SET_CALLBACK:
+                // Callbacks set before the last clear are dropped.
+                if (command->generation == SDL_AtomicGet(&clear_generation))
+                {
+                    CheckClearedCallbacks();
+                    OPL_Queue_Push(callback_queue, command->callback,
+                                   command->data,
+                                   current_time - pause_offset + command->us);
+                }
+                break;
+
+            case CMD_SET_PAUSED:
+                opl_sdl_paused = command->value;
+                break;
+
+            case CMD_ADJUST_CALLBACKS:
+                OPL_Queue_AdjustCallbacks(callback_queue, current_time,
+                                          command->factor);
+                break;
+        }
+    }
+
+    SDL_AtomicSet(&command_tail, tail);
+    return 0;
 }
 
 // Call the OPL emulator code to fill the specified buffer.
@@ -188,18 +404,27 @@ static void OPL_Mix_Callback(int chan, void *stream, int len, void *udata)
     filled = 0;
     buffer_samples = len / 4;
 
+    mix_thread = SDL_ThreadID();
+    callbacks_deferred = 0;
+    PublishClock(buffer_samples);
+
     while (filled < buffer_samples)
     {
         uint64_t next_callback_time;
+        uint64_t next_command;
         uint64_t nsamples;
 
-        SDL_LockMutex(callback_queue_mutex);
+        // Apply commands from other threads that are due by now, and
+        // don't generate past the next one.
+
+        next_command = RunCommands();
 
         // Work out the time until the next callback waiting in
         // the callback queue must be invoked.  We can then fill the
         // buffer with this many samples.
 
-        if (opl_sdl_paused || OPL_Queue_IsEmpty(callback_queue))
+        if (opl_sdl_paused || callbacks_deferred
+         || OPL_Queue_IsEmpty(callback_queue))
         {
             nsamples = buffer_samples - filled;
         }
@@ -216,12 +441,16 @@ static void OPL_Mix_Callback(int chan, void *stream, int len, void *udata)
             }
         }
 
-        SDL_UnlockMutex(callback_queue_mutex);
+        if (next_command != 0 && nsamples > next_command)
+        {
+            nsamples = next_command;
+        }
 
         // Add emulator output to buffer.
 
         FillBuffer(buffer + filled * 4, nsamples);
         filled += nsamples;
+        render_position += nsamples;
 
         // Invoke callbacks for this point in time.
 
@@ -255,12 +484,6 @@ static void OPL_SDL_Shutdown(void)
         SDL_DestroyMutex(callback_mutex);
         callback_mutex = NULL;
     }
-
-    if (callback_queue_mutex != NULL)
-    {
-        SDL_DestroyMutex(callback_queue_mutex);
-        callback_queue_mutex = NULL;
-    }
 }
 
 static unsigned int GetSliceSize(void)
@@ -328,6 +551,20 @@ static int OPL_SDL_Init(unsigned int port_base)
     callback_queue = OPL_Queue_Create();
     current_time = 0;
 
+    // Nothing has been mixed yet; commands wait in the ring until
+    // the first mix callback.
+
+    render_position = 0;
+    mix_thread = 0;
+    clock_position = 0;
+    clock_counter = SDL_GetPerformanceCounter();
+    clock_slice = 0;
+    SDL_AtomicSet(&command_head, 0);
+    SDL_AtomicSet(&command_tail, 0);
+    SDL_AtomicSet(&clear_generation, 0);
+    cleared_generation = 0;
+    opl_stats.queue_size = COMMAND_RING_SIZE;
+
     // Get the mixer frequency, format and number of channels.
 
     Mix_QuerySpec(&mixing_freq, &mixing_format, &mixing_channels);
@@ -353,7 +590,6 @@ static int OPL_SDL_Init(unsigned int port_base)
     opl_opl3mode = 0;
 
     callback_mutex = SDL_CreateMutex();
-    callback_queue_mutex = SDL_CreateMutex();
 
     // Set postmix that adds the OPL music. This is deliberately done
     // as a postmix and not using Mix_HookMusic() as the latter disables
@@ -363,22 +599,40 @@ static int OPL_SDL_Init(unsigned int port_base)
     return 1;
 }
 
+// Current time on the clock commands are stamped with, in us.
+
+static uint64_t TimerTime(void)
+{
+    return (CommandTime() * OPL_SECOND) / mixing_freq;
+}
+
 static unsigned int OPL_SDL_PortRead(opl_port_t port)
 {
     unsigned int result = 0;
+    uint64_t now;
 
     if (port == OPL_REGISTER_PORT_OPL3)
     {
         return 0xff;
     }
 
-    if (timer1.enabled && current_time > timer1.expire_time)
+    // Status reads by callbacks only serve as delays, and the timers
+    // belong to the game thread.
+
+    if ((!timer1.enabled && !timer2.enabled) || OnMixThread())
+    {
+        return result;
+    }
+
+    now = TimerTime();
+
+    if (timer1.enabled && now > timer1.expire_time)
     {
         result |= 0x80;   // Either have expired
         result |= 0x40;   // Timer 1 has expired
     }
 
-    if (timer2.enabled && current_time > timer2.expire_time)
+    if (timer2.enabled && now > timer2.expire_time)
     {
         result |= 0x80;   // Either have expired
         result |= 0x20;   // Timer 2 has expired
@@ -387,7 +641,7 @@ static unsigned int OPL_SDL_PortRead(opl_port_t port)
     return result;
 }
 
-static void OPLTimer_CalculateEndTime(opl_timer_t *timer)
+static void OPLTimer_CalculateEndTime(opl_timer_t *timer, uint64_t now)
 {
     int tics;
 
@@ -397,24 +651,28 @@ static void OPLTimer_CalculateEndTime(opl_timer_t *timer)
     if (timer->enabled)
     {
         tics = 0x100 - timer->value;
-        timer->expire_time = current_time
+        timer->expire_time = now
                            + ((uint64_t) tics * OPL_SECOND) / timer->rate;
     }
 }
 
-static void WriteRegister(unsigned int reg_num, unsigned int value)
+// Timer registers are applied right away by the game thread, so that
+// status reads see them at once, e.g. during OPL_Detect. Returns false
+// for any other register, which goes to the emulator.
+
+static int WriteTimerRegister(unsigned int reg_num, unsigned int value)
 {
     switch (reg_num)
     {
         case OPL_REG_TIMER1:
             timer1.value = value;
-            OPLTimer_CalculateEndTime(&timer1);
-            break;
+            OPLTimer_CalculateEndTime(&timer1, TimerTime());
+            return 1;
 
         case OPL_REG_TIMER2:
             timer2.value = value;
-            OPLTimer_CalculateEndTime(&timer2);
-            break;
+            OPLTimer_CalculateEndTime(&timer2, TimerTime());
+            return 1;
 
         case OPL_REG_TIMER_CTRL:
             if (value & 0x80)
@@ -424,65 +682,126 @@ static void WriteRegister(unsigned int reg_num, unsigned int value)
             }
             else
             {
+                const uint64_t now = TimerTime();
+
                 if ((value & 0x40) == 0)
                 {
                     timer1.enabled = (value & 0x01) != 0;
-                    OPLTimer_CalculateEndTime(&timer1);
+                    OPLTimer_CalculateEndTime(&timer1, now);
                 }
 
                 if ((value & 0x20) == 0)
                 {
                     timer2.enabled = (value & 0x02) != 0;
-                    OPLTimer_CalculateEndTime(&timer2);
+                    OPLTimer_CalculateEndTime(&timer2, now);
                 }
             }
-
-            break;
-
-        case OPL_REG_NEW:
-            opl_opl3mode = value & 0x01;
+            return 1;
 
         default:
-            OPL3_WriteRegBuffered(&opl_chip, reg_num, value);
-            break;
+            return 0;
     }
 }
 
+static void WriteRegister(unsigned int reg_num, unsigned int value)
+{
+    if (reg_num == OPL_REG_NEW)
+    {
+        opl_opl3mode = value & 0x01;
+    }
+
+    OPL3_WriteRegBuffered(&opl_chip, reg_num, value);
+}
+
+// Commands from the mixing thread itself, i.e. from callbacks, are
+// applied right away. Anything else goes through the command ring.
+
+static int OnMixThread(void)
+{
+    return mix_thread != 0 && SDL_ThreadID() == mix_thread;
+}
+
 static void OPL_SDL_PortWrite(opl_port_t port, unsigned int value)
 {
+    const int mixing = OnMixThread();
+    int *reg = mixing ? &register_num : &game_register_num;
+
     if (port == OPL_REGISTER_PORT)
     {
-        register_num = value;
+        *reg = value;
     }
     else if (port == OPL_REGISTER_PORT_OPL3)
     {
-        register_num = value | 0x100;
+        *reg = value | 0x100;
     }
     else if (port == OPL_DATA_PORT)
     {
-        WriteRegister(register_num, value);
+        if (mixing)
+        {
+            // The timers belong to the game thread, the emulator
+            // itself ignores their registers.
+            WriteRegister(*reg, value);
+        }
+        else if (!WriteTimerRegister(*reg, value))
+        {
+            opl_command_t command;
+
+            command.type = CMD_WRITE_REGISTER;
+            command.reg = *reg;
+            command.value = value;
+            PushCommand(&command);
+        }
     }
 }
 
 static void OPL_SDL_SetCallback(uint64_t us, opl_callback_t callback,
                                 void *data)
 {
-    SDL_LockMutex(callback_queue_mutex);
-    OPL_Queue_Push(callback_queue, callback, data,
-                   current_time - pause_offset + us);
-    SDL_UnlockMutex(callback_queue_mutex);
+    if (OnMixThread())
+    {
+        OPL_Queue_Push(callback_queue, callback, data,
+                       current_time - pause_offset + us);
+    }
+    else
+    {
+        opl_command_t command;
+
+        command.type = CMD_SET_CALLBACK;
+        command.us = us;
+        command.callback = callback;
+        command.data = data;
+        command.generation = SDL_AtomicGet(&clear_generation);
+        PushCommand(&command);
+    }
 }
 
 static void OPL_SDL_ClearCallbacks(void)
 {
-    SDL_LockMutex(callback_queue_mutex);
-    OPL_Queue_Clear(callback_queue);
-    SDL_UnlockMutex(callback_queue_mutex);
+    if (OnMixThread())
+    {
+        OPL_Queue_Clear(callback_queue);
+    }
+    else
+    {
+        SDL_AtomicIncRef(&clear_generation);
+    }
 }
 
 static void OPL_SDL_Lock(void)
 {
+    const uint64_t start = SDL_GetPerformanceCounter();
+    uint64_t wait;
+
     SDL_LockMutex(callback_mutex);
+
+    wait = ((SDL_GetPerformanceCounter() - start) * OPL_SECOND)
+         / SDL_GetPerformanceFrequency();
+    opl_stats.lock_wait_us += wait;
+
+    if (wait > opl_stats.lock_max_us)
+    {
+        opl_stats.lock_max_us = wait;
+    }
 }
 
 static void OPL_SDL_Unlock(void)
@@ -492,14 +811,34 @@ static void OPL_SDL_Unlock(void)
 
 static void OPL_SDL_SetPaused(int paused)
 {
-    opl_sdl_paused = paused;
+    if (OnMixThread())
+    {
+        opl_sdl_paused = paused;
+    }
+    else
+    {
+        opl_command_t command;
+
+        command.type = CMD_SET_PAUSED;
+        command.value = paused;
+        PushCommand(&command);
+    }
 }
 
 static void OPL_SDL_AdjustCallbacks(float factor)
 {
-    SDL_LockMutex(callback_queue_mutex);
-    OPL_Queue_AdjustCallbacks(callback_queue, current_time, factor);
-    SDL_UnlockMutex(callback_queue_mutex);
+    if (OnMixThread())
+    {
+        OPL_Queue_AdjustCallbacks(callback_queue, current_time, factor);
+    }
+    else
+    {
+        opl_command_t command;
+
+        command.type = CMD_ADJUST_CALLBACKS;
+        command.factor = factor;
+        PushCommand(&command);
+    }
 }
 
 opl_driver_t opl_sdl_driver =
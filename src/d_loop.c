@@ -88,6 +88,13 @@ int realleveltime;
 
 boolean singletics = false;
 
+// [JN] Set by the game while fast-forward is requested. In single player
+// games, every ticcmd built is then run turbotics times in a row, so the
+// playsim advances several tics for every frame drawn.
+
+boolean turbo = false;
+static int turbotics = 4;
+
 // Index of the local player.
 
 static int localplayer;
@@ -145,6 +152,26 @@ static int GetAdjustedTime(void)
     return (time_ms * TICRATE) / 1000;
 }
 
+// [JN] Clear out the values that must not be repeated by the copies of
+// a ticcmd made in fast-forward mode. View turning stays at real time
+// speed, so mouse look isn't multiplied by the number of copies.
+
+static void TurboSquash(ticcmd_t *cmd)
+{
+    cmd->chatchar = 0;
+    cmd->angleturn = 0;
+    cmd->lookfly = 0;
+    cmd->arti = 0;
+
+    if (cmd->buttons & BT_SPECIAL)
+        cmd->buttons = 0;
+}
+
+boolean D_TurboActive(void)
+{
+    return turbo && !net_client_connected && !singletics;
+}
+
 static boolean BuildNewTic(void)
 {
     int	gameticdiv;
@@ -199,6 +226,19 @@ static boolean BuildNewTic(void)
 
     ++maketic;
 
+    // [JN] Fast-forward: follow the ticcmd by its copies.
+    if (D_TurboActive())
+    {
+        TurboSquash(&cmd);
+
+        for (int i = 1; i < turbotics; i++)
+        {
+            ticdata[maketic % BACKUPTICS].cmds[localplayer] = cmd;
+            ticdata[maketic % BACKUPTICS].ingame[localplayer] = true;
+            ++maketic;
+        }
+    }
+
     return true;
 }
 
@@ -310,7 +350,24 @@ void D_ReceiveTic(ticcmd_t *ticcmds, boolean *players_mask)
 
 void D_StartGameLoop(void)
 {
+    int i;
+
     lasttime = GetAdjustedTime() / ticdup;
+
+    //!
+    // @arg <n>
+    // @category game
+    //
+    // Run n tics for every tic while the fast-forward key is held in a
+    // single player game, from 2 to 16. The default is 4.
+    //
+
+    i = M_CheckParmWithArgs("-ffspeed", 1);
+
+    if (i > 0)
+    {
+        turbotics = BETWEEN(2, 16, atoi(myargv[i+1]));
+    }
 }
 
 //
@@ -728,7 +785,12 @@ void TryRunTics (void)
 
     if (new_sync)
     {
-        if (vid_uncapped_fps)
+        // [JN] Fast-forward: run the whole batch, then draw a single frame.
+        if (D_TurboActive())
+        {
+            counts = availabletics;
+        }
+        else if (vid_uncapped_fps)
         {
             // decide how many tics to run
             if (realtics < availabletics-1)
@@ -78,10 +78,15 @@ void D_StartNetGame(net_gamesettings_t *settings,
                     netgame_startup_callback_t callback);
 
 extern boolean singletics;
+extern boolean turbo;   // [JN] Fast-forward requested by the game.
 extern int gametic, ticdup;
 extern int oldgametic;   // [JN] Invoke certain actions independently from uncapped framerate.
 extern int oldleveltime; // [crispy] check if leveltime keeps tickin'
 
+// [JN] Check if fast-forward is in effect, i.e. requested in a game
+// that is neither networked nor run with -timedemo.
+boolean D_TurboActive(void);
+
 // Check if it is permitted to record a demo with a non-vanilla feature.
 boolean D_NonVanillaRecord(boolean conditional, const char *feature);
 
@@ -19,6 +19,9 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "deh_main.h"
 #include "z_zone.h"
 #include "st_bar.h"
@@ -169,7 +172,7 @@ typedef struct
 
 typedef struct
 {
-    mline_t l;
+    int line;
     int color;
 } am_line_t;
 
@@ -718,6 +721,8 @@ void AM_LevelInit (boolean reinit)
 {
     static int f_h_old;
 
+    AM_clearWallGrid();
+
     f_x = f_y = 0;
     f_w = SCREENWIDTH;
     f_h = SCREENHEIGHT - (ST_HEIGHT * vid_resolution);
@@ -1646,17 +1651,269 @@ static void AM_drawGrid (void)
 }
 
 // -----------------------------------------------------------------------------
-// AM_drawWalls
-// Determines visible lines, draws them. 
-// This is LineDef based, not LineSeg based.
+// [JN] Automap wall culling and caching.
+//
+// Lines are binned into a grid of map blocks, built once per level from
+// the line vertices (not from the BLOCKMAP lump, which may be rebuilt,
+// clipped to 16 bits or deliberately miss lines on some maps). Each frame
+// only lines from blocks overlapping the visible window are considered,
+// in ascending line order, so drawing order (and thus the output) is
+// the same as when walking all lines.
+//
+// Transformed and clipped lines are cached per line and reused as long
+// as position, scale, rotation and window size stay the same, e.g. when
+// the map is not following the player or the player is standing still.
 // -----------------------------------------------------------------------------
 
-static void AM_drawWalls (void)
+typedef struct
+{
+    unsigned int stamp;     // am_wallstamp when fl was computed
+    boolean      visible;   // fl is on screen
+    fline_t      fl;
+} am_wall_t;
+
+// Everything the transformation and clipping of a line depends on.
+typedef struct
+{
+    int64_t  m_x, m_y, m_w, m_h;
+    int64_t  cx, cy;
+    fixed_t  scale;
+    angle_t  angle;
+    int      f_x, f_y, f_w, f_h;
+    int      rotate, aspect;
+} am_view_t;
+
+static am_wall_t   *am_walls;
+static unsigned int am_wallstamp;
+static am_view_t    am_lastview;
+
+static int  *am_gridlines;      // line numbers per block, back to back
+static int  *am_gridstart;      // first entry of each block, size + 1
+static int   am_gridwidth, am_gridheight;
+static int64_t am_gridorgx, am_gridorgy;
+static boolean am_gridvalid;     // cleared at every level load
+
+static int  *am_visible;        // visible lines for this frame
+static int   am_numvisible;
+static unsigned int *am_visiblemark;
+static unsigned int  am_visiblestamp;
+
+#define AM_GRIDSHIFT (MAPBLOCKSHIFT - FRACTOMAPBITS)
+
+static void AM_buildWallGrid (void)
+{
+    int64_t minx = INT64_MAX, miny = INT64_MAX;
+    int64_t maxx = INT64_MIN, maxy = INT64_MIN;
+    int total = 0;
+
+    for (int i = 0 ; i < numvertexes ; i++)
+    {
+        const int64_t x = vertexes[i].x >> FRACTOMAPBITS;
+        const int64_t y = vertexes[i].y >> FRACTOMAPBITS;
+
+        minx = MIN(minx, x);  maxx = MAX(maxx, x);
+        miny = MIN(miny, y);  maxy = MAX(maxy, y);
+    }
+
+    if (numvertexes == 0)
+    {
+        minx = miny = maxx = maxy = 0;
+    }
+
+    am_gridorgx = minx;
+    am_gridorgy = miny;
+    am_gridwidth = (int)((maxx - minx) >> AM_GRIDSHIFT) + 1;
+    am_gridheight = (int)((maxy - miny) >> AM_GRIDSHIFT) + 1;
+
+    am_gridstart = I_Realloc(am_gridstart, (am_gridwidth * am_gridheight + 1) * sizeof(*am_gridstart));
+    memset(am_gridstart, 0, (am_gridwidth * am_gridheight + 1) * sizeof(*am_gridstart));
+
+    // Count lines per block, then turn counts into offsets.
+    for (int pass = 0 ; pass < 2 ; pass++)
+    {
+        for (int i = 0 ; i < numlines ; i++)
+        {
+            const int64_t ax = lines[i].v1->x >> FRACTOMAPBITS, ay = lines[i].v1->y >> FRACTOMAPBITS;
+            const int64_t bx = lines[i].v2->x >> FRACTOMAPBITS, by = lines[i].v2->y >> FRACTOMAPBITS;
+            const int x1 = (int)((MIN(ax, bx) - am_gridorgx) >> AM_GRIDSHIFT);
+            const int x2 = (int)((MAX(ax, bx) - am_gridorgx) >> AM_GRIDSHIFT);
+            const int y1 = (int)((MIN(ay, by) - am_gridorgy) >> AM_GRIDSHIFT);
+            const int y2 = (int)((MAX(ay, by) - am_gridorgy) >> AM_GRIDSHIFT);
+
+            for (int y = y1 ; y <= y2 ; y++)
+            {
+                for (int x = x1 ; x <= x2 ; x++)
+                {
+                    if (pass == 0)
+                    {
+                        am_gridstart[y * am_gridwidth + x]++;
+                    }
+                    else
+                    {
+                        am_gridlines[--am_gridstart[y * am_gridwidth + x]] = i;
+                    }
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (int b = 0 ; b <= am_gridwidth * am_gridheight ; b++)
+            {
+                total += am_gridstart[b];
+                am_gridstart[b] = total;
+            }
+            am_gridlines = I_Realloc(am_gridlines, MAX(total, 1) * sizeof(*am_gridlines));
+        }
+    }
+
+    am_walls = I_Realloc(am_walls, MAX(numlines, 1) * sizeof(*am_walls));
+    memset(am_walls, 0, MAX(numlines, 1) * sizeof(*am_walls));
+    am_visible = I_Realloc(am_visible, MAX(numlines, 1) * sizeof(*am_visible));
+    am_visiblemark = I_Realloc(am_visiblemark, MAX(numlines, 1) * sizeof(*am_visiblemark));
+    memset(am_visiblemark, 0, MAX(numlines, 1) * sizeof(*am_visiblemark));
+
+    am_gridvalid = true;
+    am_wallstamp++;
+}
+
+// -----------------------------------------------------------------------------
+// AM_clearWallGrid
+// [JN] Drops the wall grid so the next automap frame rebuilds it from the
+// current level's lines. Called from P_SetupLevel and AM_LevelInit.
+// -----------------------------------------------------------------------------
+
+void AM_clearWallGrid (void)
+{
+    am_gridvalid = false;
+}
+
+static int AM_cmpLines (const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+// Fills am_visible with lines that can be on screen, in ascending order,
+// and invalidates the cache if the view has changed.
+
+static void AM_cullWalls (void)
 {
-    static mline_t l;
+    am_view_t view;
+    int64_t minx, miny, maxx, maxy;
+    int bx1, bx2, by1, by2;
+
+    if (!am_gridvalid)
+    {
+        AM_buildWallGrid();
+    }
+
+    memset(&view, 0, sizeof(view));
+    view.m_x = m_x;  view.m_y = m_y;
+    view.m_w = m_w;  view.m_h = m_h;
+    view.cx = mapcenter.x;  view.cy = mapcenter.y;
+    view.scale = scale_mtof;
+    view.f_x = f_x;  view.f_y = f_y;
+    view.f_w = f_w;  view.f_h = f_h;
+    view.rotate = automap_rotate;
+    view.aspect = ADJUST_ASPECT_RATIO;
+    if (automap_rotate)
+    {
+        view.angle = followplayer || !automap_overlay ? ANG90 - viewangle : mapangle;
+    }
 
-    for (int i = 0 ; i < numlines ; i++)
+    if (memcmp(&view, &am_lastview, sizeof(view)))
     {
+        am_lastview = view;
+        am_wallstamp++;
+    }
+
+    // Map area that can end up in the window: undo aspect
+    // correction, then take the circle around the rotation center.
+    minx = m_x;  maxx = m_x2;
+    miny = m_y;  maxy = m_y2;
+
+    if (ADJUST_ASPECT_RATIO)
+    {
+        miny = mapcenter.y + 6 * (miny - mapcenter.y) / 5;
+        maxy = mapcenter.y + 6 * (maxy - mapcenter.y) / 5;
+    }
+    if (automap_rotate)
+    {
+        const int64_t dx = MAX(mapcenter.x - minx, maxx - mapcenter.x);
+        const int64_t dy = MAX(mapcenter.y - miny, maxy - mapcenter.y);
+        const int64_t r = (int64_t)sqrt((double)dx * dx + (double)dy * dy) + 1;
+
+        minx = mapcenter.x - r;  maxx = mapcenter.x + r;
+        miny = mapcenter.y - r;  maxy = mapcenter.y + r;
+    }
+
+    // Leave room for rounding in AM_transformPoint.
+    minx -= FRACUNIT >> FRACTOMAPBITS;  maxx += FRACUNIT >> FRACTOMAPBITS;
+    miny -= FRACUNIT >> FRACTOMAPBITS;  maxy += FRACUNIT >> FRACTOMAPBITS;
+
+    bx1 = (int)BETWEEN(0, am_gridwidth - 1, (minx - am_gridorgx) >> AM_GRIDSHIFT);
+    bx2 = (int)BETWEEN(0, am_gridwidth - 1, (maxx - am_gridorgx) >> AM_GRIDSHIFT);
+    by1 = (int)BETWEEN(0, am_gridheight - 1, (miny - am_gridorgy) >> AM_GRIDSHIFT);
+    by2 = (int)BETWEEN(0, am_gridheight - 1, (maxy - am_gridorgy) >> AM_GRIDSHIFT);
+
+    am_numvisible = 0;
+
+    // Window outside the map.
+    if (maxx < am_gridorgx || maxy < am_gridorgy
+    ||  minx >= am_gridorgx + ((int64_t)am_gridwidth << AM_GRIDSHIFT)
+    ||  miny >= am_gridorgy + ((int64_t)am_gridheight << AM_GRIDSHIFT))
+    {
+        return;
+    }
+
+    // Zoomed out over most of the map, just take every line.
+    if ((int64_t)(bx2 - bx1 + 1) * (by2 - by1 + 1) * 2 >= (int64_t)am_gridwidth * am_gridheight)
+    {
+        for (int i = 0 ; i < numlines ; i++)
+        {
+            am_visible[am_numvisible++] = i;
+        }
+        return;
+    }
+
+    am_visiblestamp++;
+
+    for (int by = by1 ; by <= by2 ; by++)
+    {
+        for (int bx = bx1 ; bx <= bx2 ; bx++)
+        {
+            const int b = by * am_gridwidth + bx;
+
+            for (int j = am_gridstart[b] ; j < am_gridstart[b + 1] ; j++)
+            {
+                const int i = am_gridlines[j];
+
+                if (am_visiblemark[i] != am_visiblestamp)
+                {
+                    am_visiblemark[i] = am_visiblestamp;
+                    am_visible[am_numvisible++] = i;
+                }
+            }
+        }
+    }
+
+    qsort(am_visible, am_numvisible, sizeof(*am_visible), AM_cmpLines);
+}
+
+// -----------------------------------------------------------------------------
+// AM_drawWall
+// Draws a line from AM_cullWalls, transforming and clipping it first
+// if the cached result is out of date.
+// -----------------------------------------------------------------------------
+
+static void AM_drawWall (int i, int color)
+{
+    am_wall_t *const wall = &am_walls[i];
+
+    if (wall->stamp != am_wallstamp)
+    {
+        mline_t l;
+
         l.a.x = lines[i].v1->x >> FRACTOMAPBITS;
         l.a.y = lines[i].v1->y >> FRACTOMAPBITS;
         l.b.x = lines[i].v2->x >> FRACTOMAPBITS;
@@ -1664,6 +1921,30 @@ static void AM_drawWalls (void)
         AM_transformPoint(&l.a);
         AM_transformPoint(&l.b);
 
+        wall->visible = AM_clipMline(&l, &wall->fl);
+        wall->stamp = am_wallstamp;
+    }
+
+    if (wall->visible)
+    {
+        AM_drawFline(&wall->fl, color);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// AM_drawWalls
+// Determines visible lines, draws them. 
+// This is LineDef based, not LineSeg based.
+// -----------------------------------------------------------------------------
+
+static void AM_drawWalls (void)
+{
+    AM_cullWalls();
+
+    for (int n = 0 ; n < am_numvisible ; n++)
+    {
+        const int i = am_visible[n];
+
         if (iddt_cheating || (lines[i].flags & ML_MAPPED))
         {
             if ((lines[i].flags & ML_DONTDRAW) && !iddt_cheating)
@@ -1684,16 +1965,16 @@ static void AM_drawWalls (void)
                             // [JN] Highlight secret sectors
                             if (automap_secrets > 1 && lines[i].frontsector->special == 9)
                             {
-                                array_push(lines_1S, ((am_line_t){l, secretwallcolors}));
+                                array_push(lines_1S, ((am_line_t){i, secretwallcolors}));
                             }
                             // [plums] show revealed secrets
                             else if (automap_secrets && lines[i].frontsector->oldspecial == 9)
                             {
-                                array_push(lines_1S, ((am_line_t){l, foundsecretwallcolors}));
+                                array_push(lines_1S, ((am_line_t){i, foundsecretwallcolors}));
                             }
                             else
                             {
-                                array_push(lines_1S, ((am_line_t){l, boom_23}));
+                                array_push(lines_1S, ((am_line_t){i, boom_23}));
                             }
                         }
                         else
@@ -1702,47 +1983,47 @@ static void AM_drawWalls (void)
                             if (lines[i].special == 39  || lines[i].special == 97
                             ||  lines[i].special == 125 || lines[i].special == 126)
                             {
-                                AM_drawMline(&l, boom_119);
+                                AM_drawWall(i, boom_119);
                             }
                             // Secret door
                             else if (lines[i].flags & ML_SECRET)
                             {
-                                AM_drawMline(&l, boom_23);      // wall color
+                                AM_drawWall(i, boom_23);      // wall color
                             }
                             // [JN] Highlight secret sectors
                             else if (automap_secrets > 1
                             && (lines[i].frontsector->special == 9
                             ||  lines[i].backsector->special == 9))
                             {
-                                AM_drawMline(&l, secretwallcolors);
+                                AM_drawWall(i, secretwallcolors);
                             }
                             // [plums] show revealed secrets
                             else if (automap_secrets
                             && (lines[i].frontsector->oldspecial == 9
                             ||  lines[i].backsector->oldspecial == 9))
                             {
-                                AM_drawMline(&l, foundsecretwallcolors);
+                                AM_drawWall(i, foundsecretwallcolors);
                             }
                             // BLUE locked doors
                             else
                             if (lines[i].special == 26 || lines[i].special == 32
                             ||  lines[i].special == 99 || lines[i].special == 133)
                             {
-                                AM_drawMline(&l, boom_204);
+                                AM_drawWall(i, boom_204);
                             }
                             // RED locked doors
                             else
                             if (lines[i].special == 28  || lines[i].special == 33
                             ||  lines[i].special == 134 || lines[i].special == 135)
                             {
-                                AM_drawMline(&l, boom_175);
+                                AM_drawWall(i, boom_175);
                             }
                             // YELLOW locked doors
                             else
                             if (lines[i].special == 27  || lines[i].special == 34
                             ||  lines[i].special == 136 || lines[i].special == 137)
                             {
-                                AM_drawMline(&l, doom_231);
+                                AM_drawWall(i, doom_231);
                             }
                             // non-secret closed door
                             else
@@ -1750,31 +2031,31 @@ static void AM_drawWalls (void)
                             ((lines[i].backsector->floorheight == lines[i].backsector->ceilingheight) ||
                             (lines[i].frontsector->floorheight == lines[i].frontsector->ceilingheight)))
                             {
-                                AM_drawMline(&l, boom_208);      // non-secret closed door
+                                AM_drawWall(i, boom_208);      // non-secret closed door
                             } //jff 1/6/98 show secret sector 2S lines
                             // floor level change
                             else
                             if (lines[i].backsector->floorheight != lines[i].frontsector->floorheight)
                             {
-                                AM_drawMline(&l, boom_55);
+                                AM_drawWall(i, boom_55);
                             }
                             // ceiling level change
                             else
                             if (lines[i].backsector->ceilingheight != lines[i].frontsector->ceilingheight)
                             {
-                                AM_drawMline(&l, boom_215);
+                                AM_drawWall(i, boom_215);
                             }
                             //2S lines that appear only in IDDT
                             else if (iddt_cheating)
                             {
-                                AM_drawMline(&l, boom_88);
+                                AM_drawWall(i, boom_88);
                             }
                         }
                         // [JN] Exit (can be one-sided or two-sided)
                         if (lines[i].special == 11 || lines[i].special == 51
                         ||  lines[i].special == 52 || lines[i].special == 124)
                         {
-                            array_push(lines_1S, ((am_line_t){l, exitcolors}));
+                            array_push(lines_1S, ((am_line_t){i, exitcolors}));
                         }
                     }
                     // computermap visible lines
@@ -1787,7 +2068,7 @@ static void AM_drawWalls (void)
                             || lines[i].backsector->floorheight != lines[i].frontsector->floorheight
                             || lines[i].backsector->ceilingheight != lines[i].frontsector->ceilingheight)
                             {
-                                AM_drawMline(&l, doom_104);
+                                AM_drawWall(i, doom_104);
                             }
                         }
                     }
@@ -1805,16 +2086,16 @@ static void AM_drawWalls (void)
                             // [JN] Highlight secret sectors
                             if (automap_secrets > 1 && lines[i].frontsector->special == 9)
                             {    
-                                array_push(lines_1S, ((am_line_t){l, secretwallcolors}));
+                                array_push(lines_1S, ((am_line_t){i, secretwallcolors}));
                             }
                             // [plums] show revealed secrets
                             else if (automap_secrets && lines[i].frontsector->oldspecial == 9)
                             {
-                                array_push(lines_1S, ((am_line_t){l, foundsecretwallcolors}));
+                                array_push(lines_1S, ((am_line_t){i, foundsecretwallcolors}));
                             }
                             else
                             {
-                                array_push(lines_1S, ((am_line_t){l, doom_184}));
+                                array_push(lines_1S, ((am_line_t){i, doom_184}));
                             }
                         }
                         else
@@ -1822,84 +2103,84 @@ static void AM_drawWalls (void)
                             // [JN] Secret door
                             if (lines[i].flags & ML_SECRET)
                             {
-                                AM_drawMline(&l, doom_184);
+                                AM_drawWall(i, doom_184);
                             }
                             // [JN] Highlight secret sectors
                             else if (automap_secrets > 1
                             && (lines[i].frontsector->special == 9
                             ||  lines[i].backsector->special == 9))
                             {
-                                AM_drawMline(&l, secretwallcolors);
+                                AM_drawWall(i, secretwallcolors);
                             }
                             // [plums] show revealed secrets
                             else if (automap_secrets
                             && (lines[i].frontsector->oldspecial == 9
                             ||  lines[i].backsector->oldspecial == 9))
                             {
-                                AM_drawMline(&l, foundsecretwallcolors);
+                                AM_drawWall(i, foundsecretwallcolors);
                             }
                             // [JN] Various Doors
                             else
                             if (lines[i].special == 1   || lines[i].special == 31
                             ||  lines[i].special == 117 || lines[i].special == 118)
                             {
-                                AM_drawMline(&l, remaster_81);
+                                AM_drawWall(i, remaster_81);
                             }
                             // [JN] Various teleporters
                             else
                             if (lines[i].special == 39  || lines[i].special == 97
                             ||  lines[i].special == 125 || lines[i].special == 126)
                             {
-                                AM_drawMline(&l, remaster_120);
+                                AM_drawWall(i, remaster_120);
                             }
                             // [JN] BLUE locked doors
                             else
                             if (lines[i].special == 26 || lines[i].special == 32
                             ||  lines[i].special == 99 || lines[i].special == 133)
                             {
-                                AM_drawMline(&l, remaster_200);
+                                AM_drawWall(i, remaster_200);
                             }
                             // [JN] RED locked doors
                             else
                             if (lines[i].special == 28  || lines[i].special == 33
                             ||  lines[i].special == 134 || lines[i].special == 135)
                             {
-                                AM_drawMline(&l, doom_176);
+                                AM_drawWall(i, doom_176);
                             }
                             // [JN] YELLOW locked doors
                             else
                             if (lines[i].special == 27  || lines[i].special == 34
                             ||  lines[i].special == 136 || lines[i].special == 137)
                             {
-                                AM_drawMline(&l, remaster_160);
+                                AM_drawWall(i, remaster_160);
                             }
                             // [JN] Floor level change
                             else if (lines[i].backsector->floorheight != lines[i].frontsector->floorheight) 
                             {
-                                AM_drawMline(&l, remaster_72);
+                                AM_drawWall(i, remaster_72);
                             }
                             // [JN] Ceiling level change
                             else if (lines[i].backsector->ceilingheight != lines[i].frontsector->ceilingheight) 
                             {
-                                AM_drawMline(&l, doom_64);
+                                AM_drawWall(i, doom_64);
                             }
                             // [JN] IDDT visible lines
                             else if (iddt_cheating)
                             {
-                                AM_drawMline(&l, doom_96);
+                                AM_drawWall(i, doom_96);
                             }
                         }
                         // [JN] Exit (can be one-sided or two-sided)
                         if (lines[i].special == 11 || lines[i].special == 51
                         ||  lines[i].special == 52 || lines[i].special == 124)
                         {
-                            array_push(lines_1S, ((am_line_t){l, exitcolors}));
+                            array_push(lines_1S, ((am_line_t){i, exitcolors}));
                         }
                     }
                     // [JN] Computermap visible lines
                     else if (plr->powers[pw_allmap])
                     {
-                        if (!(lines[i].flags & ML_DONTDRAW)) AM_drawMline(&l, doom_104);
+                        if (!(lines[i].flags & ML_DONTDRAW)) AM_drawWall(i, doom_104);
                     }
                 }
                 break;
@@ -1914,16 +2195,16 @@ static void AM_drawWalls (void)
                             // [JN] Highlight secret sectors
                             if (automap_secrets > 1 && lines[i].frontsector->special == 9)
                             {
-                                array_push(lines_1S, ((am_line_t){l, secretwallcolors}));
+                                array_push(lines_1S, ((am_line_t){i, secretwallcolors}));
                             }
                             // [plums] show revealed secrets
                             else if (automap_secrets && lines[i].frontsector->oldspecial == 9)
                             {
-                                array_push(lines_1S, ((am_line_t){l, foundsecretwallcolors}));
+                                array_push(lines_1S, ((am_line_t){i, foundsecretwallcolors}));
                             }
                             else
                             {
-                                array_push(lines_1S, ((am_line_t){l, jaguar_32}));
+                                array_push(lines_1S, ((am_line_t){i, jaguar_32}));
                             }
                         }
                         else
@@ -1931,12 +2212,12 @@ static void AM_drawWalls (void)
                             // Teleport line
                             if (lines[i].special == 39 || lines[i].special == 97)
                             {
-                                AM_drawMline(&l, jaguar_120);
+                                AM_drawWall(i, jaguar_120);
                             }
                             // Secret door
                             else if (lines[i].flags & ML_SECRET)
                             {
-                                AM_drawMline(&l, jaguar_32);
+                                AM_drawWall(i, jaguar_32);
                             }
 
                             // [JN] RED Key-locked doors
@@ -1944,67 +2225,67 @@ static void AM_drawWalls (void)
                             if (lines[i].special == 28  || lines[i].special == 33
                             ||  lines[i].special == 134 || lines[i].special == 135)
                             {
-                                AM_drawMline(&l, jaguar_176);
+                                AM_drawWall(i, jaguar_176);
                             }
                             // [JN] BLUE Key-locked doors
                             else
                             if (lines[i].special == 26  || lines[i].special == 32
                             ||  lines[i].special == 99  || lines[i].special == 133)
                             {
-                                AM_drawMline(&l, jaguar_200);
+                                AM_drawWall(i, jaguar_200);
                             }
                             // [JN] YELLOW Key-locked doors
                             else
                             if (lines[i].special == 27  || lines[i].special == 34
                             ||  lines[i].special == 136 || lines[i].special == 137)
                             {
-                                AM_drawMline(&l, jaguar_228);
+                                AM_drawWall(i, jaguar_228);
                             }
                             // [JN] Highlight secret sectors
                             else if (automap_secrets > 1
                             && (lines[i].frontsector->special == 9
                             ||  lines[i].backsector->special == 9))
                             {
-                                AM_drawMline(&l, secretwallcolors);
+                                AM_drawWall(i, secretwallcolors);
                             }
                             // [plums] show revealed secrets
                             else if (automap_secrets
                             && (lines[i].frontsector->oldspecial == 9
                             ||  lines[i].backsector->oldspecial == 9))
                             {
-                                AM_drawMline(&l, foundsecretwallcolors);
+                                AM_drawWall(i, foundsecretwallcolors);
                             }
                             // Any special linedef
                             else if (lines[i].special)
                             {
-                                AM_drawMline(&l, jaguar_254);
+                                AM_drawWall(i, jaguar_254);
                             }
                             // Floor level change
                             else if (lines[i].backsector->floorheight != lines[i].frontsector->floorheight)
                             {
-                                AM_drawMline(&l, jaguar_163);
+                                AM_drawWall(i, jaguar_163);
                             }
                             // Ceiling level change
                             else if (lines[i].backsector->ceilingheight != lines[i].frontsector->ceilingheight)
                             {
-                                AM_drawMline(&l, jaguar_75);
+                                AM_drawWall(i, jaguar_75);
                             }
                             // Hidden gray walls
                             else if (iddt_cheating)
                             {
-                                AM_drawMline(&l, doom_96);
+                                AM_drawWall(i, doom_96);
                             }
                         }
                         // [JN] Exit (can be one-sided or two-sided)
                         if (lines[i].special == 11 || lines[i].special == 51
                         ||  lines[i].special == 52 || lines[i].special == 124)
                         {
-                            array_push(lines_1S, ((am_line_t){l, exitcolors}));
+                            array_push(lines_1S, ((am_line_t){i, exitcolors}));
                         }
                     }
                     else if (plr->powers[pw_allmap])
                     {
-                        if (!(lines[i].flags & ML_DONTDRAW)) AM_drawMline(&l, doom_99);
+                        if (!(lines[i].flags & ML_DONTDRAW)) AM_drawWall(i, doom_99);
                     }
                 }
                 break;
@@ -2017,29 +2298,29 @@ static void AM_drawWalls (void)
                         // [JN] Mark secret sectors.
                         if (automap_secrets > 1 && lines[i].frontsector->special == 9)
                         {
-                            array_push(lines_1S, ((am_line_t){l, secretwallcolors}));
+                            array_push(lines_1S, ((am_line_t){i, secretwallcolors}));
                         }
                         // [plums] show revealed secrets
                         else if (automap_secrets && lines[i].frontsector->oldspecial == 9)
                         {
-                            array_push(lines_1S, ((am_line_t){l, foundsecretwallcolors}));
+                            array_push(lines_1S, ((am_line_t){i, foundsecretwallcolors}));
                         }
                         else
                         {
-                            array_push(lines_1S, ((am_line_t){l, doom_176}));
+                            array_push(lines_1S, ((am_line_t){i, doom_176}));
                         }
                     }
                     else
                     {
                         if (lines[i].special == 39)
                         { // teleporters
-                            AM_drawMline(&l, doom_184);
+                            AM_drawWall(i, doom_184);
                         }
                         else
                         if (lines[i].flags & ML_SECRET) // secret door
                         {
                             // [JN] Note: this means "don't map as two sided".
-                            AM_drawMline(&l, doom_176);
+                            AM_drawWall(i, doom_176);
                         }
                         // [JN] Mark secret sectors.
                         else
@@ -2047,31 +2328,31 @@ static void AM_drawWalls (void)
                         && (lines[i].frontsector->special == 9
                         ||  lines[i].backsector->special == 9))
                         {
-                            AM_drawMline(&l, secretwallcolors);
+                            AM_drawWall(i, secretwallcolors);
                         }
                         // [plums] show revealed secrets
                         else if (automap_secrets
                         && (lines[i].frontsector->oldspecial == 9
                         ||  lines[i].backsector->oldspecial == 9))
                         {
-                            AM_drawMline(&l, foundsecretwallcolors);
+                            AM_drawWall(i, foundsecretwallcolors);
                         }
                         else
                         if (lines[i].backsector->floorheight
 			            !=  lines[i].frontsector->floorheight)
                         {
-                            AM_drawMline(&l, doom_64); // floor level change
+                            AM_drawWall(i, doom_64); // floor level change
                         }
                         else
                         if (lines[i].backsector->ceilingheight
                         !=  lines[i].frontsector->ceilingheight)
                         {
-                            AM_drawMline(&l, doom_231); // ceiling level change
+                            AM_drawWall(i, doom_231); // ceiling level change
                         }
                         else
                         if (iddt_cheating)
                         {
-                            AM_drawMline(&l, doom_96);
+                            AM_drawWall(i, doom_96);
                         }
                     }
                 }
@@ -2082,14 +2363,14 @@ static void AM_drawWalls (void)
         {
             if (!(lines[i].flags & ML_DONTDRAW))
             {
-                AM_drawMline(&l, doom_99);
+                AM_drawWall(i, doom_99);
             }
         }
     }
 
     for (int i = 0; i < array_size(lines_1S); ++i)
     {
-        AM_drawMline(&lines_1S[i].l, lines_1S[i].color);
+        AM_drawWall(lines_1S[i].line, lines_1S[i].color);
     }
     array_clear(lines_1S);
 }
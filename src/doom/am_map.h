@@ -65,6 +65,9 @@ void AM_Stop (void);
 // [JN] Make global, since mark preserved in saved games.
 void AM_clearMarks (void);
 
+// [JN] Forces the automap wall grid to be rebuilt for a new level.
+void AM_clearWallGrid (void);
+
 extern cheatseq_t cheat_amap;
 
 
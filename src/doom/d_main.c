@@ -213,6 +213,8 @@ static void D_Display (void)
     int      y;
     boolean  done;
     boolean  wipe;
+    int      wipe_frames;
+    uint64_t wipe_time, wipe_maxtime;
     static   gamestate_t oldgamestate = -1;
 
     if (nodrawers)
@@ -397,8 +399,8 @@ static void D_Display (void)
     M_Drawer ();   // menu is drawn even on top of everything
     NetUpdate ();  // send out any new accumulation
 
-    // [JN] Apply post-processing effects and forcefully
-    // update status bar if any effect is active.
+    // [JN] Apply post-processing effects. The status bar is restored
+    // from its cached layer on the next frame, no full update needed.
     // Supress V_PProc_OverbrightGlow ...
                     // In non game level states
     V_PProc_Display((gamestate != GS_LEVEL) || 
@@ -406,8 +408,6 @@ static void D_Display (void)
                     (automapactive && !automap_overlay) ||
                     // While invlulenability effect
                      players[displayplayer].fixedcolormap); 
-    if (V_PProc_EffectsActive())
-        st_fullupdate = true;
 
     // normal update
     if (!wipe)
@@ -419,9 +419,13 @@ static void D_Display (void)
     // wipe update
     wipe_EndScreen();
     wipestart = I_GetTime () - 1;
+    wipe_frames = 0;
+    wipe_time = wipe_maxtime = 0;
 
     do
     {
+        uint64_t frametime;
+
         do
         {
             nowtime = I_GetTime ();
@@ -430,10 +434,22 @@ static void D_Display (void)
         } while (tics <= 0);
 
         wipestart = nowtime;
+        frametime = I_GetTimeUS();
         done = wipe_ScreenWipe(tics);
         M_Drawer();        // menu is drawn even on top of wipes
         I_FinishUpdate();  // page flip or blit buffer
+
+        // [JN] Frame time spent on the wipe, without waiting for the tic.
+        frametime = I_GetTimeUS() - frametime;
+        wipe_time += frametime;
+        wipe_maxtime = MAX(wipe_maxtime, frametime);
+        wipe_frames++;
         } while (!done);
+
+    // [JN] Wipe frame times are shown along with the render counters.
+    IDTiming.wipeframes = wipe_frames;
+    IDTiming.wipeavg = (int) (wipe_time / wipe_frames);
+    IDTiming.wipemax = (int) wipe_maxtime;
 }
 
 //
@@ -2309,7 +2325,8 @@ void D_DoomMain (void)
     // [JN] Predefine some automap variables at program startup.
     AM_Init ();
 
-    // [JN] Show startup process time.
+    // [JN] Show lump lookup statistics and startup process time.
+    W_PrintLookupStats();
     printf("Startup process took %d ms.\n", SDL_GetTicks() - starttime);
 
     // If Doom II without a MAP01 lump, this is a store demo.
@@ -2325,6 +2342,9 @@ void D_DoomMain (void)
         DEH_printf("External statistics registered.\n");
     }
 
+    // [JN] Optional per-tic state hashing for desync detection.
+    P_StateHashInit();
+
     //!
     // @arg <x>
     // @category demo
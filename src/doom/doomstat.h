@@ -285,6 +285,7 @@ extern boolean have_remaster_sky;
 
 
 extern	int		rndindex;
+extern	int		prndindex;
 
 extern  ticcmd_t       *netcmds;
 
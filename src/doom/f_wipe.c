@@ -21,7 +21,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
 #include "z_zone.h"
+#include "i_system.h"
 #include "i_video.h"
 #include "v_trans.h" // [crispy] blending functions
 #include "v_video.h"
@@ -34,10 +39,20 @@
 // SCREEN WIPE PACKAGE
 // =============================================================================
 
+// [JN] Start and end screens, kept between wipes and only reallocated
+// when the screen size changes, so a wipe allocates nothing per frame.
 static pixel_t *wipe_scr_start;
 static pixel_t *wipe_scr_end;
 static pixel_t *wipe_scr;
+static int      wipe_area;
+
+// Melt column positions, one per pair of pixels.
 static int     *y;
+static int      y_size;
+
+// [PN] Fizzle burn thresholds, one per pixel.
+static byte    *burn;
+static int      burn_area;
 
 // [JN] Function pointers to melt and crossfade effects.
 static void (*wipe_init) (void);
@@ -46,26 +61,22 @@ static const int (*wipe_do) (int ticks);
 // [crispy] Additional fail-safe counter for performing crossfade effect.
 static int fade_counter;
 
+// [JN] Start and end screens are not identical, i.e. crossfade has work.
+static boolean fade_differs;
+
 // -----------------------------------------------------------------------------
-// wipe_shittyColMajorXform
+// wipe_AllocScreens
+//  [JN] Size the start and end screens for the current resolution.
 // -----------------------------------------------------------------------------
 
-static void wipe_shittyColMajorXform (dpixel_t *array)
+static void wipe_AllocScreens (void)
 {
-    const int width = SCREENWIDTH/2;
-    dpixel_t *dest = (dpixel_t*) malloc(width*SCREENHEIGHT*sizeof(*dest));
-
-    for (int y = 0 ; y < SCREENHEIGHT ; y++)
+    if (wipe_area != SCREENAREA)
     {
-        for (int x = 0 ; x < width ; x++)
-        {
-            dest[x*SCREENHEIGHT+y] = array[y*width+x];
-        }
+        wipe_scr_start = I_Realloc(wipe_scr_start, SCREENAREA * sizeof(*wipe_scr_start));
+        wipe_scr_end = I_Realloc(wipe_scr_end, SCREENAREA * sizeof(*wipe_scr_end));
+        wipe_area = SCREENAREA;
     }
-
-    memcpy(array, dest, width*SCREENHEIGHT*sizeof(*dest));
-
-    free(dest);
 }
 
 // -----------------------------------------------------------------------------
@@ -77,14 +88,14 @@ static void wipe_initMelt (void)
     // copy start screen to main screen
     memcpy(wipe_scr, wipe_scr_start, SCREENAREA*sizeof(*wipe_scr));
 
-    // makes this wipe faster (in theory)
-    // to have stuff in column-major format
-    wipe_shittyColMajorXform((dpixel_t*)wipe_scr_start);
-    wipe_shittyColMajorXform((dpixel_t*)wipe_scr_end);
-
     // setup initial column positions
     // (y<0 => not ready to scroll yet)
-    y = (int *) malloc(SCREENWIDTH*sizeof(int));
+    if (y_size != SCREENWIDTH)
+    {
+        y = I_Realloc(y, SCREENWIDTH*sizeof(int));
+        y_size = SCREENWIDTH;
+    }
+
     y[0] = -(ID_RealRandom()%16);
 
     for (int i = 1 ; i < SCREENWIDTH ; i++)
@@ -116,6 +127,10 @@ static void wipe_initCrossfade (void)
     // 32 screen screen transitions in TrueColor render,
     // to keep effect smooth enough.
     fade_counter = 32;
+    // [JN] Pixels that are equal on both screens are never blended,
+    // so with identical screens the fade ends on its first step.
+    fade_differs = memcmp(wipe_scr_start, wipe_scr_end,
+                          SCREENAREA*sizeof(*wipe_scr)) != 0;
 }
 
 // -----------------------------------------------------------------------------
@@ -127,7 +142,12 @@ static void wipe_initFizzle (void)
     const int scale = vid_resolution;
 
     memcpy(wipe_scr, wipe_scr_start, SCREENAREA * sizeof(*wipe_scr));
-    y = (int *) malloc(SCREENAREA*sizeof(int));
+
+    if (burn_area != SCREENAREA)
+    {
+        burn = I_Realloc(burn, SCREENAREA);
+        burn_area = SCREENAREA;
+    }
 
     for (int yy = 0; yy < SCREENHEIGHT; yy += scale)
     {
@@ -144,7 +164,7 @@ static void wipe_initFizzle (void)
 
                     if (sx < SCREENWIDTH && sy < SCREENHEIGHT)
                     {
-                        y[sy * SCREENWIDTH + sx] = burn_value;
+                        burn[sy * SCREENWIDTH + sx] = burn_value;
                     }
                 }
             }
@@ -154,21 +174,61 @@ static void wipe_initFizzle (void)
     fade_counter = 0;
 }
 
+// -----------------------------------------------------------------------------
+// wipe_drawMelt
+//  [JN] Compose the melted screen row by row. A column that has slid down
+//  by y pixels shows the end screen above y, and the start screen shifted
+//  down by y below it. Neighbouring columns never differ by more than a
+//  few rows, so the start screen rows read for one output row stay in cache.
+// -----------------------------------------------------------------------------
+
+static void wipe_drawMelt (void)
+{
+    const int width = SCREENWIDTH/2;
+    dpixel_t *restrict const dest = (dpixel_t *)wipe_scr;
+    const dpixel_t *restrict const start = (const dpixel_t *)wipe_scr_start;
+    const dpixel_t *restrict const end = (const dpixel_t *)wipe_scr_end;
+    int miny = SCREENHEIGHT;
+
+    for (int i = 0 ; i < width ; i++)
+    {
+        const int yi = y[i] > 0 ? y[i] : 0;
+
+        if (yi < miny)
+        {
+            miny = yi;
+        }
+    }
+
+    // Rows above every column are fully revealed.
+    memcpy(dest, end, (size_t)miny*width*sizeof(*dest));
+
+    for (int row = miny ; row < SCREENHEIGHT ; row++)
+    {
+        dpixel_t *restrict const d = dest + row*width;
+        const dpixel_t *const e = end + row*width;
+
+        for (int i = 0 ; i < width ; i++)
+        {
+            const int yi = y[i] > 0 ? y[i] : 0;
+
+            d[i] = row < yi ? e[i] : start[(row-yi)*width+i];
+        }
+    }
+}
+
 // -----------------------------------------------------------------------------
 // wipe_doMelt
 // -----------------------------------------------------------------------------
 
 static const int wipe_doMelt (int ticks)
 {
-    int j;
     int dy;
-    int idx;
     const int width = SCREENWIDTH/2;
-
-    dpixel_t *s;
-    dpixel_t *d;
     boolean	done = true;
 
+    // [JN] Advance the columns for every tick first, the screen only
+    // depends on where they end up and is composed once.
     while (ticks--)
     {
         for (int i = 0 ; i < width ; i++)
@@ -187,35 +247,117 @@ static const int wipe_doMelt (int ticks)
                     dy = SCREENHEIGHT - y[i];
                 }
 
-                s = &((dpixel_t *)wipe_scr_end)[i*SCREENHEIGHT+y[i]];
-                d = &((dpixel_t *)wipe_scr)[y[i]*width+i];
-                idx = 0;
-
-                for (j = dy ; j ; j--)
-                {
-                    d[idx] = *(s++);
-                    idx += width;
-                }
-
                 y[i] += dy;
-                s = &((dpixel_t *)wipe_scr_start)[i*SCREENHEIGHT];
-                d = &((dpixel_t *)wipe_scr)[y[i]*width+i];
-                idx = 0;
-
-                for (j=SCREENHEIGHT-y[i];j;j--)
-                {
-                    d[idx] = *(s++);
-                    idx += width;
-                }
-
                 done = false;
             }
         }
     }
 
+    if (!done)
+    {
+        wipe_drawMelt();
+    }
+
     return done;
 }
 
+// -----------------------------------------------------------------------------
+// wipe_CrossfadeAVX2, wipe_FizzleAVX2
+//  [JN] Eight pixels per step. Crossfade does the I_BlendOver arithmetic
+//  on 32-bit lanes, red and blue products can not overflow into each
+//  other, so output is identical to the scalar loop. Fizzle widens eight
+//  burn thresholds to dwords and selects between both screens by mask.
+//
+//  Used when the compiler targets AVX2, or, with GCC and Clang, when the
+//  CPU supports it at run time, same as span drawing in r_draw.c.
+//  Both return the index of the first pixel left for the scalar loop.
+// -----------------------------------------------------------------------------
+
+#if defined(__AVX2__)
+#define F_WIPE_AVX2
+#define F_WIPE_AVX2_TARGET
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define F_WIPE_AVX2
+#define F_WIPE_AVX2_TARGET __attribute__((target("avx2")))
+#define F_WIPE_AVX2_RUNTIME
+#endif
+
+#ifdef F_WIPE_AVX2
+
+F_WIPE_AVX2_TARGET
+static int wipe_CrossfadeAVX2 (pixel_t *restrict cur_screen,
+                               const pixel_t *restrict start_screen,
+                               const pixel_t *restrict end_screen,
+                               const uint32_t amount, const int pix)
+{
+    const __m256i fg_amount = _mm256_set1_epi32(amount);
+    const __m256i bg_amount = _mm256_set1_epi32(255 - amount);
+    const __m256i rb_mask = _mm256_set1_epi32(0xFF00FF);
+    const __m256i g_mask = _mm256_set1_epi32(0xFF00);
+    const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+    int i;
+
+    for (i = 0; i + 8 <= pix; i += 8)
+    {
+        const __m256i s = _mm256_loadu_si256((const __m256i *) (start_screen + i));
+        const __m256i e = _mm256_loadu_si256((const __m256i *) (end_screen + i));
+        const __m256i rb = _mm256_add_epi32(_mm256_mullo_epi32(fg_amount, _mm256_and_si256(s, rb_mask)),
+                                            _mm256_mullo_epi32(bg_amount, _mm256_and_si256(e, rb_mask)));
+        const __m256i g = _mm256_add_epi32(_mm256_mullo_epi32(fg_amount, _mm256_and_si256(s, g_mask)),
+                                           _mm256_mullo_epi32(bg_amount, _mm256_and_si256(e, g_mask)));
+        const __m256i blend = _mm256_or_si256(alpha,
+                              _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(rb, 8), rb_mask),
+                                              _mm256_and_si256(_mm256_srli_epi32(g, 8), g_mask)));
+
+        _mm256_storeu_si256((__m256i *) (cur_screen + i),
+                            _mm256_blendv_epi8(blend, s, _mm256_cmpeq_epi32(s, e)));
+    }
+
+    return i;
+}
+
+F_WIPE_AVX2_TARGET
+static int wipe_FizzleAVX2 (pixel_t *restrict cur_screen,
+                            const pixel_t *restrict end_screen,
+                            const byte *restrict burn_map,
+                            const int counter, const int pix)
+{
+    const __m256i limit = _mm256_set1_epi32(counter);
+    int i;
+
+    for (i = 0; i + 8 <= pix; i += 8)
+    {
+        const __m256i threshold = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (burn_map + i)));
+        const __m256i keep = _mm256_cmpgt_epi32(threshold, limit);
+
+        _mm256_storeu_si256((__m256i *) (cur_screen + i),
+                            _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i *) (end_screen + i)),
+                                               _mm256_loadu_si256((const __m256i *) (cur_screen + i)),
+                                               keep));
+    }
+
+    return i;
+}
+
+static boolean wipe_HaveAVX2 (void)
+{
+#ifdef F_WIPE_AVX2_RUNTIME
+    static int have_avx2 = -1;
+
+    if (have_avx2 < 0)
+    {
+        __builtin_cpu_init();
+        have_avx2 = __builtin_cpu_supports("avx2") != 0;
+    }
+
+    return have_avx2;
+#else
+    return true;
+#endif
+}
+
+#endif // F_WIPE_AVX2
+
 // -----------------------------------------------------------------------------
 // wipe_doCrossfade
 // -----------------------------------------------------------------------------
@@ -229,32 +371,38 @@ static const uint8_t alpha_table[] = {
 
 static const int wipe_doCrossfade (const int ticks)
 {
-    pixel_t   *cur_screen = wipe_scr;
-    pixel_t   *end_screen = wipe_scr_end;
-    const int  pix = SCREENAREA;
-    boolean changed = false;
+    pixel_t *restrict const cur_screen = wipe_scr;
+    const pixel_t *restrict const start_screen = wipe_scr_start;
+    const pixel_t *restrict const end_screen = wipe_scr_end;
+    const int pix = SCREENAREA;
 
     // [crispy] reduce fail-safe crossfade counter tics
     if (--fade_counter > 0)
     {
-        // [JN] Keep solid background to prevent blending with empty space.
-        V_DrawBlock(0, 0, SCREENWIDTH, SCREENHEIGHT, wipe_scr_start);
+        const uint32_t amount = alpha_table[fade_counter];
+        int i = 0;
 
-        for (int i = 0; i < pix; i++)  // [PN] Modified index to standard loop
+#ifdef F_WIPE_AVX2
+        if (wipe_HaveAVX2())
         {
-            if (*cur_screen != *end_screen && fade_counter)
-            {
-                *cur_screen = I_BlendOver(*end_screen, *cur_screen, alpha_table[fade_counter]);
-                // [PN] Moved to the end of the condition to ensure
-                // it's set only when an actual pixel change occurs.
-                changed = true;
-            }
-            ++cur_screen;
-            ++end_screen;
+            i = wipe_CrossfadeAVX2(cur_screen, start_screen, end_screen, amount, pix);
+        }
+#endif
+
+        // [JN] Blend over the start screen directly, which keeps a solid
+        // background. Identical pixels are copied as is.
+        for ( ; i < pix; i++)
+        {
+            const uint32_t s = start_screen[i];
+            const uint32_t e = end_screen[i];
+
+            cur_screen[i] = s == e ? s : I_BlendOver(e, s, amount);
         }
+
+        return !fade_differs;
     }
 
-    return !changed;
+    return true;
 }
 
 // -----------------------------------------------------------------------------
@@ -263,45 +411,39 @@ static const int wipe_doCrossfade (const int ticks)
 
 static const int wipe_doFizzle (const int ticks)
 {
-    pixel_t *cur_screen = wipe_scr;
-    pixel_t *end_screen = wipe_scr_end;
+    pixel_t *restrict const cur_screen = wipe_scr;
+    const pixel_t *restrict const end_screen = wipe_scr_end;
+    const byte *restrict const burn_map = burn;
+    const int pix = SCREENAREA;
+    int i = 0;
 
     fade_counter += 8;
 
-    for (int i = 0; i < SCREENAREA; ++i)
+#ifdef F_WIPE_AVX2
+    if (wipe_HaveAVX2())
     {
-        if (y[i] <= fade_counter)
+        i = wipe_FizzleAVX2(cur_screen, end_screen, burn_map, fade_counter, pix);
+    }
+#endif
+
+    for ( ; i < pix; ++i)
+    {
+        if (burn_map[i] <= fade_counter)
         {
-            if (cur_screen[i] != end_screen[i])
-            {
-                cur_screen[i] = end_screen[i];
-            }
+            cur_screen[i] = end_screen[i];
         }
     }
 
-    V_DrawBlock(0, 0, SCREENWIDTH, SCREENHEIGHT, wipe_scr);
     return fade_counter >= 256;
 }
 
-// -----------------------------------------------------------------------------
-// wipe_exitMelt
-// -----------------------------------------------------------------------------
-
-static void wipe_exit (void)
-{
-    if (vid_screenwipe != 3)  // [JN] y is not allocated in crossfade wipe.
-    free(y);
-    free(wipe_scr_start);
-    free(wipe_scr_end);
-}
-
 // -----------------------------------------------------------------------------
 // wipe_StartScreen
 // -----------------------------------------------------------------------------
 
 void wipe_StartScreen (void)
 {
-    wipe_scr_start = malloc(SCREENAREA * sizeof(*wipe_scr_start));
+    wipe_AllocScreens();
     I_ReadScreen(wipe_scr_start);
 }
 
@@ -311,7 +453,7 @@ void wipe_StartScreen (void)
 
 void wipe_EndScreen (void)
 {
-    wipe_scr_end = malloc(SCREENAREA * sizeof(*wipe_scr_end));
+    wipe_AllocScreens();
     I_ReadScreen(wipe_scr_end);
     V_DrawBlock(0, 0, SCREENWIDTH, SCREENHEIGHT, wipe_scr_start); // restore start scr.
 }
@@ -356,7 +498,6 @@ const int wipe_ScreenWipe (const int ticks)
     if ((*wipe_do)(ticks))
     {
         go = false;
-        wipe_exit();
     }
 
     return !go;
@@ -410,6 +410,45 @@ void G_SetSideMove (void)
     }
 }
 
+// -----------------------------------------------------------------------------
+// G_TurboReport
+//  [JN] Report the tic rate achieved once fast-forward is released.
+// -----------------------------------------------------------------------------
+
+static void G_TurboReport (void)
+{
+    static boolean active;
+    static int startms, starttic;
+    const boolean now = D_TurboActive();
+
+    if (now == active)
+    {
+        return;
+    }
+
+    active = now;
+
+    if (now)
+    {
+        startms = I_GetTimeMS();
+        starttic = gametic;
+    }
+    else
+    {
+        const int ms = I_GetTimeMS() - startms;
+
+        if (ms > 0)
+        {
+            static char turbomessage[64];
+
+            M_snprintf(turbomessage, sizeof(turbomessage),
+                       "Fast-forward: %d tics, %d per second",
+                       gametic - starttic, (gametic - starttic) * 1000 / ms);
+            CT_SetMessage(&players[consoleplayer], turbomessage, false, NULL);
+        }
+    }
+}
+
 //
 // G_BuildTiccmd
 // Builds a ticcmd from all of the available inputs
@@ -429,6 +468,12 @@ void G_BuildTiccmd (ticcmd_t* cmd, int maketic)
     int		side;
     ticcmd_t spect;
 
+    // [JN] Fast-forward while the key is held in a single player game.
+    turbo = key_demospeed && key_demospeed < NUMKEYS
+         && gamekeydown[key_demospeed] && gamestate == GS_LEVEL
+         && !netgame && !demoplayback && !menuactive;
+    G_TurboReport();
+
     if (!crl_spectating)
     {
         // [crispy] For fast polling.
@@ -1005,6 +1050,18 @@ void G_DoLoadLevel (void)
     {
         CT_SetMessage(&players[consoleplayer], "Press escape to quit.", false, NULL);
     }
+
+    // [JN] Playsim benchmark of the starting map, quits when done.
+    if (simbench)
+    {
+        P_FastSimBenchmark();
+    }
+
+    // [JN] Wall drawer benchmark of the starting view, quits when done.
+    if (benchwalls)
+    {
+        R_WallBenchmark();
+    }
 } 
 
 static void SetJoyButtons(unsigned int buttons_mask)
@@ -3217,6 +3274,9 @@ void G_BeginRecording (void)
 
     demo_p = demobuffer;
 
+    // [JN] Start collecting state hashes for the demo footer.
+    P_StateHashStartDemo();
+
     //!
     // @category demo
     //
@@ -3461,6 +3521,14 @@ void G_DoPlayDemo (void)
 	    demo_ptr += numplayersingame * (longtics ? 5 : 4);
 	    deftotaldemotics++;
 	}
+
+	// [JN] Footer follows the end marker, it may carry state hashes.
+	P_StateHashStartDemo();
+	if ((demo_ptr - demobuffer) < lumplength)
+	{
+	    P_StateHashLoadDemo(demo_ptr + 1,
+	                        lumplength - (demo_ptr + 1 - demobuffer));
+	}
     }
 } 
 
@@ -3587,16 +3655,28 @@ static void G_AddDemoFooter(void)
     size_t size;
     long filepos;
 
+    byte *hashdata;
+    size_t hashsize;
+
     MEMFILE *stream = mem_fopen_write();
 
     wadinfo_t header = { "PWAD" };
-    header.numlumps = LONG(NUM_DEMO_FOOTER_LUMPS);
+
+    // [JN] Per-tic state hashes, only present with -statehash.
+    hashsize = P_StateHashDemoLump(&hashdata);
+
+    header.numlumps = LONG(NUM_DEMO_FOOTER_LUMPS + (hashsize ? 2 : 0));
     mem_fwrite(&header, 1, sizeof(header), stream);
 
     mem_fputs(PACKAGE_FULLNAME, stream);  // [JN] Use full port name.
     mem_fputs(DEMO_FOOTER_SEPARATOR, stream);
     size = WriteCmdLineLump(stream);
     mem_fputs(DEMO_FOOTER_SEPARATOR, stream);
+    if (hashsize)
+    {
+        mem_fwrite(hashdata, 1, hashsize, stream);
+        mem_fputs(DEMO_FOOTER_SEPARATOR, stream);
+    }
 
     header.infotableofs = LONG(mem_ftell(stream));
     mem_fseek(stream, 0, MEM_SEEK_SET);
@@ -3607,7 +3687,13 @@ static void G_AddDemoFooter(void)
     filepos = WriteFileInfo("PORTNAME", strlen(PACKAGE_FULLNAME), filepos, stream);
     filepos = WriteFileInfo(NULL, strlen(DEMO_FOOTER_SEPARATOR), filepos, stream);
     filepos = WriteFileInfo("CMDLINE", size, filepos, stream);
-    WriteFileInfo(NULL, strlen(DEMO_FOOTER_SEPARATOR), filepos, stream);
+    filepos = WriteFileInfo(NULL, strlen(DEMO_FOOTER_SEPARATOR), filepos, stream);
+    if (hashsize)
+    {
+        filepos = WriteFileInfo("STATEHSH", hashsize, filepos, stream);
+        WriteFileInfo(NULL, strlen(DEMO_FOOTER_SEPARATOR), filepos, stream);
+        free(hashdata);
+    }
 
     mem_get_buf(stream, (void **)&data, &size);
 
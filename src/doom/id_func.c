@@ -25,6 +25,8 @@
 #include "m_menu.h"
 #include "m_misc.h"
 #include "p_local.h"
+#include "s_sound.h"
+#include "st_bar.h"
 
 #include "id_vars.h"
 #include "id_func.h"
@@ -37,6 +39,7 @@
 // =============================================================================
 
 ID_Render_t IDRender;
+ID_Timing_t IDTiming;
 ID_Widget_t IDWidget;
 
 char ID_Level_Time[64];
@@ -441,7 +444,8 @@ void ID_LeftWidgets (void)
 
             // Sprites
             M_WriteText(left_align, 124, "SPR:", ID_WidgetColor(widget_render_str));
-            M_snprintf(spr, 16, "%d", IDRender.numsprites);
+            M_snprintf(spr, 32, "%d/%d", IDRender.numsprites,
+                       IDRender.spritesegs / MAX(1, IDRender.numsprites));
             M_WriteText(32 + left_align, 124, spr, ID_WidgetColor(widget_render_val));
 
             // Segments (256 max)
@@ -456,7 +460,7 @@ void ID_LeftWidgets (void)
 
             // Planes
             M_WriteText(left_align, 151, "PLN:", ID_WidgetColor(widget_render_str));
-            M_snprintf(vis, 32, "%d", IDRender.numplanes);
+            M_snprintf(vis, 32, "%d/%d", IDRender.numplanes, IDRender.planechain);
             M_WriteText(32 + left_align, 151, vis, ID_WidgetColor(widget_render_val));
         }
     }
@@ -484,7 +488,8 @@ void ID_LeftWidgets (void)
 
             // Sprites
             M_WriteText(left_align, 54 + yy1, "SPR:", ID_WidgetColor(widget_render_str));
-            M_snprintf(spr, 16, "%d", IDRender.numsprites);
+            M_snprintf(spr, 32, "%d/%d", IDRender.numsprites,
+                       IDRender.spritesegs / MAX(1, IDRender.numsprites));
             M_WriteText(32 + left_align, 54 + yy1, spr, ID_WidgetColor(widget_render_val));
 
             // Segments (256 max)
@@ -499,7 +504,7 @@ void ID_LeftWidgets (void)
 
             // Planes
             M_WriteText(left_align, 81 + yy1, "PLN:", ID_WidgetColor(widget_render_str));
-            M_snprintf(vis, 32, "%d", IDRender.numplanes);
+            M_snprintf(vis, 32, "%d/%d", IDRender.numplanes, IDRender.planechain);
             M_WriteText(32 + left_align, 81 + yy1, vis, ID_WidgetColor(widget_render_val));
         }
 
@@ -688,11 +693,25 @@ void ID_LeftWidgets (void)
     }
 }
 
+// -----------------------------------------------------------------------------
+// ID_RightCounter
+//  [JN] Draws a render counter right aligned, label followed by value.
+// -----------------------------------------------------------------------------
+
+static void ID_RightCounter (const int y, const char *label, const char *value)
+{
+    const int x = ORIGWIDTH + WIDESCREENDELTA - 7 - M_StringWidth(value);
+
+    M_WriteText(x - 4 - M_StringWidth(label), y, label, ID_WidgetColor(widget_render_str));
+    M_WriteText(x, y, value, ID_WidgetColor(widget_render_val));
+}
+
 // -----------------------------------------------------------------------------
 // ID_RightWidgets.
 //  [JN] Draw actual frames per second value.
 //  Some M_StringWidth adjustments are needed for proper positioning
 //  in case of custom font is thinner or thicker.
+//  Render counters that do not fit the left column go below.
 // -----------------------------------------------------------------------------
 
 void ID_RightWidgets (void)
@@ -728,6 +747,61 @@ void ID_RightWidgets (void)
     {
         M_WriteText(ORIGWIDTH + WIDESCREENDELTA - 7
                               - M_StringWidth(ID_Local_Time), yy, ID_Local_Time, cr[CR_GRAY]);
+
+        yy += 9;
+    }
+
+    // [JN] Frame pipeline and one-off event counters, after a blank line.
+    if (widget_render)
+    {
+        char str[32];
+
+        yy += 9;
+
+        // Texture upload, kilobytes per frame
+        M_snprintf(str, sizeof(str), "%dK", id_upload_bytes / 1024);
+        ID_RightCounter(yy, "UPL:", str);
+        yy += 9;
+
+        // Status bar redraws/blits per second
+        M_snprintf(str, sizeof(str), "%d/%d", st_redraws, st_blits);
+        ID_RightCounter(yy, "STB:", str);
+        yy += 9;
+
+        // Distorted liquid flats reused/generated
+        M_snprintf(str, sizeof(str), "%d/%d", IDRender.liquidhits, IDRender.liquidmisses);
+        ID_RightCounter(yy, "LIQ:", str);
+        yy += 9;
+
+        // Last screen wipe: frames, average/longest frame time
+        if (IDTiming.wipeframes)
+        {
+            M_snprintf(str, sizeof(str), "%dF %d.%d/%d.%dMS", IDTiming.wipeframes,
+                       IDTiming.wipeavg / 1000, IDTiming.wipeavg / 100 % 10,
+                       IDTiming.wipemax / 1000, IDTiming.wipemax / 100 % 10);
+            ID_RightCounter(yy, "WIP:", str);
+            yy += 9;
+        }
+
+        // Last colormap tables build time
+        if (IDTiming.colormaps)
+        {
+            M_snprintf(str, sizeof(str), "%d.%dMS",
+                       IDTiming.colormaps / 1000, IDTiming.colormaps / 100 % 10);
+            ID_RightCounter(yy, "CMP:", str);
+            yy += 9;
+        }
+
+        // Sounds on this level: started/culled/stolen/merged
+        M_snprintf(str, sizeof(str), "%d/%d/%d/%d", sound_stats.started,
+                   sound_stats.culled, sound_stats.stolen, sound_stats.merged);
+        ID_RightCounter(yy, "SND:", str);
+        yy += 9;
+
+        // Sounds that waited for a voice: all/promoted/dropped
+        M_snprintf(str, sizeof(str), "%d/%d/%d", sound_stats.virtualized,
+                   sound_stats.promoted, sound_stats.dropped);
+        ID_RightCounter(yy, "VIR:", str);
     }
 }
 
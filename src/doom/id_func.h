@@ -31,13 +31,28 @@
 typedef struct ID_Data_s
 {
     int numsprites;     // [JN] Number of sprites.
+    int spritesegs;     // [JN] Drawsegs visited by sprite clipping.
     int numsegs;        // [JN] Number of wall segments.
     int numplanes;      // [JN] Number of visplanes.
+    int planechain;     // [JN] Longest visplane hash chain.
     int numopenings;    // [JN] Number of openings.
+    int liquidhits;     // [JN] Distorted flats reused from this tic.
+    int liquidmisses;   // [JN] Distorted flats generated.
 } ID_Render_t;
 
 extern ID_Render_t IDRender;
 
+// One-off render events, kept until the next one happens.
+typedef struct ID_Timing_s
+{
+    int wipeframes;     // [JN] Frames drawn by the last screen wipe.
+    int wipeavg;        // [JN] Its average frame time, microseconds.
+    int wipemax;        // [JN] Its longest frame time, microseconds.
+    int colormaps;      // [JN] Last colormap tables build, microseconds.
+} ID_Timing_t;
+
+extern ID_Timing_t IDTiming;
+
 // Widgets data. 
 typedef struct ID_Widget_s
 {
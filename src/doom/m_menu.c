@@ -2504,7 +2504,7 @@ static menuitem_t ID_Menu_Keybinds_2[]=
     { M_SKIP, "", 0, '\0'},
     { M_SWTC, "RESTART LEVEL/DEMO",      M_Bind_RestartLevel,   'g' },
     { M_SWTC, "GO TO NEXT LEVEL",        M_Bind_NextLevel,      'd' },
-    { M_SWTC, "DEMO FAST-FORWARD",       M_Bind_FastForward,    'd' },
+    { M_SWTC, "FAST-FORWARD",            M_Bind_FastForward,    'd' },
     { M_SWTC, "FLIP LEVEL HORIZONTALLY", M_Bind_FlipLevels,     'f' },
     { M_SWTC, "TOGGLE EXTENDED HUD",     M_Bind_ExtendedHUD,    't' },
     { M_SKIP, "", 0, '\0'},
@@ -526,6 +526,11 @@ P_LookForPlayers
     player_t*	player;
     angle_t	an;
     fixed_t	dist;
+    boolean	found;
+
+    // [JN] Fast sim: take the outcome evaluated at the start of the tic.
+    if (fastsim && P_FastSimLook(actor, allaround, &found))
+	return found;
 
     c = 0;
     stop = (actor->lastlook-1)&3;
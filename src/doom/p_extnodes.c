@@ -244,15 +244,8 @@ void P_LoadNodes_DeePBSP (int lump)
 void P_LoadNodes_ZDBSP (int lump, boolean compressed)
 {
     byte *data;
-    unsigned int i;
     byte *output;
 
-    unsigned int orgVerts, newVerts;
-    unsigned int numSubs, currSeg;
-    unsigned int numSegs;
-    unsigned int numNodes;
-    vertex_t *newvertarray = NULL;
-
     data = W_CacheLumpNum(lump, PU_LEVEL);
 
     // 0. Uncompress nodes lump (or simply skip header)
@@ -312,6 +305,26 @@ void P_LoadNodes_ZDBSP (int lump, boolean compressed)
 	output = 0;
     }
 
+    P_LoadNodes_XNOD(data);
+
+    if (compressed)
+	Z_Free(output);
+    else
+    W_ReleaseLumpNum(lump);
+}
+
+// [JN] Parse uncompressed ZDBSP nodes that follow the four byte header.
+// Also used for nodes produced by the built-in node builder.
+void P_LoadNodes_XNOD (byte *data)
+{
+    unsigned int i;
+
+    unsigned int orgVerts, newVerts;
+    unsigned int numSubs, currSeg;
+    unsigned int numSegs;
+    unsigned int numNodes;
+    vertex_t *newvertarray = NULL;
+
     // 1. Load new vertices added during node building
 
     orgVerts = LONG(*((unsigned int*)data));
@@ -479,11 +492,6 @@ void P_LoadNodes_ZDBSP (int lump, boolean compressed)
 		no->bbox[j][k] = SHORT(mn->bbox[j][k])<<FRACBITS;
 	}
     }
-
-    if (compressed)
-	Z_Free(output);
-    else
-    W_ReleaseLumpNum(lump);
 }
 
 // [crispy] allow loading of Hexen-format maps
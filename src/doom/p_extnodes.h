@@ -37,7 +37,13 @@ extern void P_LoadSegs_DeePBSP (int lump);
 extern void P_LoadSubsectors_DeePBSP (int lump);
 extern void P_LoadNodes_DeePBSP (int lump);
 extern void P_LoadNodes_ZDBSP (int lump, boolean compressed);
+extern void P_LoadNodes_XNOD (byte *data);
 extern void P_LoadThings_Hexen (int lump);
 extern void P_LoadLineDefs_Hexen (int lump);
 
+// [JN] p_nodes.c
+extern void P_NodeBuildInit (void);
+extern boolean P_NodesNeeded (int lumpnum, mapformat_t format);
+extern void P_BuildNodes (int lumpnum);
+
 #endif
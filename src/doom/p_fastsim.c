@@ -0,0 +1,731 @@
+//
+// Copyright(C) 2016-2025 Julia Nechaevskaya
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Fast sim: sight checks and target evaluation of the monsters
+//	acting in a tic are run in parallel before the thinkers, against
+//	the state at the start of the tic. The thinkers then run serially
+//	in thinker order and take the results from there, as long as
+//	nothing they depend on has changed since.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "doomstat.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_array.h"
+#include "m_random.h"
+#include "p_local.h"
+
+
+#define MAXSIMTHREADS 15
+#define SIMBATCH      8     // Monsters taken by a thread at once
+
+boolean fastsim;
+int simbench;
+
+// A sight check, with the positions it was made from.
+
+typedef struct
+{
+    mobj_t  *t1;
+    mobj_t  *t2;
+    fixed_t  x1, y1, z1;
+    fixed_t  x2, y2, z2;
+    boolean  seen;
+} simsight_t;
+
+// A monster acting this tic, with its sight checks and the outcome of
+// P_LookForPlayers, [0] as called by A_Look and [1] by A_Chase.
+
+typedef struct
+{
+    mobj_t  *mo;
+    int      first;                     // Its sight checks in simsights
+    int      count;
+    int      playersight[MAXPLAYERS];   // Index into simsights, -1 if none
+    fixed_t  x, y, z;
+    angle_t  angle;
+    int      lastlook;
+    boolean  found[2];
+    boolean  turned[2];                 // Called R_PointToAngle2
+    int      newlook[2];
+    mobj_t  *target[2];
+} simlooker_t;
+
+// The players as the lookers saw them.
+
+typedef struct
+{
+    mobj_t  *mo;
+    fixed_t  x, y, z;
+    int      health;
+    int      notarget;
+} simplayer_t;
+
+static simsight_t *simsights;
+static int *simtable;       // Index + 1 into simsights, 0 if empty
+static int simtablesize;    // Power of two
+static simlooker_t *simlookers;
+static int *simlooktable;   // Index + 1 into simlookers, 0 if empty
+static simplayer_t simplayers[MAXPLAYERS];
+static boolean simactive;   // Results belong to the running tic
+
+// Worker threads. The game thread takes the last context.
+
+static SDL_Thread *simthreads[MAXSIMTHREADS];
+static sightctx_t simctx[MAXSIMTHREADS + 1];
+static int numsimthreads;
+static int simnumlines;
+static SDL_mutex *simlock;
+static SDL_cond *simstart;
+static SDL_cond *simdone;
+static SDL_atomic_t simnext;
+static int simgeneration;
+static int simbusy;
+static boolean simquit;
+
+static inline unsigned int P_SimHash (const mobj_t *t1, const mobj_t *t2)
+{
+    const uintptr_t a = (uintptr_t) t1 >> 4;
+    const uintptr_t b = (uintptr_t) t2 >> 4;
+
+    return (unsigned int) (a * 0x9e3779b1u) ^ (unsigned int) (b * 0x85ebca6bu);
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimEvalLook
+//  P_LookForPlayers against the start of the tic, with the sight checks
+//  just made. Writes the outcome to the looker instead of the monster.
+// -----------------------------------------------------------------------------
+
+static void P_FastSimEvalLook (simlooker_t *looker, const int allaround)
+{
+    const mobj_t *const actor = looker->mo;
+    int look = looker->lastlook;
+    const int stop = (look - 1) & 3;
+    int c = 0;
+
+    looker->found[allaround] = false;
+    looker->turned[allaround] = false;
+
+    for ( ; ; look = (look + 1) & 3)
+    {
+        const player_t *player;
+
+        if (!playeringame[look])
+            continue;
+
+        if (c++ == 2 || look == stop)
+            break;
+
+        player = &players[look];
+
+        if (player->cheats & CF_NOTARGET)
+            continue;
+
+        if (player->health <= 0)
+            continue;
+
+        if (looker->playersight[look] < 0
+        || !simsights[looker->playersight[look]].seen)
+            continue;
+
+        if (!allaround)
+        {
+            const angle_t an = R_PointToAngleFrom(actor->x, actor->y,
+                                                  player->mo->x,
+                                                  player->mo->y)
+                             - actor->angle;
+
+            looker->turned[allaround] = true;
+
+            if (an > ANG90 && an < ANG270
+            &&  P_AproxDistance(player->mo->x - actor->x,
+                                player->mo->y - actor->y) > MELEERANGE)
+                continue;
+        }
+
+        looker->found[allaround] = true;
+        looker->target[allaround] = player->mo;
+        break;
+    }
+
+    looker->newlook[allaround] = look;
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimWork
+//  Takes batches of monsters until there are none left. Sight checks of
+//  a monster and its target evaluation run on the same thread.
+// -----------------------------------------------------------------------------
+
+static void P_FastSimWork (sightctx_t *ctx)
+{
+    const int count = array_size(simlookers);
+    int first;
+
+    while ((first = SDL_AtomicAdd(&simnext, SIMBATCH)) < count)
+    {
+        const int last = MIN(first + SIMBATCH, count);
+
+        for (int i = first ; i < last ; i++)
+        {
+            simlooker_t *const looker = &simlookers[i];
+
+            for (int j = looker->first ; j < looker->first + looker->count ; j++)
+            {
+                simsights[j].seen = P_CheckSightBSP(ctx, simsights[j].t1,
+                                                         simsights[j].t2);
+            }
+
+            P_FastSimEvalLook(looker, false);
+            P_FastSimEvalLook(looker, true);
+        }
+    }
+}
+
+static int P_FastSimThread (void *data)
+{
+    sightctx_t *const ctx = data;
+    int generation = 0;
+
+    SDL_LockMutex(simlock);
+
+    while (true)
+    {
+        while (simgeneration == generation && !simquit)
+        {
+            SDL_CondWait(simstart, simlock);
+        }
+
+        if (simquit)
+        {
+            break;
+        }
+
+        generation = simgeneration;
+        SDL_UnlockMutex(simlock);
+
+        P_FastSimWork(ctx);
+
+        SDL_LockMutex(simlock);
+
+        if (--simbusy == 0)
+        {
+            SDL_CondSignal(simdone);
+        }
+    }
+
+    SDL_UnlockMutex(simlock);
+    return 0;
+}
+
+static void P_FastSimShutdown (void)
+{
+    SDL_LockMutex(simlock);
+    simquit = true;
+    SDL_CondBroadcast(simstart);
+    SDL_UnlockMutex(simlock);
+
+    for (int i = 0 ; i < numsimthreads ; i++)
+    {
+        SDL_WaitThread(simthreads[i], NULL);
+    }
+
+    numsimthreads = 0;
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimAdd
+//  Queues a sight check of t1 at t2, unless REJECT already rules it out
+//  or it is queued. Returns its index in simsights, or -1 if rejected.
+// -----------------------------------------------------------------------------
+
+static int P_FastSimAdd (mobj_t *t1, mobj_t *t2)
+{
+    const int mask = simtablesize - 1;
+    unsigned int hash = P_SimHash(t1, t2) & mask;
+    simsight_t sight;
+
+    if (P_SightRejected(t1, t2))
+    {
+        return -1;
+    }
+
+    while (simtable[hash])
+    {
+        const simsight_t *const other = &simsights[simtable[hash] - 1];
+
+        if (other->t1 == t1 && other->t2 == t2)
+        {
+            return simtable[hash] - 1;
+        }
+
+        hash = (hash + 1) & mask;
+    }
+
+    sight.t1 = t1;
+    sight.t2 = t2;
+    sight.x1 = t1->x;
+    sight.y1 = t1->y;
+    sight.z1 = t1->z;
+    sight.x2 = t2->x;
+    sight.y2 = t2->y;
+    sight.z2 = t2->z;
+    sight.seen = false;
+
+    array_push(simsights, sight);
+    simtable[hash] = array_size(simsights);
+
+    return simtable[hash] - 1;
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimAddLooker
+//  Queues a monster's sight checks and target evaluation.
+// -----------------------------------------------------------------------------
+
+static void P_FastSimAddLooker (mobj_t *mo)
+{
+    const int mask = simtablesize - 1;
+    unsigned int hash = P_SimHash(mo, NULL) & mask;
+    simlooker_t looker;
+
+    looker.mo = mo;
+    looker.first = array_size(simsights);
+    looker.x = mo->x;
+    looker.y = mo->y;
+    looker.z = mo->z;
+    looker.angle = mo->angle;
+    looker.lastlook = mo->lastlook;
+
+    for (int i = 0 ; i < MAXPLAYERS ; i++)
+    {
+        looker.playersight[i] = -1;
+
+        if (playeringame[i] && players[i].mo && players[i].health > 0)
+        {
+            looker.playersight[i] = P_FastSimAdd(mo, players[i].mo);
+        }
+    }
+
+    if (mo->target && !mo->target->player)
+    {
+        P_FastSimAdd(mo, mo->target);
+    }
+
+    // Pairs are unique per looker, so its checks are the ones just added.
+    looker.count = array_size(simsights) - looker.first;
+
+    while (simlooktable[hash])
+    {
+        hash = (hash + 1) & mask;
+    }
+
+    array_push(simlookers, looker);
+    simlooktable[hash] = array_size(simlookers);
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimPrepare
+//  Called by P_Ticker after the players have moved. Monsters whose state
+//  runs out this tic are the ones that look, chase or attack, so their
+//  sight of the players and of their targets is checked in advance, and
+//  the player they would pick as a target.
+// -----------------------------------------------------------------------------
+
+void P_FastSimPrepare (void)
+{
+    thinker_t *th;
+    int count = 0;
+
+    simactive = false;
+
+    if (!fastsim || demorecording || demoplayback || netgame
+    ||  gameversion <= exe_doom_1_2)
+    {
+        return;
+    }
+
+    // Every mobj is a potential looker, keep the table at most half full.
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+        count++;
+    }
+
+    if (simtablesize < count * (MAXPLAYERS + 1) * 2)
+    {
+        while (simtablesize < count * (MAXPLAYERS + 1) * 2)
+        {
+            simtablesize = simtablesize ? simtablesize * 2 : 1024;
+        }
+
+        simtable = I_Realloc(simtable, simtablesize * sizeof(*simtable));
+        simlooktable = I_Realloc(simlooktable,
+                                 simtablesize * sizeof(*simlooktable));
+    }
+
+    memset(simtable, 0, simtablesize * sizeof(*simtable));
+    memset(simlooktable, 0, simtablesize * sizeof(*simlooktable));
+    array_clear(simsights);
+    array_clear(simlookers);
+
+    for (int i = 0 ; i < MAXPLAYERS ; i++)
+    {
+        simplayer_t *const sp = &simplayers[i];
+
+        sp->mo = players[i].mo;
+        sp->x = sp->mo ? sp->mo->x : 0;
+        sp->y = sp->mo ? sp->mo->y : 0;
+        sp->z = sp->mo ? sp->mo->z : 0;
+        sp->health = players[i].health;
+        sp->notarget = players[i].cheats & CF_NOTARGET;
+    }
+
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+        mobj_t *const mo = (mobj_t *) th;
+
+        if (th->function.acp1 != (actionf_p1) P_MobjThinker
+        ||  mo->tics != 1 || mo->health <= 0 || mo->player
+        || !(mo->flags & MF_SHOOTABLE) || mo->info->seestate == S_NULL)
+        {
+            continue;
+        }
+
+        P_FastSimAddLooker(mo);
+    }
+
+    if (array_size(simlookers) == 0)
+    {
+        return;
+    }
+
+    // Level changes, give every context a line mark array of its size.
+    if (simnumlines != numlines)
+    {
+        for (int i = 0 ; i <= numsimthreads ; i++)
+        {
+            simctx[i].linemarks = I_Realloc(simctx[i].linemarks,
+                                            numlines * sizeof(int));
+            memset(simctx[i].linemarks, 0, numlines * sizeof(int));
+            simctx[i].mark = 0;
+        }
+
+        simnumlines = numlines;
+    }
+
+    SDL_AtomicSet(&simnext, 0);
+
+    if (numsimthreads)
+    {
+        SDL_LockMutex(simlock);
+        simbusy = numsimthreads;
+        simgeneration++;
+        SDL_CondBroadcast(simstart);
+        SDL_UnlockMutex(simlock);
+    }
+
+    P_FastSimWork(&simctx[numsimthreads]);
+
+    if (numsimthreads)
+    {
+        SDL_LockMutex(simlock);
+        while (simbusy)
+        {
+            SDL_CondWait(simdone, simlock);
+        }
+        SDL_UnlockMutex(simlock);
+    }
+
+    simactive = true;
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimFinish
+//  Called by P_Ticker after the thinkers, the results are stale from here.
+// -----------------------------------------------------------------------------
+
+void P_FastSimFinish (void)
+{
+    simactive = false;
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimSight
+//  Looks up the result of a sight check made at the start of the tic.
+//  It is only used while neither mobj has moved since then, which is
+//  normally the case: monsters check sight before they move.
+// -----------------------------------------------------------------------------
+
+boolean P_FastSimSight (const mobj_t *t1, const mobj_t *t2, boolean *seen)
+{
+    const int mask = simtablesize - 1;
+    unsigned int hash;
+
+    if (!simactive)
+    {
+        return false;
+    }
+
+    hash = P_SimHash(t1, t2) & mask;
+
+    while (simtable[hash])
+    {
+        const simsight_t *const sight = &simsights[simtable[hash] - 1];
+
+        if (sight->t1 == t1 && sight->t2 == t2)
+        {
+            if (sight->x1 != t1->x || sight->y1 != t1->y || sight->z1 != t1->z
+            ||  sight->x2 != t2->x || sight->y2 != t2->y || sight->z2 != t2->z)
+            {
+                return false;
+            }
+
+            *seen = sight->seen;
+            return true;
+        }
+
+        hash = (hash + 1) & mask;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimLook
+//  Applies the outcome of P_LookForPlayers evaluated at the start of the
+//  tic, if neither the monster nor any player has changed in a way that
+//  could change it. Returns false to make the caller look by itself.
+// -----------------------------------------------------------------------------
+
+boolean P_FastSimLook (mobj_t *actor, boolean allaround, boolean *found)
+{
+    const int mask = simtablesize - 1;
+    const simlooker_t *looker = NULL;
+    unsigned int hash;
+
+    if (!simactive)
+    {
+        return false;
+    }
+
+    hash = P_SimHash(actor, NULL) & mask;
+
+    while (simlooktable[hash])
+    {
+        if (simlookers[simlooktable[hash] - 1].mo == actor)
+        {
+            looker = &simlookers[simlooktable[hash] - 1];
+            break;
+        }
+
+        hash = (hash + 1) & mask;
+    }
+
+    if (looker == NULL
+    ||  looker->x != actor->x || looker->y != actor->y || looker->z != actor->z
+    ||  looker->angle != actor->angle || looker->lastlook != actor->lastlook)
+    {
+        return false;
+    }
+
+    for (int i = 0 ; i < MAXPLAYERS ; i++)
+    {
+        const simplayer_t *const sp = &simplayers[i];
+        const mobj_t *const mo = players[i].mo;
+
+        if (!playeringame[i])
+        {
+            continue;
+        }
+
+        if (sp->mo != mo || sp->health != players[i].health
+        ||  sp->notarget != (players[i].cheats & CF_NOTARGET)
+        ||  (mo && (sp->x != mo->x || sp->y != mo->y || sp->z != mo->z)))
+        {
+            return false;
+        }
+    }
+
+    allaround = allaround != false;
+
+    // R_PointToAngle2 leaves the looker's position in viewx/viewy.
+    if (looker->turned[allaround])
+    {
+        viewx = actor->x;
+        viewy = actor->y;
+    }
+
+    actor->lastlook = looker->newlook[allaround];
+
+    if (looker->found[allaround])
+    {
+        actor->target = looker->target[allaround];
+    }
+
+    *found = looker->found[allaround];
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimBenchmark
+//  Runs the current map for simbench tics without input or rendering,
+//  once serially and twice with fast sim. Prints the tic rate of each
+//  run and checks that both fast sim runs ended in the same state.
+// -----------------------------------------------------------------------------
+
+static unsigned int P_FastSimRun (boolean parallel, double *rate)
+{
+    uint64_t start, elapsed;
+
+    fastsim = parallel;
+
+    // Start from the same state every run.
+    for (int i = 0 ; i < MAXPLAYERS ; i++)
+    {
+        if (playeringame[i])
+        {
+            players[i].playerstate = PST_REBORN;
+        }
+    }
+
+    M_ClearRandom();
+    P_SetupLevel(gameepisode, gamemap);
+
+    start = I_GetTimeUS();
+
+    for (int tic = 0 ; tic < simbench ; tic++)
+    {
+        for (int i = 0 ; i < MAXPLAYERS ; i++)
+        {
+            memset(&players[i].cmd, 0, sizeof(players[i].cmd));
+        }
+
+        P_Ticker();
+    }
+
+    elapsed = MAX(I_GetTimeUS() - start, 1);
+    *rate = simbench * 1000000.0 / elapsed;
+
+    return P_StateHashNow();
+}
+
+void P_FastSimBenchmark (void)
+{
+    const boolean oldfastsim = fastsim;
+    unsigned int serial, first, second;
+    double rate;
+
+    printf("P_FastSimBenchmark: %d tics, %d fast sim threads\n",
+           simbench, numsimthreads + 1);
+
+    serial = P_FastSimRun(false, &rate);
+    printf("  serial:    %8.1f tics/s, state %08x\n", rate, serial);
+    first = P_FastSimRun(true, &rate);
+    printf("  fast sim:  %8.1f tics/s, state %08x\n", rate, first);
+    second = P_FastSimRun(true, &rate);
+    printf("  fast sim:  %8.1f tics/s, state %08x\n", rate, second);
+
+    fastsim = oldfastsim;
+
+    if (first != second)
+    {
+        I_Error("P_FastSimBenchmark: Fast sim is not deterministic, "
+                "state %08x after the first run, %08x after the second.",
+                first, second);
+    }
+
+    printf("P_FastSimBenchmark: Fast sim is deterministic, %s the serial run.\n",
+           first == serial ? "same state as" : "diverged from");
+
+    P_InterceptBenchmark();
+
+    I_Quit();
+}
+
+// -----------------------------------------------------------------------------
+// P_FastSimInit
+// -----------------------------------------------------------------------------
+
+void P_FastSimInit (void)
+{
+    int p;
+
+    //!
+    // @category game
+    //
+    // Check sight of monsters and pick their targets in parallel at
+    // the start of each tic. Faster on maps with thousands of monsters,
+    // but not compatible with the original game: ignored in demos and
+    // netgames.
+    //
+
+    fastsim = M_ParmExists("-fastsim");
+
+    //!
+    // @arg <tics>
+    // @category obscure
+    //
+    // Benchmark the playsim on the starting map: run it for <tics>
+    // tics without rendering, serially and twice with -fastsim, print
+    // the tic rates, check that both fast sim runs end in the same
+    // state. Then time the scan and heap traversal of the intercepts
+    // of traces from every thing, and quit.
+    //
+
+    p = M_CheckParmWithArgs("-simbench", 1);
+
+    if (p)
+    {
+        simbench = MAX(1, atoi(myargv[p + 1]));
+    }
+
+    if (!fastsim && !simbench)
+    {
+        return;
+    }
+
+    simlock = SDL_CreateMutex();
+    simstart = SDL_CreateCond();
+    simdone = SDL_CreateCond();
+
+    if (simlock && simstart && simdone)
+    {
+        const int threads = BETWEEN(0, MAXSIMTHREADS, SDL_GetCPUCount() - 1);
+
+        while (numsimthreads < threads)
+        {
+            simthreads[numsimthreads] = SDL_CreateThread(P_FastSimThread,
+                                                         "P_FastSim",
+                                                         &simctx[numsimthreads]);
+
+            if (simthreads[numsimthreads] == NULL)
+            {
+                break;
+            }
+
+            numsimthreads++;
+        }
+    }
+
+    I_AtExit(P_FastSimShutdown, true);
+}
@@ -0,0 +1,967 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+// Copyright(C) 2016-2025 Julia Nechaevskaya
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-tic playsim state hashing for desync detection.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomstat.h"
+#include "i_swap.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_array.h"
+#include "m_fixed.h"
+#include "m_misc.h"
+#include "net_client.h"
+#include "p_local.h"
+#include "w_wad.h"
+
+
+// [JN] Hash of a single tic, split by subsystem so a mismatch can be
+// narrowed down without a full state dump.
+
+typedef struct
+{
+    int          tic;
+    unsigned int total;
+    unsigned int rng;
+    unsigned int players;
+    unsigned int sectors;
+    unsigned int mobjs;
+    int          nummobjs;
+} statehash_t;
+
+#define STATEHASH_FIELDS  (sizeof(statehash_t) / sizeof(int))
+#define STATEHASH_LUMP    "STATEHSH"
+
+boolean statehash;
+
+static int statehash_dumptic = -1;
+
+// Demo tic counter, reset when a demo starts.
+static int hashtic;
+
+// Hash of the last simulated tic.
+static statehash_t current;
+
+// Hashes being recorded into the demo footer.
+static statehash_t *recorded;
+
+// Hashes read from the footer of the demo being played back.
+static statehash_t *playback;
+static int playback_pos;
+static boolean playback_reported;
+
+// [JN] Per-object hashes of recent tics, indexed by gametic. Other
+// players' hashes arrive a few tics late in network games, and these
+// lists are what narrows a mismatch down to a single object.
+
+#define STATEHASH_HISTORY  128
+
+typedef struct
+{
+    int           gametic;
+    statehash_t   hash;
+    unsigned int  players[MAXPLAYERS];
+    unsigned int *sectors;
+    unsigned int *mobjs;
+    int          *mobjtypes;
+} statehist_t;
+
+static statehist_t history[STATEHASH_HISTORY];
+
+// Kinds of NET_PACKET_TYPE_STATEHASH messages. The per-tic one carries
+// a statehash_t, the others a chunk of one of the per-object lists.
+
+enum
+{
+    SH_TIC = NET_STATEHASH_TIC,
+    SH_PLAYERS,
+    SH_SECTORS,
+    SH_MOBJS,
+    SH_NUMKINDS
+};
+
+static const char *const sh_kindnames[SH_NUMKINDS] = {
+    "tic", "player", "sector", "mobj"
+};
+
+// Tic hashes of other players, waiting for ours of the same tic.
+typedef struct
+{
+    int         player;
+    statehash_t hash;
+} statepeer_t;
+
+static statepeer_t *peer_pending;
+static boolean peer_reported[MAXPLAYERS];
+static boolean peer_named[MAXPLAYERS][SH_NUMKINDS];
+
+// -----------------------------------------------------------------------------
+// FNV-1a over 32-bit words. Cheap enough to run over every mobj each tic.
+// -----------------------------------------------------------------------------
+
+#define HASH_INIT   2166136261u
+#define HASH_PRIME  16777619u
+
+static inline unsigned int HashWord (unsigned int hash, unsigned int value)
+{
+    return (hash ^ value) * HASH_PRIME;
+}
+
+static unsigned int HashMobj (const mobj_t *mo)
+{
+    unsigned int hash = HASH_INIT;
+
+    hash = HashWord(hash, mo->type);
+    hash = HashWord(hash, mo->x);
+    hash = HashWord(hash, mo->y);
+    hash = HashWord(hash, mo->z);
+    hash = HashWord(hash, mo->momx);
+    hash = HashWord(hash, mo->momy);
+    hash = HashWord(hash, mo->momz);
+    hash = HashWord(hash, mo->angle);
+    hash = HashWord(hash, mo->health);
+    hash = HashWord(hash, mo->flags);
+    hash = HashWord(hash, mo->state ? (int)(mo->state - states) : -1);
+    hash = HashWord(hash, mo->tics);
+    hash = HashWord(hash, mo->movedir);
+    hash = HashWord(hash, mo->movecount);
+    hash = HashWord(hash, mo->reactiontime);
+    hash = HashWord(hash, mo->threshold);
+
+    return hash;
+}
+
+static unsigned int HashSector (const sector_t *sec)
+{
+    unsigned int hash = HASH_INIT;
+
+    hash = HashWord(hash, sec->floorheight);
+    hash = HashWord(hash, sec->ceilingheight);
+    hash = HashWord(hash, sec->lightlevel);
+    hash = HashWord(hash, sec->special);
+
+    return hash;
+}
+
+static unsigned int HashPlayer (const player_t *player)
+{
+    unsigned int hash = HASH_INIT;
+    int i;
+
+    hash = HashWord(hash, player->playerstate);
+    hash = HashWord(hash, player->health);
+    hash = HashWord(hash, player->armorpoints);
+    hash = HashWord(hash, player->armortype);
+    hash = HashWord(hash, player->readyweapon);
+    hash = HashWord(hash, player->pendingweapon);
+    hash = HashWord(hash, player->viewheight);
+    hash = HashWord(hash, player->deltaviewheight);
+
+    for (i = 0 ; i < NUMAMMO ; i++)
+    {
+        hash = HashWord(hash, player->ammo[i]);
+    }
+
+    return hash;
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashCompute
+//  Fills in all subsystem hashes for the current playsim state, and the
+//  per-object hashes into hist if it's not NULL.
+// -----------------------------------------------------------------------------
+
+static void P_StateHashCompute (statehash_t *out, statehist_t *hist)
+{
+    thinker_t *th;
+    unsigned int hash;
+    int i;
+
+    // Only the playsim RNG, M_Random is also used by menu and sound code.
+    out->rng = HashWord(HASH_INIT, prndindex);
+
+    if (hist)
+    {
+        array_clear(hist->sectors);
+        array_clear(hist->mobjs);
+        array_clear(hist->mobjtypes);
+    }
+
+    out->players = HASH_INIT;
+    for (i = 0 ; i < MAXPLAYERS ; i++)
+    {
+        hash = playeringame[i] ? HashPlayer(&players[i]) : 0;
+
+        if (playeringame[i])
+        {
+            out->players = HashWord(out->players, hash);
+        }
+        if (hist)
+        {
+            hist->players[i] = hash;
+        }
+    }
+
+    out->sectors = HASH_INIT;
+    for (i = 0 ; i < numsectors ; i++)
+    {
+        hash = HashSector(&sectors[i]);
+        out->sectors = HashWord(out->sectors, hash);
+
+        if (hist)
+        {
+            array_push(hist->sectors, hash);
+        }
+    }
+
+    out->mobjs = HASH_INIT;
+    out->nummobjs = 0;
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+        if (th->function.acp1 == (actionf_p1) P_MobjThinker)
+        {
+            hash = HashMobj((mobj_t *) th);
+            out->mobjs = HashWord(out->mobjs, hash);
+            out->nummobjs++;
+
+            if (hist)
+            {
+                array_push(hist->mobjs, hash);
+                array_push(hist->mobjtypes, ((mobj_t *) th)->type);
+            }
+        }
+    }
+
+    out->total = HASH_INIT;
+    out->total = HashWord(out->total, out->rng);
+    out->total = HashWord(out->total, out->players);
+    out->total = HashWord(out->total, out->sectors);
+    out->total = HashWord(out->total, out->mobjs);
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashDump
+//  Writes the state of every hashed object to a text file. Two dumps
+//  of the same tic can be compared with any diff tool to find the first
+//  diverging object.
+// -----------------------------------------------------------------------------
+
+void P_StateHashDump (const char *filename)
+{
+    FILE *fstream;
+    thinker_t *th;
+    int i, index;
+
+    fstream = M_fopen(filename, "w");
+
+    if (fstream == NULL)
+    {
+        fprintf(stderr, "P_StateHashDump: unable to open %s\n", filename);
+        return;
+    }
+
+    fprintf(fstream, "tic %d gametic %d hash %08x\n",
+            hashtic, gametic, current.total);
+    fprintf(fstream, "rng prndindex %d rndindex %d\n", prndindex, rndindex);
+
+    for (i = 0 ; i < MAXPLAYERS ; i++)
+    {
+        if (playeringame[i])
+        {
+            fprintf(fstream, "player %d hash %08x health %d armor %d weapon %d\n",
+                    i, HashPlayer(&players[i]), players[i].health,
+                    players[i].armorpoints, players[i].readyweapon);
+        }
+    }
+
+    for (i = 0 ; i < numsectors ; i++)
+    {
+        fprintf(fstream, "sector %d hash %08x floor %d ceiling %d light %d\n",
+                i, HashSector(&sectors[i]), sectors[i].floorheight,
+                sectors[i].ceilingheight, sectors[i].lightlevel);
+    }
+
+    index = 0;
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+        if (th->function.acp1 == (actionf_p1) P_MobjThinker)
+        {
+            const mobj_t *mo = (mobj_t *) th;
+
+            fprintf(fstream, "mobj %d hash %08x type %d pos %d %d %d "
+                             "mom %d %d %d health %d state %d tics %d\n",
+                    index++, HashMobj(mo), mo->type, mo->x, mo->y, mo->z,
+                    mo->momx, mo->momy, mo->momz, mo->health,
+                    mo->state ? (int)(mo->state - states) : -1, mo->tics);
+        }
+    }
+
+    fclose(fstream);
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashDiffers
+//  Prints which subsystems of two tic hashes differ. differs[SH_TIC]
+//  stands for the random number index.
+// -----------------------------------------------------------------------------
+
+static void P_StateHashDiffers (const statehash_t *expected,
+                                const statehash_t *got,
+                                boolean differs[SH_NUMKINDS])
+{
+    differs[SH_TIC] = expected->rng != got->rng;
+    differs[SH_PLAYERS] = expected->players != got->players;
+    differs[SH_SECTORS] = expected->sectors != got->sectors;
+    differs[SH_MOBJS] = expected->mobjs != got->mobjs
+                     || expected->nummobjs != got->nummobjs;
+
+    if (differs[SH_TIC])
+    {
+        fprintf(stderr, "  random number index differs\n");
+    }
+    if (differs[SH_PLAYERS])
+    {
+        fprintf(stderr, "  player state differs\n");
+    }
+    if (differs[SH_SECTORS])
+    {
+        fprintf(stderr, "  sector state differs\n");
+    }
+    if (differs[SH_MOBJS])
+    {
+        fprintf(stderr, "  mobj state differs (%d expected, %d here)\n",
+                expected->nummobjs, got->nummobjs);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashList
+//  Returns the per-object hash list of one subsystem.
+// -----------------------------------------------------------------------------
+
+static const unsigned int *P_StateHashList (const statehist_t *hist,
+                                            int kind, int *count)
+{
+    switch (kind)
+    {
+        case SH_PLAYERS:
+            *count = MAXPLAYERS;
+            return hist->players;
+        case SH_SECTORS:
+            *count = array_size(hist->sectors);
+            return hist->sectors;
+        default:
+            *count = array_size(hist->mobjs);
+            return hist->mobjs;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashFirstDiff
+//  Returns the index of the first differing entry of two per-object hash
+//  lists, or -1 if they are the same.
+// -----------------------------------------------------------------------------
+
+static int P_StateHashFirstDiff (const unsigned int *a, int na,
+                                 const unsigned int *b, int nb)
+{
+    const int n = MIN(na, nb);
+    int i;
+
+    for (i = 0 ; i < n ; i++)
+    {
+        if (a[i] != b[i])
+        {
+            return i;
+        }
+    }
+
+    return na != nb ? n : -1;
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashName
+//  Prints the first differing object of a subsystem.
+// -----------------------------------------------------------------------------
+
+static void P_StateHashName (const statehist_t *hist, int kind, int index)
+{
+    if (index < 0)
+    {
+        fprintf(stderr, "  no differing %s found\n", sh_kindnames[kind]);
+    }
+    else if (kind == SH_MOBJS && index < array_size(hist->mobjtypes))
+    {
+        fprintf(stderr, "  first differing mobj: %d (type %d)\n",
+                index, hist->mobjtypes[index]);
+    }
+    else if (kind == SH_MOBJS)
+    {
+        fprintf(stderr, "  first differing mobj: %d (missing here)\n", index);
+    }
+    else
+    {
+        fprintf(stderr, "  first differing %s: %d\n",
+                sh_kindnames[kind], index);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashNameFromDump
+//  Finds the first differing object of each differing subsystem by
+//  comparing against the per-object hashes of a reference dump.
+// -----------------------------------------------------------------------------
+
+static void P_StateHashNameFromDump (const char *filename,
+                                     const statehist_t *hist,
+                                     const boolean differs[SH_NUMKINDS])
+{
+    FILE *fstream;
+    statehist_t ref;
+    char line[256];
+    unsigned int hash;
+    int kind, index, count;
+
+    fstream = M_fopen(filename, "r");
+
+    if (fstream == NULL)
+    {
+        fprintf(stderr, "  no reference dump %s found, make one with "
+                        "\"-statehashdump %d\" using a build that plays "
+                        "this demo correctly to name the first differing "
+                        "object.\n", filename, hashtic);
+        return;
+    }
+
+    memset(&ref, 0, sizeof(ref));
+
+    while (fgets(line, sizeof(line), fstream) != NULL)
+    {
+        if (sscanf(line, "player %d hash %x", &index, &hash) == 2)
+        {
+            if (index >= 0 && index < MAXPLAYERS)
+            {
+                ref.players[index] = hash;
+            }
+        }
+        else if (sscanf(line, "sector %d hash %x", &index, &hash) == 2)
+        {
+            array_push(ref.sectors, hash);
+        }
+        else if (sscanf(line, "mobj %d hash %x", &index, &hash) == 2)
+        {
+            array_push(ref.mobjs, hash);
+        }
+    }
+
+    fclose(fstream);
+
+    for (kind = SH_PLAYERS ; kind < SH_NUMKINDS ; kind++)
+    {
+        if (differs[kind])
+        {
+            const unsigned int *ours = P_StateHashList(hist, kind, &count);
+            const unsigned int *theirs;
+            int refcount;
+
+            theirs = P_StateHashList(&ref, kind, &refcount);
+            index = P_StateHashFirstDiff(theirs, refcount, ours, count);
+            P_StateHashName(hist, kind, index);
+        }
+    }
+
+    array_free(ref.sectors);
+    array_free(ref.mobjs);
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashReport
+//  Describes the first mismatch against the demo's recorded hashes.
+// -----------------------------------------------------------------------------
+
+static void P_StateHashReport (const statehash_t *expected,
+                               const statehist_t *hist)
+{
+    char filename[64];
+    char reference[64];
+    boolean differs[SH_NUMKINDS];
+
+    M_snprintf(filename, sizeof(filename),
+               "statehash-%06d-mismatch.txt", hashtic);
+    M_snprintf(reference, sizeof(reference), "statehash-%06d.txt", hashtic);
+
+    fprintf(stderr, "State hash mismatch at demo tic %d (gametic %d):\n",
+            hashtic, gametic);
+
+    P_StateHashDiffers(expected, &current, differs);
+    P_StateHashNameFromDump(reference, hist, differs);
+
+    P_StateHashDump(filename);
+    fprintf(stderr, "  state written to %s\n", filename);
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashSendObjects
+//  Sends one per-object hash list of a tic to the other players, split
+//  in chunks. A chunk shorter than NET_STATEHASH_MAXWORDS ends the list.
+// -----------------------------------------------------------------------------
+
+static void P_StateHashSendObjects (const statehist_t *hist, int kind)
+{
+    static net_statehash_t msg;
+    const unsigned int *list;
+    int count, n;
+
+    list = P_StateHashList(hist, kind, &count);
+
+    msg.kind = kind;
+    msg.tic = hist->gametic;
+    msg.start = 0;
+
+    do
+    {
+        n = MIN(count - (int) msg.start, NET_STATEHASH_MAXWORDS);
+
+        if (n > 0)
+        {
+            memcpy(msg.words, list + msg.start, n * sizeof(*list));
+        }
+
+        msg.num_words = n;
+        NET_CL_SendStateHash(&msg);
+        msg.start += n;
+    } while (n == NET_STATEHASH_MAXWORDS);
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashCheckPeer
+//  Compares another player's hash of a tic with ours. On the first
+//  mismatch, our object lists of the differing subsystems are sent so
+//  that both sides can name the first differing object.
+// -----------------------------------------------------------------------------
+
+static void P_StateHashCheckPeer (const statepeer_t *peer,
+                                  const statehist_t *hist)
+{
+    boolean differs[SH_NUMKINDS];
+    int kind;
+
+    if (peer->hash.total == hist->hash.total || peer_reported[peer->player])
+    {
+        return;
+    }
+
+    peer_reported[peer->player] = true;
+
+    fprintf(stderr, "State hash mismatch with player %d at gametic %d:\n",
+            peer->player + 1, hist->gametic);
+
+    P_StateHashDiffers(&peer->hash, &hist->hash, differs);
+
+    for (kind = SH_PLAYERS ; kind < SH_NUMKINDS ; kind++)
+    {
+        if (differs[kind])
+        {
+            P_StateHashSendObjects(hist, kind);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashCheckObjects
+//  Compares a chunk of another player's object list with ours.
+// -----------------------------------------------------------------------------
+
+static void P_StateHashCheckObjects (const net_statehash_t *msg)
+{
+    const statehist_t *hist = &history[msg->tic % STATEHASH_HISTORY];
+    const boolean last = msg->num_words < NET_STATEHASH_MAXWORDS;
+    const unsigned int *list;
+    int count, ours, index;
+
+    if (msg->kind >= SH_NUMKINDS || peer_named[msg->player][msg->kind])
+    {
+        return;
+    }
+
+    if (hist->gametic != (int) msg->tic)
+    {
+        fprintf(stderr, "State hash: gametic %d is too old to compare %s "
+                        "hashes with player %d.\n",
+                msg->tic, sh_kindnames[msg->kind], msg->player + 1);
+        peer_named[msg->player][msg->kind] = true;
+        return;
+    }
+
+    list = P_StateHashList(hist, msg->kind, &count);
+
+    // Only the last chunk can tell that our list is longer.
+    ours = MAX(0, count - (int) msg->start);
+    if (!last)
+    {
+        ours = MIN(ours, NET_STATEHASH_MAXWORDS);
+    }
+
+    index = P_StateHashFirstDiff(msg->words, msg->num_words,
+                                 ours > 0 ? list + msg->start : NULL, ours);
+
+    if (index >= 0 || last)
+    {
+        fprintf(stderr, "State hash: compared %s hashes of gametic %d "
+                        "with player %d:\n",
+                sh_kindnames[msg->kind], msg->tic, msg->player + 1);
+        P_StateHashName(hist, msg->kind,
+                        index < 0 ? -1 : (int) msg->start + index);
+        peer_named[msg->player][msg->kind] = true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashNetTicker
+//  Sends our hash of this tic and checks the ones received from others.
+// -----------------------------------------------------------------------------
+
+#define STATEHASH_TICWORDS  6
+
+static void P_StateHashNetTicker (const statehist_t *hist)
+{
+    static net_statehash_t msg;
+    int i;
+
+    msg.kind = SH_TIC;
+    msg.tic = hist->gametic;
+    msg.start = 0;
+    msg.num_words = STATEHASH_TICWORDS;
+    msg.words[0] = hist->hash.total;
+    msg.words[1] = hist->hash.rng;
+    msg.words[2] = hist->hash.players;
+    msg.words[3] = hist->hash.sectors;
+    msg.words[4] = hist->hash.mobjs;
+    msg.words[5] = hist->hash.nummobjs;
+    NET_CL_SendStateHash(&msg);
+
+    while (NET_CL_GetStateHash(&msg))
+    {
+        statepeer_t peer;
+
+        if (msg.player < 0 || msg.player >= MAXPLAYERS)
+        {
+            continue;
+        }
+
+        if (msg.kind != SH_TIC)
+        {
+            P_StateHashCheckObjects(&msg);
+            continue;
+        }
+
+        if (msg.num_words != STATEHASH_TICWORDS)
+        {
+            continue;
+        }
+
+        peer.player = msg.player;
+        peer.hash.tic = msg.tic;
+        peer.hash.total = msg.words[0];
+        peer.hash.rng = msg.words[1];
+        peer.hash.players = msg.words[2];
+        peer.hash.sectors = msg.words[3];
+        peer.hash.mobjs = msg.words[4];
+        peer.hash.nummobjs = msg.words[5];
+        array_push(peer_pending, peer);
+    }
+
+    // Compare the tics we have hashed ourselves, keep the rest for later.
+    // Tics that already left the history are dropped unchecked.
+    for (i = 0 ; i < array_size(peer_pending) ; )
+    {
+        const statepeer_t *peer = &peer_pending[i];
+        const statehist_t *own;
+
+        if (peer->hash.tic > hist->gametic)
+        {
+            i++;
+            continue;
+        }
+
+        own = &history[peer->hash.tic % STATEHASH_HISTORY];
+
+        if (own->gametic == peer->hash.tic)
+        {
+            P_StateHashCheckPeer(peer, own);
+        }
+
+        peer_pending[i] = peer_pending[array_size(peer_pending) - 1];
+        array_ptr(peer_pending)->size--;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashTicker
+//  Called by P_Ticker once per simulated tic.
+// -----------------------------------------------------------------------------
+
+void P_StateHashTicker (void)
+{
+    statehist_t *hist;
+
+    if (!statehash)
+    {
+        return;
+    }
+
+    hist = &history[gametic % STATEHASH_HISTORY];
+
+    P_StateHashCompute(&current, hist);
+    current.tic = hashtic;
+    hist->gametic = gametic;
+    hist->hash = current;
+
+    if (demorecording && !demoplayback)
+    {
+        array_push(recorded, current);
+    }
+
+    if (demoplayback && !playback_reported)
+    {
+        const int size = array_size(playback);
+
+        while (playback_pos < size && playback[playback_pos].tic < hashtic)
+        {
+            playback_pos++;
+        }
+
+        if (playback_pos < size && playback[playback_pos].tic == hashtic
+        &&  playback[playback_pos].total != current.total)
+        {
+            P_StateHashReport(&playback[playback_pos], hist);
+            playback_reported = true;
+        }
+    }
+
+    if (netgame)
+    {
+        P_StateHashNetTicker(hist);
+    }
+
+    if (hashtic == statehash_dumptic)
+    {
+        char filename[32];
+
+        M_snprintf(filename, sizeof(filename), "statehash-%06d.txt", hashtic);
+        P_StateHashDump(filename);
+        printf("P_StateHashTicker: state of tic %d written to %s\n",
+               hashtic, filename);
+    }
+
+    hashtic++;
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashNow
+//  Returns the hash of the current state, without -statehash.
+// -----------------------------------------------------------------------------
+
+unsigned int P_StateHashNow (void)
+{
+    statehash_t now;
+
+    P_StateHashCompute(&now, NULL);
+
+    return now.total;
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashStartDemo
+//  Resets tic counter and forgets any previously recorded hashes.
+// -----------------------------------------------------------------------------
+
+void P_StateHashStartDemo (void)
+{
+    hashtic = 0;
+    array_clear(recorded);
+    array_clear(playback);
+    playback_pos = 0;
+    playback_reported = false;
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashDemoLump
+//  Serializes recorded hashes for the demo footer. Returns lump size.
+// -----------------------------------------------------------------------------
+
+size_t P_StateHashDemoLump (byte **data)
+{
+    const int size = array_size(recorded);
+    int *out;
+    int i;
+
+    if (!statehash || size == 0)
+    {
+        *data = NULL;
+        return 0;
+    }
+
+    out = I_Realloc(NULL, size * sizeof(statehash_t));
+
+    for (i = 0 ; i < size ; i++)
+    {
+        const statehash_t *rec = &recorded[i];
+        int *p = out + i * STATEHASH_FIELDS;
+
+        p[0] = LONG(rec->tic);
+        p[1] = LONG(rec->total);
+        p[2] = LONG(rec->rng);
+        p[3] = LONG(rec->players);
+        p[4] = LONG(rec->sectors);
+        p[5] = LONG(rec->mobjs);
+        p[6] = LONG(rec->nummobjs);
+    }
+
+    *data = (byte *) out;
+    return size * sizeof(statehash_t);
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashLoadDemo
+//  Looks up the hash lump in a demo footer, which is a small PWAD
+//  appended after the demo end marker.
+// -----------------------------------------------------------------------------
+
+void P_StateHashLoadDemo (const byte *footer, int length)
+{
+    wadinfo_t header;
+    int i;
+
+    if (!statehash || length < (int) sizeof(header))
+    {
+        return;
+    }
+
+    memcpy(&header, footer, sizeof(header));
+
+    if (strncmp(header.identification, "PWAD", 4))
+    {
+        return;
+    }
+
+    header.numlumps = LONG(header.numlumps);
+    header.infotableofs = LONG(header.infotableofs);
+
+    for (i = 0 ; i < header.numlumps ; i++)
+    {
+        filelump_t fileinfo;
+        const int ofs = header.infotableofs + i * sizeof(fileinfo);
+        int j, count, filepos, size;
+
+        if (ofs < 0 || ofs + (int) sizeof(fileinfo) > length)
+        {
+            return;
+        }
+
+        memcpy(&fileinfo, footer + ofs, sizeof(fileinfo));
+
+        if (strncmp(fileinfo.name, STATEHASH_LUMP, 8))
+        {
+            continue;
+        }
+
+        filepos = LONG(fileinfo.filepos);
+        size = LONG(fileinfo.size);
+
+        if (filepos < 0 || size < 0 || filepos + size > length)
+        {
+            return;
+        }
+
+        count = size / sizeof(statehash_t);
+
+        for (j = 0 ; j < count ; j++)
+        {
+            const byte *p = footer + filepos + j * sizeof(statehash_t);
+            int v[STATEHASH_FIELDS];
+            statehash_t rec;
+
+            memcpy(v, p, sizeof(v));
+            rec.tic = LONG(v[0]);
+            rec.total = LONG(v[1]);
+            rec.rng = LONG(v[2]);
+            rec.players = LONG(v[3]);
+            rec.sectors = LONG(v[4]);
+            rec.mobjs = LONG(v[5]);
+            rec.nummobjs = LONG(v[6]);
+            array_push(playback, rec);
+        }
+
+        printf("P_StateHashLoadDemo: %d tic hashes found in demo footer.\n",
+               count);
+        return;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// P_StateHashInit
+// -----------------------------------------------------------------------------
+
+void P_StateHashInit (void)
+{
+    int p;
+
+    //!
+    // @category demo
+    //
+    // Hash the playsim state every tic. Hashes are stored in the footer
+    // of recorded demos and checked during playback. In network games,
+    // they are compared with other players who also use -statehash.
+    //
+
+    statehash = M_ParmExists("-statehash");
+
+    //!
+    // @arg <tic>
+    // @category demo
+    //
+    // Write the full playsim state of demo tic <tic> into a text file.
+    // Implies -statehash.
+    //
+
+    p = M_CheckParmWithArgs("-statehashdump", 1);
+
+    if (p)
+    {
+        statehash = true;
+        statehash_dumptic = atoi(myargv[p + 1]);
+    }
+
+    for (p = 0 ; p < STATEHASH_HISTORY ; p++)
+    {
+        history[p].gametic = -1;
+    }
+
+    // [JN] Hashes travel in their own packets, which only servers that
+    // negotiated the International Doom protocol relay.
+    if (statehash && netgame && !NET_CL_StateHashEnabled())
+    {
+        printf("P_StateHashInit: the server doesn't relay state hashes, "
+               "they are not compared in this game.\n");
+    }
+}
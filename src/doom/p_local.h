@@ -223,6 +223,20 @@ extern void P_NoiseAlert (mobj_t *target, mobj_t *emmiter);
 
 extern boolean P_CheckMeleeRange (mobj_t *actor);
 
+// -----------------------------------------------------------------------------
+// P_FASTSIM
+// -----------------------------------------------------------------------------
+
+extern boolean fastsim;
+extern int simbench;
+
+extern void P_FastSimInit (void);
+extern void P_FastSimPrepare (void);
+extern void P_FastSimFinish (void);
+extern boolean P_FastSimSight (const mobj_t *t1, const mobj_t *t2, boolean *seen);
+extern boolean P_FastSimLook (mobj_t *actor, boolean allaround, boolean *found);
+extern void P_FastSimBenchmark (void);
+
 // -----------------------------------------------------------------------------
 // P_FLOOR
 // -----------------------------------------------------------------------------
@@ -296,6 +310,20 @@ extern void T_MoveFloor (floormove_t *floor);
 extern result_e T_MovePlane (sector_t *sector, fixed_t speed, fixed_t dest,
                              boolean crush, int floorOrCeiling, int direction);
 
+// -----------------------------------------------------------------------------
+// P_HASH
+// -----------------------------------------------------------------------------
+
+extern boolean statehash;
+
+extern void P_StateHashInit (void);
+extern void P_StateHashTicker (void);
+extern void P_StateHashStartDemo (void);
+extern void P_StateHashLoadDemo (const byte *footer, int length);
+extern void P_StateHashDump (const char *filename);
+extern unsigned int P_StateHashNow (void);
+extern size_t P_StateHashDemoLump (byte **data);
+
 // -----------------------------------------------------------------------------
 // P_INTER
 // -----------------------------------------------------------------------------
@@ -463,6 +491,7 @@ extern void    P_LineOpening (line_t* linedef);
 extern void    P_MakeDivline (line_t* li, divline_t* dl);
 extern void    P_SetThingPosition (mobj_t *thing);
 extern void    P_UnsetThingPosition (mobj_t *thing);
+extern void    P_InterceptBenchmark (void);
 
 extern fixed_t opentop;
 extern fixed_t openbottom;
@@ -662,6 +691,22 @@ extern const char *level_name;
 extern fixed_t topslope;
 extern fixed_t bottomslope;
 
+// [JN] Line of sight state, threads check sight with their own.
+typedef struct
+{
+    fixed_t   sightzstart;  // eye z of looker
+    fixed_t   topslope;
+    fixed_t   bottomslope;  // slopes to top and bottom of target
+    divline_t strace;       // from t1 to t2
+    fixed_t   t2x;
+    fixed_t   t2y;
+    int      *linemarks;    // checked lines, NULL to use validcount
+    int       mark;
+} sightctx_t;
+
+extern boolean P_SightRejected (const mobj_t *t1, const mobj_t *t2);
+extern boolean P_CheckSightBSP (sightctx_t *ctx, const mobj_t *t1, const mobj_t *t2);
+
 // -----------------------------------------------------------------------------
 // P_SPEC
 // -----------------------------------------------------------------------------
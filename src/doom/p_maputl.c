@@ -24,6 +24,8 @@
 
 #include <stdlib.h>
 #include "i_system.h" // [crispy] I_Realloc()
+#include "i_timer.h"
+#include "m_array.h"
 #include "m_bbox.h"
 #include "m_misc.h"
 #include "doomstat.h"
@@ -649,6 +651,14 @@ P_BlockThingsIterator
 static intercept_t*	intercepts; // [crispy] remove INTERCEPTS limit
 intercept_t*	intercept_p;
 
+// [JN] Min-heap of intercept keys for P_TraverseIntercepts, sized along
+// with the intercepts array. A key holds the biased frac in its high half
+// and the intercept index in its low half.
+static uint64_t*	intercept_heap;
+
+// [JN] Bumped whenever a new trace starts filling the intercepts array.
+static unsigned int	intercept_traces;
+
 // [crispy] remove INTERCEPTS limit
 // taken from PrBoom+/src/p_maputl.c:422-433
 static void check_intercept(void)
@@ -660,6 +670,7 @@ static void check_intercept(void)
 	{
 		num_intercepts = num_intercepts ? num_intercepts * 2 : MAXINTERCEPTS_ORIGINAL;
 		intercepts = I_Realloc(intercepts, sizeof(*intercepts) * num_intercepts);
+		intercept_heap = I_Realloc(intercept_heap, sizeof(*intercept_heap) * num_intercepts);
 		intercept_p = intercepts + offset;
 	}
 }
@@ -850,22 +861,22 @@ static boolean PIT_AddThingIntercepts (mobj_t* thing)
 
 
 //
-// P_TraverseIntercepts
+// P_TraverseInterceptsScan
 // Returns true if the traverser function returns true
 // for all lines.
-// 
-boolean
-P_TraverseIntercepts
+// [JN] The original traversal, picking the closest remaining intercept
+// with a full scan for each of the given number of steps.
+//
+static boolean
+P_TraverseInterceptsScan
 ( traverser_t	func,
-  fixed_t	maxfrac )
+  fixed_t	maxfrac,
+  int		count )
 {
-    int			count;
     fixed_t		dist;
     intercept_t*	scan;
     intercept_t*	in;
 	
-    count = intercept_p - intercepts;
-    
     in = 0;			// shut up compiler warning
 	
     while (count--)
@@ -883,18 +894,6 @@ P_TraverseIntercepts
 	if (dist > maxfrac)
 	    return true;	// checked everything in range		
 
-#if 0  // UNUSED
-    {
-	// don't check these yet, there may be others inserted
-	in = scan = intercepts;
-	for ( scan = intercepts ; scan<intercept_p ; scan++)
-	    if (scan->frac > maxfrac)
-		*in++ = *scan;
-	intercept_p = in;
-	return false;
-    }
-#endif
-
         if ( !func (in) )
 	    return false;	// don't bother going farther
 
@@ -904,6 +903,92 @@ P_TraverseIntercepts
     return true;		// everything was traversed
 }
 
+// [JN] Restore the heap property below the given slot.
+static void P_SiftInterceptHeap (uint64_t *heap, int slot, const int count)
+{
+    const uint64_t key = heap[slot];
+
+    for (int child = 2 * slot + 1 ; child < count ; child = 2 * slot + 1)
+    {
+        if (child + 1 < count && heap[child + 1] < heap[child])
+        {
+            child++;
+        }
+
+        if (key <= heap[child])
+        {
+            break;
+        }
+
+        heap[slot] = heap[child];
+        slot = child;
+    }
+
+    heap[slot] = key;
+}
+
+//
+// P_TraverseIntercepts
+// Returns true if the traverser function returns true
+// for all lines.
+// [JN] Intercepts in range are put in a min-heap once, then popped in
+// order, instead of scanning the whole array for every step. Keys are
+// unique by index, so equal fracs are visited in the order they were
+// added, exactly as the scan does. If a traverser starts another trace,
+// the array now holds that trace, and the rest is left to the scan,
+// just as it would have been.
+//
+boolean
+P_TraverseIntercepts
+( traverser_t	func,
+  fixed_t	maxfrac )
+{
+    const unsigned int trace = intercept_traces;
+    int count = intercept_p - intercepts;
+    int heapcount = 0;
+
+    // The scan can't tell unvisited intercepts from visited ones here.
+    if (maxfrac == INT_MAX)
+    {
+        return P_TraverseInterceptsScan(func, maxfrac, count);
+    }
+
+    for (int i = 0 ; i < count ; i++)
+    {
+        if (intercepts[i].frac <= maxfrac)
+        {
+            intercept_heap[heapcount++] =
+                ((uint64_t)((uint32_t)intercepts[i].frac ^ 0x80000000u) << 32) | (uint32_t)i;
+        }
+    }
+
+    for (int i = heapcount / 2 - 1 ; i >= 0 ; i--)
+    {
+        P_SiftInterceptHeap(intercept_heap, i, heapcount);
+    }
+
+    while (heapcount > 0)
+    {
+        intercept_t *const in = &intercepts[(uint32_t)intercept_heap[0]];
+
+        intercept_heap[0] = intercept_heap[--heapcount];
+        P_SiftInterceptHeap(intercept_heap, 0, heapcount);
+        count--;
+
+        if (!func(in))
+            return false;	// don't bother going farther
+
+        in->frac = INT_MAX;
+
+        if (intercept_traces != trace)
+        {
+            return P_TraverseInterceptsScan(func, maxfrac, count);
+        }
+    }
+
+    return true;		// everything was traversed
+}
+
 
 // Intercepts Overrun emulation, from PrBoom-plus.
 // Thanks to Andrey Budko (entryway) for researching this and his 
@@ -1066,6 +1151,7 @@ P_PathTraverse
 		
     validcount++;
     intercept_p = intercepts;
+    intercept_traces++;
 	
     if ( ((x1-bmaporgx)&(MAPBLOCKSIZE-1)) == 0)
 	x1 += FRACUNIT;	// don't side exactly on a line
@@ -1173,4 +1259,167 @@ P_PathTraverse
 }
 
 
+// -----------------------------------------------------------------------------
+// P_InterceptBenchmark
+//  [JN] Part of -simbench. Compares P_TraverseInterceptsScan with the
+//  heap traversal on the same intercept sets, captured from traces in
+//  eight directions from every thing on the map. Each set is traversed
+//  completely, and up to the first one-sided line like a hitscan, and
+//  both traversals must visit the same intercepts in the same order.
+// -----------------------------------------------------------------------------
+
+#define BENCH_PASSES 5
+
+static intercept_t *bench_intercepts;
+static int         *bench_sets;
+static unsigned int bench_order;
+
+static boolean PTR_BenchCapture (intercept_t *in)
+{
+    array_push(bench_sets, array_size(bench_intercepts));
+
+    for (const intercept_t *i = intercepts ; i < intercept_p ; i++)
+    {
+        array_push(bench_intercepts, *i);
+    }
+
+    return false;
+}
+
+static boolean PTR_BenchAll (intercept_t *in)
+{
+    bench_order = bench_order * 31 + (unsigned int)(in - intercepts);
+    return true;
+}
+
+static boolean PTR_BenchSolid (intercept_t *in)
+{
+    bench_order = bench_order * 31 + (unsigned int)(in - intercepts);
+    return !in->isaline || (in->d.line->flags & ML_TWOSIDED);
+}
+
+// Traverses every set with func, with the scan, the heap or, if func is
+// NULL, not at all to time copying the sets alone. Returns microseconds.
+
+static uint64_t P_BenchTraverse (traverser_t func, boolean heap)
+{
+    const int numsets = array_size(bench_sets);
+    const uint64_t start = I_GetTimeUS();
+
+    for (int set = 0 ; set < numsets ; set++)
+    {
+        const int first = bench_sets[set];
+        const int last = set + 1 < numsets ? bench_sets[set + 1]
+                                           : array_size(bench_intercepts);
+
+        intercept_p = intercepts;
+
+        for (int i = first ; i < last ; i++)
+        {
+            check_intercept();
+            *intercept_p++ = bench_intercepts[i];
+        }
+
+        if (func == NULL)
+        {
+            continue;
+        }
+
+        if (heap)
+        {
+            P_TraverseIntercepts(func, FRACUNIT);
+        }
+        else
+        {
+            P_TraverseInterceptsScan(func, FRACUNIT, last - first);
+        }
+    }
+
+    return I_GetTimeUS() - start;
+}
+
+static void P_BenchCompare (const char *name, traverser_t func)
+{
+    const int numsets = array_size(bench_sets);
+    uint64_t copy = UINT64_MAX, scan = UINT64_MAX, heap = UINT64_MAX;
+    unsigned int scanorder, heaporder;
+
+    for (int pass = 0 ; pass < BENCH_PASSES ; pass++)
+    {
+        copy = MIN(copy, P_BenchTraverse(NULL, false));
+        bench_order = 0;
+        scan = MIN(scan, P_BenchTraverse(func, false));
+        scanorder = bench_order;
+        bench_order = 0;
+        heap = MIN(heap, P_BenchTraverse(func, true));
+        heaporder = bench_order;
+
+        if (scanorder != heaporder)
+        {
+            I_Error("P_InterceptBenchmark: Scan and heap visit intercepts "
+                    "in a different order.");
+        }
+    }
+
+    // Copying the sets back takes the same time for both, leave it out.
+    printf("  %-18s %9.1f ns scan, %9.1f ns heap per set\n", name,
+           (double)(scan - MIN(copy, scan)) * 1000.0 / numsets,
+           (double)(heap - MIN(copy, heap)) * 1000.0 / numsets);
+}
 
+void P_InterceptBenchmark (void)
+{
+    const boolean oldsafe = safe_intercept;
+    int numsets, largest = 0;
+
+    // Stop traces at the intercepts limit, without overrun emulation.
+    safe_intercept = true;
+
+    for (thinker_t *th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+        if (th->function.acp1 == (actionf_p1) P_MobjThinker)
+        {
+            const mobj_t *mo = (mobj_t *) th;
+
+            for (int dir = 0 ; dir < 8 ; dir++)
+            {
+                const int an = (dir * ANG45) >> ANGLETOFINESHIFT;
+
+                P_PathTraverse(mo->x, mo->y,
+                               mo->x + (MISSILERANGE >> FRACBITS) * finecosine[an],
+                               mo->y + (MISSILERANGE >> FRACBITS) * finesine[an],
+                               PT_ADDLINES | PT_ADDTHINGS, PTR_BenchCapture);
+            }
+        }
+    }
+
+    safe_intercept = oldsafe;
+    numsets = array_size(bench_sets);
+
+    if (numsets == 0)
+    {
+        printf("P_InterceptBenchmark: no intercepts on this map.\n");
+        return;
+    }
+
+    for (int set = 0 ; set < numsets ; set++)
+    {
+        const int last = set + 1 < numsets ? bench_sets[set + 1]
+                                           : array_size(bench_intercepts);
+
+        largest = MAX(largest, last - bench_sets[set]);
+    }
+
+    printf("P_InterceptBenchmark: %d intercept sets, %.1f intercepts "
+           "on average, %d at most\n", numsets,
+           (double) array_size(bench_intercepts) / numsets, largest);
+
+    P_BenchCompare("all intercepts:", PTR_BenchAll);
+    P_BenchCompare("up to solid wall:", PTR_BenchSolid);
+
+    printf("P_InterceptBenchmark: Scan and heap visit intercepts "
+           "in the same order.\n");
+
+    array_free(bench_intercepts);
+    array_free(bench_sets);
+}
@@ -758,9 +758,6 @@ P_SpawnMobjSafe
     mobj->health = info->spawnhealth;
     // [JN] Resurrected monsters counter (not resurrected at spawn).
     mobj->resurrected = false;
-    // [JN] Initialize animated brightmaps;
-    mobj->bmap_flick = 0;
-    mobj->bmap_glow = 0;
 
     if (gameskill != sk_nightmare)
 	mobj->reactiontime = info->reactiontime;
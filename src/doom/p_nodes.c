@@ -0,0 +1,864 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+// Copyright(C) 2016-2025 Julia Nechaevskaya
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Built-in node builder for maps with missing or stale nodes.
+//	Produces ZDBSP (XNOD) nodes, which are cached on disk.
+//
+
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "i_swap.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_array.h"
+#include "m_bbox.h"
+#include "m_config.h"
+#include "m_misc.h"
+#include "p_local.h"
+#include "sha1.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "p_extnodes.h"
+
+
+// Bump when the builder output changes, so stale cache files are ignored.
+#define NB_VERSION      2
+
+// Partition selection: cost of one split against the side imbalance,
+// and how many candidate partitions are tried per node.
+#define NB_SPLITCOST    8
+#define NB_CANDIDATES   64
+
+// Distance in map units below which a point is on the partition line.
+#define NB_EPSILON      (1.0 / 256)
+
+// Guard against degenerate input that would never become convex.
+#define NB_MAXDEPTH     512
+
+// Smallest subtree that is worth handing over to another thread.
+#define NB_THREADSEGS   512
+
+#define NB_VERTEXHASH   4096
+
+typedef struct bseg_s
+{
+    fixed_t x1, y1, x2, y2;
+    int v1, v2;             // original vertex, -1 for split points
+    int linedef;
+    int side;
+    struct bseg_s *next;
+} bseg_t;
+
+typedef struct bnode_s
+{
+    short x, y, dx, dy;
+    short bbox[2][4];
+    struct bnode_s *child[2];
+    bseg_t *segs;           // leaf only
+} bnode_t;
+
+typedef struct
+{
+    short x, y, dx, dy;
+    double len;
+} partition_t;
+
+typedef struct
+{
+    bseg_t *segs;
+    int count;
+    int depth;
+    bnode_t *node;
+    const char *error;      // set on failure, raised by the main thread
+} buildjob_t;
+
+enum
+{
+    SIDE_FRONT,
+    SIDE_BACK,
+    SIDE_SPLIT
+};
+
+static boolean buildnodes;
+static int threaddepth;
+
+// -----------------------------------------------------------------------------
+// P_NodeBuildInit
+// -----------------------------------------------------------------------------
+
+void P_NodeBuildInit (void)
+{
+    int cpus = SDL_GetCPUCount();
+
+    //!
+    // @category mod
+    //
+    // Always build map nodes with the built-in node builder,
+    // ignoring the nodes stored in the WAD.
+    //
+
+    buildnodes = M_ParmExists("-buildnodes");
+
+    // Split the top of the tree into up to 16 threads.
+    threaddepth = 0;
+    while (threaddepth < 4 && (1 << threaddepth) < cpus)
+    {
+        threaddepth++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// P_NodesNeeded
+//  Check if the nodes of a map are missing or don't match its geometry.
+// -----------------------------------------------------------------------------
+
+static boolean P_MapLumpEmpty (int lumpnum, const char *name)
+{
+    return lumpnum >= numlumps
+        || strncasecmp(lumpinfo[lumpnum]->name, name, 8)
+        || W_LumpLength(lumpnum) <= 0;
+}
+
+static boolean P_VanillaNodesStale (int lumpnum)
+{
+    const int nsegs = W_LumpLength(lumpnum + ML_SEGS) / sizeof(mapseg_t);
+    const int nsubs = W_LumpLength(lumpnum + ML_SSECTORS) / sizeof(mapsubsector_t);
+    const int nnodes = W_LumpLength(lumpnum + ML_NODES) / sizeof(mapnode_t);
+    const mapseg_t *ms = W_CacheLumpNum(lumpnum + ML_SEGS, PU_STATIC);
+    const mapsubsector_t *mss = W_CacheLumpNum(lumpnum + ML_SSECTORS, PU_STATIC);
+    const mapnode_t *mn = W_CacheLumpNum(lumpnum + ML_NODES, PU_STATIC);
+    boolean stale = (nsegs == 0 || nsubs == 0);
+
+    for (int i = 0; i < nsegs && !stale; i++)
+    {
+        stale = (unsigned short)SHORT(ms[i].v1) >= numvertexes
+             || (unsigned short)SHORT(ms[i].v2) >= numvertexes
+             || (unsigned short)SHORT(ms[i].linedef) >= numlines;
+    }
+
+    for (int i = 0; i < nsubs && !stale; i++)
+    {
+        stale = (unsigned short)SHORT(mss[i].firstseg)
+              + (unsigned short)SHORT(mss[i].numsegs) > nsegs;
+    }
+
+    for (int i = 0; i < nnodes && !stale; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            const unsigned short child = SHORT(mn[i].children[j]);
+
+            if (child & NF_SUBSECTOR_VANILLA)
+                stale |= (child & ~NF_SUBSECTOR_VANILLA) >= nsubs;
+            else
+                stale |= child >= nnodes;
+        }
+    }
+
+    W_ReleaseLumpNum(lumpnum + ML_SEGS);
+    W_ReleaseLumpNum(lumpnum + ML_SSECTORS);
+    W_ReleaseLumpNum(lumpnum + ML_NODES);
+
+    return stale;
+}
+
+boolean P_NodesNeeded (int lumpnum, mapformat_t format)
+{
+    if (buildnodes)
+    {
+        return true;
+    }
+
+    if (P_MapLumpEmpty(lumpnum + ML_NODES, "NODES"))
+    {
+        return true;
+    }
+
+    // Extended formats are self-contained in the NODES lump.
+    if (format & (MFMT_ZDBSPX | MFMT_ZDBSPZ | MFMT_DEEPBSP))
+    {
+        return false;
+    }
+
+    if (P_MapLumpEmpty(lumpnum + ML_SEGS, "SEGS")
+    ||  P_MapLumpEmpty(lumpnum + ML_SSECTORS, "SSECTORS"))
+    {
+        return true;
+    }
+
+    if (P_VanillaNodesStale(lumpnum))
+    {
+        fprintf(stderr, "P_NodesNeeded: nodes don't match map geometry\n");
+        return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// Partitioning
+// -----------------------------------------------------------------------------
+
+// Signed distance of a point to the partition. Positive values are in front,
+// matching R_PointOnSide().
+static inline double PointDist (const partition_t *p, fixed_t x, fixed_t y)
+{
+    return (p->dy * ((double)x / FRACUNIT - p->x)
+          - p->dx * ((double)y / FRACUNIT - p->y)) / p->len;
+}
+
+static int ClassifySeg (const partition_t *p, const bseg_t *s,
+                        double *d1, double *d2)
+{
+    *d1 = PointDist(p, s->x1, s->y1);
+    *d2 = PointDist(p, s->x2, s->y2);
+
+    if (fabs(*d1) < NB_EPSILON && fabs(*d2) < NB_EPSILON)
+    {
+        // On the partition line: segs facing the same way go in front.
+        const double dot = (double)(s->x2 - s->x1) * p->dx
+                         + (double)(s->y2 - s->y1) * p->dy;
+
+        return dot > 0 ? SIDE_FRONT : SIDE_BACK;
+    }
+
+    if (*d1 > -NB_EPSILON && *d2 > -NB_EPSILON)
+        return SIDE_FRONT;
+
+    if (*d1 < NB_EPSILON && *d2 < NB_EPSILON)
+        return SIDE_BACK;
+
+    return SIDE_SPLIT;
+}
+
+// Partitions always run along a whole linedef, so they are exact
+// in map units and can be stored in a node as is. Nodes keep dx and dy
+// in 16 bits: longer linedefs are shortened by the greatest common
+// divisor of both, which keeps the direction exact. If that is still
+// too long, the linedef can't be a partition.
+static boolean SegPartition (const bseg_t *s, partition_t *p)
+{
+    const line_t *l = &lines[s->linedef];
+    const vertex_t *a = s->side ? l->v2 : l->v1;
+    const vertex_t *b = s->side ? l->v1 : l->v2;
+    int dx = (b->x >> FRACBITS) - (a->x >> FRACBITS);
+    int dy = (b->y >> FRACBITS) - (a->y >> FRACBITS);
+
+    if (abs(dx) > SHRT_MAX || abs(dy) > SHRT_MAX)
+    {
+        int g = abs(dx), r = abs(dy);
+
+        while (r)
+        {
+            const int t = g % r;
+
+            g = r;
+            r = t;
+        }
+
+        dx /= g;
+        dy /= g;
+
+        if (abs(dx) > SHRT_MAX || abs(dy) > SHRT_MAX)
+            return false;
+    }
+
+    p->x = a->x >> FRACBITS;
+    p->y = a->y >> FRACBITS;
+    p->dx = dx;
+    p->dy = dy;
+    p->len = sqrt((double)dx * dx + (double)dy * dy);
+    return true;
+}
+
+static boolean ChoosePartition (const bseg_t *segs, int count, partition_t *best)
+{
+    int step = count > NB_CANDIDATES ? count / NB_CANDIDATES : 1;
+    int bestscore = INT_MAX;
+
+    while (true)
+    {
+        int i = 0;
+
+        for (const bseg_t *c = segs; c; c = c->next, i++)
+        {
+            partition_t p;
+            int front = 0, back = 0, splits = 0;
+            double d1, d2;
+
+            if (i % step || !SegPartition(c, &p))
+                continue;
+
+            for (const bseg_t *s = segs; s; s = s->next)
+            {
+                switch (ClassifySeg(&p, s, &d1, &d2))
+                {
+                    case SIDE_FRONT:
+                        front++;
+                        break;
+                    case SIDE_BACK:
+                        back++;
+                        break;
+                    default:
+                        splits++;
+                        break;
+                }
+
+                if (splits * NB_SPLITCOST >= bestscore)
+                    break;
+            }
+
+            // A partition with nothing behind it means this seg is
+            // a boundary of a convex region.
+            if (back + splits == 0)
+                continue;
+
+            const int score = splits * NB_SPLITCOST + abs(front - back);
+
+            if (score < bestscore)
+            {
+                bestscore = score;
+                *best = p;
+            }
+        }
+
+        // Only call a set convex after every seg has been tried.
+        if (bestscore < INT_MAX || step == 1)
+            return bestscore < INT_MAX;
+
+        step = 1;
+    }
+}
+
+// Tree building runs on several threads, where I_Error must not be
+// called. Failures are recorded in *error instead and raised by the main
+// thread once building is done.
+
+static bseg_t *NewSeg (const bseg_t *from, const char **error)
+{
+    bseg_t *s = malloc(sizeof(*s));
+
+    if (s == NULL)
+    {
+        *error = "out of memory";
+        return NULL;
+    }
+
+    *s = *from;
+    return s;
+}
+
+static void AddSeg (bseg_t *s, int side, bseg_t **lists, int *counts)
+{
+    s->next = lists[side];
+    lists[side] = s;
+    counts[side]++;
+}
+
+static void SplitSeg (bseg_t *s, double d1, double d2,
+                      bseg_t **lists, int *counts, const char **error)
+{
+    const int side1 = d1 > 0 ? SIDE_FRONT : SIDE_BACK;
+    double ax = s->x1, ay = s->y1, bx = s->x2, by = s->y2;
+    double da = d1, db = d2;
+    fixed_t ix, iy;
+    bseg_t *s2;
+
+    // Compute the split point from a fixed endpoint order, so both
+    // sides of a linedef are cut at exactly the same vertex.
+    if (s->x1 > s->x2 || (s->x1 == s->x2 && s->y1 > s->y2))
+    {
+        ax = s->x2; ay = s->y2; da = d2;
+        bx = s->x1; by = s->y1; db = d1;
+    }
+
+    ix = (fixed_t)lround(ax + (bx - ax) * (da / (da - db)));
+    iy = (fixed_t)lround(ay + (by - ay) * (da / (da - db)));
+
+    if ((ix == s->x1 && iy == s->y1) || (ix == s->x2 && iy == s->y2)
+    ||  (s2 = NewSeg(s, error)) == NULL)
+    {
+        // Rounded onto an endpoint, or out of memory: keep the seg whole.
+        AddSeg(s, fabs(d1) > fabs(d2) ? side1 : side1 ^ 1, lists, counts);
+        return;
+    }
+
+    s2->x1 = ix;
+    s2->y1 = iy;
+    s2->v1 = -1;
+    s->x2 = ix;
+    s->y2 = iy;
+    s->v2 = -1;
+
+    AddSeg(s, side1, lists, counts);
+    AddSeg(s2, side1 ^ 1, lists, counts);
+}
+
+static void SegsBBox (const bseg_t *segs, short *bbox)
+{
+    fixed_t box[4] = { INT_MIN, INT_MAX, INT_MAX, INT_MIN };
+
+    for (const bseg_t *s = segs; s; s = s->next)
+    {
+        box[BOXTOP] = MAX(box[BOXTOP], MAX(s->y1, s->y2));
+        box[BOXBOTTOM] = MIN(box[BOXBOTTOM], MIN(s->y1, s->y2));
+        box[BOXLEFT] = MIN(box[BOXLEFT], MIN(s->x1, s->x2));
+        box[BOXRIGHT] = MAX(box[BOXRIGHT], MAX(s->x1, s->x2));
+    }
+
+    // Round outwards to whole map units.
+    bbox[BOXTOP] = (box[BOXTOP] + FRACUNIT - 1) >> FRACBITS;
+    bbox[BOXBOTTOM] = box[BOXBOTTOM] >> FRACBITS;
+    bbox[BOXLEFT] = box[BOXLEFT] >> FRACBITS;
+    bbox[BOXRIGHT] = (box[BOXRIGHT] + FRACUNIT - 1) >> FRACBITS;
+}
+
+// -----------------------------------------------------------------------------
+// Tree building
+// -----------------------------------------------------------------------------
+
+static int BuildJob (void *data);
+
+static bnode_t *BuildNode (bseg_t *segs, int count, int depth,
+                           const char **error)
+{
+    bnode_t *node = calloc(1, sizeof(*node));
+    bseg_t *lists[2] = { NULL, NULL };
+    int counts[2] = { 0, 0 };
+    partition_t p;
+
+    if (node == NULL)
+    {
+        *error = "out of memory";
+        return NULL;
+    }
+
+    // After a failure, finish quickly with leaves.
+    if (*error || depth >= NB_MAXDEPTH || !ChoosePartition(segs, count, &p))
+    {
+        node->segs = segs;
+        return node;
+    }
+
+    while (segs)
+    {
+        bseg_t *s = segs;
+        double d1, d2;
+        int side;
+
+        segs = segs->next;
+        side = ClassifySeg(&p, s, &d1, &d2);
+
+        if (side == SIDE_SPLIT)
+            SplitSeg(s, d1, d2, lists, counts, error);
+        else
+            AddSeg(s, side, lists, counts);
+    }
+
+    node->x = p.x;
+    node->y = p.y;
+    node->dx = p.dx;
+    node->dy = p.dy;
+    SegsBBox(lists[SIDE_FRONT], node->bbox[SIDE_FRONT]);
+    SegsBBox(lists[SIDE_BACK], node->bbox[SIDE_BACK]);
+
+    // Near the root, build the back subtree on another thread.
+    if (depth < threaddepth && counts[SIDE_BACK] >= NB_THREADSEGS)
+    {
+        buildjob_t job = { lists[SIDE_BACK], counts[SIDE_BACK], depth + 1, NULL, NULL };
+        SDL_Thread *thread = SDL_CreateThread(BuildJob, "nodebuild", &job);
+
+        node->child[SIDE_FRONT] = BuildNode(lists[SIDE_FRONT], counts[SIDE_FRONT],
+                                            depth + 1, error);
+
+        if (thread)
+            SDL_WaitThread(thread, NULL);
+        else
+            BuildJob(&job);
+
+        node->child[SIDE_BACK] = job.node;
+
+        if (job.error && *error == NULL)
+            *error = job.error;
+    }
+    else
+    {
+        node->child[SIDE_FRONT] = BuildNode(lists[SIDE_FRONT], counts[SIDE_FRONT],
+                                            depth + 1, error);
+        node->child[SIDE_BACK] = BuildNode(lists[SIDE_BACK], counts[SIDE_BACK],
+                                           depth + 1, error);
+    }
+
+    return node;
+}
+
+static int BuildJob (void *data)
+{
+    buildjob_t *job = data;
+
+    job->node = BuildNode(job->segs, job->count, job->depth, &job->error);
+    return 0;
+}
+
+static void FreeNode (bnode_t *node)
+{
+    if (node->child[SIDE_FRONT])
+    {
+        FreeNode(node->child[SIDE_FRONT]);
+        FreeNode(node->child[SIDE_BACK]);
+    }
+
+    while (node->segs)
+    {
+        bseg_t *s = node->segs;
+
+        node->segs = s->next;
+        free(s);
+    }
+
+    free(node);
+}
+
+// -----------------------------------------------------------------------------
+// Output
+//  Flatten the tree into the XNOD layout, root node last.
+// -----------------------------------------------------------------------------
+
+typedef struct
+{
+    fixed_t *newverts;      // x, y pairs
+    int *vertnext;
+    int vertheads[NB_VERTEXHASH];
+    unsigned int *subsegs;
+    mapseg_zdbsp_t *segs;
+    mapnode_zdbsp_t *nodes;
+} output_t;
+
+static unsigned int SplitVertex (output_t *out, fixed_t x, fixed_t y)
+{
+    const unsigned int hash = ((unsigned int)x * 31 + (unsigned int)y * 17
+                            + ((unsigned int)x >> 16) * 7) & (NB_VERTEXHASH - 1);
+    int i;
+
+    for (i = out->vertheads[hash]; i >= 0; i = out->vertnext[i])
+    {
+        if (out->newverts[2 * i] == x && out->newverts[2 * i + 1] == y)
+            return numvertexes + i;
+    }
+
+    i = array_size(out->vertnext);
+    array_push(out->newverts, x);
+    array_push(out->newverts, y);
+    array_push(out->vertnext, out->vertheads[hash]);
+    out->vertheads[hash] = i;
+
+    return numvertexes + i;
+}
+
+static unsigned int FlattenNode (output_t *out, const bnode_t *node)
+{
+    if (!node->child[SIDE_FRONT])
+    {
+        unsigned int numsegs = 0;
+
+        for (const bseg_t *s = node->segs; s; s = s->next)
+        {
+            mapseg_zdbsp_t ms;
+
+            ms.v1 = s->v1 >= 0 ? (unsigned int)s->v1 : SplitVertex(out, s->x1, s->y1);
+            ms.v2 = s->v2 >= 0 ? (unsigned int)s->v2 : SplitVertex(out, s->x2, s->y2);
+            ms.linedef = s->linedef;
+            ms.side = s->side;
+            array_push(out->segs, ms);
+            numsegs++;
+        }
+
+        array_push(out->subsegs, numsegs);
+        return (array_size(out->subsegs) - 1) | NF_SUBSECTOR;
+    }
+    else
+    {
+        mapnode_zdbsp_t mn;
+
+        mn.children[0] = FlattenNode(out, node->child[SIDE_FRONT]);
+        mn.children[1] = FlattenNode(out, node->child[SIDE_BACK]);
+        mn.x = node->x;
+        mn.y = node->y;
+        mn.dx = node->dx;
+        mn.dy = node->dy;
+        memcpy(mn.bbox, node->bbox, sizeof(mn.bbox));
+        array_push(out->nodes, mn);
+
+        return array_size(out->nodes) - 1;
+    }
+}
+
+static byte *PutLong (byte *p, unsigned int v)
+{
+    const int le = LONG(v);
+
+    memcpy(p, &le, 4);
+    return p + 4;
+}
+
+static byte *PutShort (byte *p, short v)
+{
+    const short le = SHORT(v);
+
+    memcpy(p, &le, 2);
+    return p + 2;
+}
+
+static void NodesDigest (byte *data, int length, sha1_digest_t digest)
+{
+    sha1_context_t sha1;
+
+    SHA1_Init(&sha1);
+    SHA1_Update(&sha1, data, length);
+    SHA1_Final(digest, &sha1);
+}
+
+// The XNOD lump is followed by the SHA-1 digest of its contents,
+// so a damaged cache file is never loaded.
+static byte *WriteXNOD (const output_t *out, int *length)
+{
+    const int numnew = array_size(out->vertnext);
+    const int numsubs = array_size(out->subsegs);
+    const int nsegs = array_size(out->segs);
+    const int nnodes = array_size(out->nodes);
+    const int payload = 4 + 8 + numnew * 8
+                      + 4 + numsubs * sizeof(mapsubsector_zdbsp_t)
+                      + 4 + nsegs * sizeof(mapseg_zdbsp_t)
+                      + 4 + nnodes * sizeof(mapnode_zdbsp_t);
+    byte *data, *p;
+
+    *length = payload + sizeof(sha1_digest_t);
+    data = p = malloc(*length);
+
+    if (data == NULL)
+        I_Error("P_BuildNodes: out of memory");
+
+    memcpy(p, "XNOD", 4);
+    p += 4;
+
+    p = PutLong(p, numvertexes);
+    p = PutLong(p, numnew);
+    for (int i = 0; i < numnew * 2; i++)
+        p = PutLong(p, out->newverts[i]);
+
+    p = PutLong(p, numsubs);
+    for (int i = 0; i < numsubs; i++)
+        p = PutLong(p, out->subsegs[i]);
+
+    p = PutLong(p, nsegs);
+    for (int i = 0; i < nsegs; i++)
+    {
+        p = PutLong(p, out->segs[i].v1);
+        p = PutLong(p, out->segs[i].v2);
+        p = PutShort(p, out->segs[i].linedef);
+        *p++ = out->segs[i].side;
+    }
+
+    p = PutLong(p, nnodes);
+    for (int i = 0; i < nnodes; i++)
+    {
+        const mapnode_zdbsp_t *mn = &out->nodes[i];
+
+        p = PutShort(p, mn->x);
+        p = PutShort(p, mn->y);
+        p = PutShort(p, mn->dx);
+        p = PutShort(p, mn->dy);
+        for (int j = 0; j < 2; j++)
+            for (int k = 0; k < 4; k++)
+                p = PutShort(p, mn->bbox[j][k]);
+        p = PutLong(p, mn->children[0]);
+        p = PutLong(p, mn->children[1]);
+    }
+
+    NodesDigest(data, payload, p);
+
+    return data;
+}
+
+static boolean NodesValid (byte *data, int length)
+{
+    const int payload = length - (int)sizeof(sha1_digest_t);
+    sha1_digest_t digest;
+
+    if (payload <= 12 || memcmp(data, "XNOD", 4)
+    ||  LONG(*(unsigned int *)(data + 4)) != numvertexes)
+        return false;
+
+    NodesDigest(data, payload, digest);
+    return !memcmp(data + payload, digest, sizeof(digest));
+}
+
+// -----------------------------------------------------------------------------
+// P_BuildNodes
+// -----------------------------------------------------------------------------
+
+static byte *P_BuildXNOD (int *length)
+{
+    bseg_t *segs = NULL;
+    int count = 0;
+    const char *error = NULL;
+    output_t *out;
+    bnode_t *root;
+    byte *data;
+
+    if (numlines > USHRT_MAX)
+        I_Error("P_BuildNodes: too many linedefs (%d)", numlines);
+
+    // One seg for every side of every linedef.
+    for (int i = numlines - 1; i >= 0; i--)
+    {
+        const line_t *l = &lines[i];
+
+        if (l->v1->x == l->v2->x && l->v1->y == l->v2->y)
+            continue;
+
+        for (int side = 1; side >= 0; side--)
+        {
+            bseg_t s;
+
+            if (l->sidenum[side] == NO_INDEX || l->sidenum[side] >= numsides)
+                continue;
+
+            s.x1 = side ? l->v2->x : l->v1->x;
+            s.y1 = side ? l->v2->y : l->v1->y;
+            s.x2 = side ? l->v1->x : l->v2->x;
+            s.y2 = side ? l->v1->y : l->v2->y;
+            s.v1 = (side ? l->v2 : l->v1) - vertexes;
+            s.v2 = (side ? l->v1 : l->v2) - vertexes;
+            s.linedef = i;
+            s.side = side;
+            s.next = segs;
+            segs = NewSeg(&s, &error);
+            count++;
+
+            if (segs == NULL)
+                I_Error("P_BuildNodes: %s", error);
+        }
+    }
+
+    if (count == 0)
+        I_Error("P_BuildNodes: no linedefs in map!");
+
+    root = BuildNode(segs, count, 0, &error);
+
+    // All threads have been joined by now.
+    if (error)
+        I_Error("P_BuildNodes: %s", error);
+
+    out = calloc(1, sizeof(*out));
+    memset(out->vertheads, -1, sizeof(out->vertheads));
+
+    // A map that is a single convex subsector gets no nodes at all.
+    FlattenNode(out, root);
+    data = WriteXNOD(out, length);
+
+    array_free(out->newverts);
+    array_free(out->vertnext);
+    array_free(out->subsegs);
+    array_free(out->segs);
+    array_free(out->nodes);
+    free(out);
+    FreeNode(root);
+
+    return data;
+}
+
+static char *P_NodeCachePath (int lumpnum)
+{
+    static const int maplumps[] = { ML_LINEDEFS, ML_SIDEDEFS, ML_VERTEXES };
+    sha1_context_t sha1;
+    sha1_digest_t digest;
+    char hex[sizeof(digest) * 2 + 1];
+    char *dir, *path;
+
+    SHA1_Init(&sha1);
+    SHA1_UpdateInt32(&sha1, NB_VERSION);
+
+    for (int i = 0; i < arrlen(maplumps); i++)
+    {
+        const int lump = lumpnum + maplumps[i];
+
+        SHA1_UpdateInt32(&sha1, W_LumpLength(lump));
+        SHA1_Update(&sha1, W_CacheLumpNum(lump, PU_STATIC), W_LumpLength(lump));
+        W_ReleaseLumpNum(lump);
+    }
+
+    SHA1_Final(digest, &sha1);
+
+    for (int i = 0; i < (int)sizeof(digest); i++)
+        M_snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+
+    dir = M_StringJoin(configdir, "nodes", NULL);
+    M_MakeDirectory(dir);
+    path = M_StringJoin(dir, DIR_SEPARATOR_S, hex, ".xnod", NULL);
+    free(dir);
+
+    return path;
+}
+
+void P_BuildNodes (int lumpnum)
+{
+    const int starttime = I_GetTimeMS();
+    char *path = P_NodeCachePath(lumpnum);
+    byte *data;
+    int length;
+
+    // Reuse nodes from an earlier build of the same geometry.
+    if (M_FileExists(path))
+    {
+        length = M_ReadFile(path, &data);
+
+        if (NodesValid(data, length))
+        {
+            P_LoadNodes_XNOD(data + 4);
+            Z_Free(data);
+            free(path);
+            fprintf(stderr, "P_BuildNodes: nodes loaded from cache in %d ms\n",
+                    I_GetTimeMS() - starttime);
+            return;
+        }
+
+        Z_Free(data);
+    }
+
+    data = P_BuildXNOD(&length);
+
+    if (!M_WriteFile(path, data, length))
+        fprintf(stderr, "P_BuildNodes: couldn't write %s\n", path);
+
+    P_LoadNodes_XNOD(data + 4);
+    free(data);
+    free(path);
+
+    fprintf(stderr, "P_BuildNodes: %d nodes, %d subsectors, %d segs "
+                    "built in %d ms (%d threads)\n",
+            numnodes, numsubsectors, numsegs,
+            I_GetTimeMS() - starttime, 1 << threaddepth);
+}
@@ -1796,10 +1796,6 @@ void P_UnArchiveThinkers (void)
         // [JN] Restore floating z value to actual mobj z coord.
         mobj->old_float_z = mobj->float_z = mobj->z;
 
-	    // [JN] Reset brightmap animations to full brightness.
-	    mobj->bmap_flick = 0;
-	    mobj->bmap_glow = 0;
-
         mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
 	    P_AddThinker (&mobj->thinker);
 	    break;
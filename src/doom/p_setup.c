@@ -21,7 +21,11 @@
 
 
 #include <math.h>
+
+#include "SDL.h"
+
 #include "z_zone.h"
+#include "am_map.h"
 #include "deh_main.h"
 #include "i_swap.h"
 #include "m_argv.h"
@@ -30,6 +34,7 @@
 #include "g_game.h"
 #include "i_system.h"
 #include "i_timer.h"
+#include "m_misc.h"
 #include "w_wad.h"
 #include "p_local.h"
 #include "s_sound.h"
@@ -267,20 +272,32 @@ static void P_LevelNameInit (void)
 // P_LoadVertexes
 // -----------------------------------------------------------------------------
 
+// [JN] The lump loaders below are split in two: allocating and caching
+// on the main thread (zone memory and the WAD cache are not thread safe),
+// then parsing the cached lump as a load job. Lumps are released once
+// all the jobs are done.
+static const mapvertex_t  *vertexes_src;
+static const mapsector_t  *sectors_src;
+static const mapsidedef_t *sides_src;
+
 static void P_LoadVertexes (int lump)
 {
     // Determine number of vertices
     const int lumpSize = W_LumpLength(lump);
-    const int count = lumpSize / sizeof(mapvertex_t);
-    numvertexes = count;
+    numvertexes = lumpSize / sizeof(mapvertex_t);
 
     // Allocate zone memory for vertices
-    vertex_t *const verts = Z_Malloc((size_t)count * sizeof(*verts), PU_LEVEL, 0);
-    vertexes = verts;
+    vertexes = Z_Malloc((size_t)numvertexes * sizeof(*vertexes), PU_LEVEL, 0);
 
     // Load raw vertex data into cache
-    const byte *const dataV = W_CacheLumpNum(lump, PU_STATIC);
-    const mapvertex_t *restrict srcV = (const mapvertex_t *)dataV;
+    vertexes_src = W_CacheLumpNum(lump, PU_STATIC);
+}
+
+static const char *P_ParseVertexes (void)
+{
+    const int count = numvertexes;
+    vertex_t *const verts = vertexes;
+    const mapvertex_t *restrict srcV = vertexes_src;
 
     // Copy and convert vertex coordinates to fixed-point
     for (int i = 0; i < count; ++i)
@@ -297,8 +314,7 @@ static void P_LoadVertexes (int lump)
         verts[i].moved = false;
     }
 
-    // Release the cached lump
-    W_ReleaseLumpNum(lump);
+    return NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -468,9 +484,8 @@ void P_SegLengths (boolean contrast_only)
             s->length = (uint32_t)(dist * 0.5);
 
             // [crispy] re-calculate angle used for rendering
-            viewx = s->v1->r_x;
-            viewy = s->v1->r_y;
-            const angle_t newAngle = R_PointToAngleCrispy(s->v2->r_x, s->v2->r_y);
+            const angle_t newAngle = R_PointToAngleCrispy2(s->v1->r_x, s->v1->r_y,
+                                                           s->v2->r_x, s->v2->r_y);
             s->r_angle = (anglediff(newAngle, s->angle) > ANG60/2) ? s->angle : newAngle;
         }
 
@@ -561,15 +576,20 @@ static void P_LoadSectors (int lump)
     numsectors = count;
 
     // Allocate and zero-initialize sector array
-    sector_t *const dst = Z_Malloc((size_t)count * sizeof(*dst), PU_LEVEL, 0);
-    memset(dst, 0, (size_t)count * sizeof(*dst));
-    sectors = dst;
+    sectors = Z_Malloc((size_t)count * sizeof(*sectors), PU_LEVEL, 0);
+    memset(sectors, 0, (size_t)count * sizeof(*sectors));
 
     // Load raw sector data into cache
-    const byte *const data = W_CacheLumpNum(lump, PU_STATIC);
-    if (!data || count == 0)
+    sectors_src = W_CacheLumpNum(lump, PU_STATIC);
+    if (!sectors_src || count == 0)
         I_Error("P_LoadSectors: No sectors in map! (lump %d)", lump);
-    const mapsector_t *restrict src = (const mapsector_t *)data;
+}
+
+static const char *P_ParseSectors (void)
+{
+    const int count = numsectors;
+    sector_t *const dst = sectors;
+    const mapsector_t *restrict src = sectors_src;
 
     // Copy fields
     for (int i = 0; i < count; ++i)
@@ -594,8 +614,7 @@ static void P_LoadSectors (int lump)
         dst[i].oldgametic          = -1;
     }
 
-    // Release the cached lump
-    W_ReleaseLumpNum(lump);
+    return NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -856,15 +875,23 @@ static void P_LoadSideDefs (int lump)
     numsides = count;
 
     // Allocate and zero-initialize sidedef array
-    side_t *const dst = Z_Malloc((size_t)count * sizeof(*dst), PU_LEVEL, 0);
-    memset(dst, 0, (size_t)count * sizeof(*dst));
-    sides = dst;
+    sides = Z_Malloc((size_t)count * sizeof(*sides), PU_LEVEL, 0);
+    memset(sides, 0, (size_t)count * sizeof(*sides));
 
     // Load raw sidedef data into cache
-    const byte *const data = W_CacheLumpNum(lump, PU_STATIC);
-    if (!data)
+    sides_src = W_CacheLumpNum(lump, PU_STATIC);
+    if (!sides_src)
         I_Error("P_LoadSideDefs: Failed to load lump %d", lump);
-    const mapsidedef_t *restrict src = (const mapsidedef_t *)data;
+}
+
+// Sector references are resolved against the sectors array, which is
+// allocated by then, so this doesn't wait for the sectors to be parsed.
+
+static const char *P_ParseSideDefs (void)
+{
+    const int count = numsides;
+    side_t *const dst = sides;
+    const mapsidedef_t *restrict src = sides_src;
 
     // Copy fields
     for (int i = 0; i < count; ++i)
@@ -886,8 +913,7 @@ static void P_LoadSideDefs (int lump)
         sd->basetextureoffset = sd->textureoffset;
     }
 
-    // Release the cached lump
-    W_ReleaseLumpNum(lump);
+    return NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -959,9 +985,15 @@ static boolean P_LoadBlockMap (int lump)
 //  are rewritten in structured form for better readability and control.
 //  The blockmap is built and compressed exactly as before, but the code
 //  is now more maintainable, less error-prone, and slightly faster overall.
+//
+// [JN] Split in two: the block lists are built by P_BuildBlockLists() as
+// a load job, P_CreateBlockMap() then compresses them into zone memory.
 // -----------------------------------------------------------------------------
 
-static void P_CreateBlockMap(void)
+typedef struct { int count, alloc; int *restrict items; } BlockList;
+static BlockList *blocklists;
+
+static const char *P_BuildBlockLists (void)
 {
     // Compute map bounds in block units
     int32_t minX = INT_MAX, minY = INT_MAX;
@@ -984,9 +1016,12 @@ static void P_CreateBlockMap(void)
     bmapheight = ((maxY - minY) >> MAPBTOFRAC) + 1;
 
     // Build temporary block lists
-    typedef struct { int count, alloc; int *restrict items; } BlockList;
     const unsigned totalBlocks = (unsigned)bmapwidth * (unsigned)bmapheight;
     BlockList *const restrict blocks = calloc(totalBlocks, sizeof *blocks);
+    blocklists = blocks;
+
+    if (blocks == NULL)
+        return "P_BuildBlockLists: out of memory";
 
     for (int lineIdx = 0; lineIdx < numlines; ++lineIdx)
     {
@@ -1016,7 +1051,10 @@ static void P_CreateBlockMap(void)
             if (bl->count >= bl->alloc)
             {
                 int newAlloc = bl->alloc ? bl->alloc * 2 : 8;
-                bl->items = I_Realloc(bl->items, newAlloc * sizeof *bl->items);
+                int *items = realloc(bl->items, newAlloc * sizeof *bl->items);
+                if (items == NULL)
+                    return "P_BuildBlockLists: out of memory";
+                bl->items = items;
                 bl->alloc = newAlloc;
             }
             bl->items[bl->count++] = lineIdx;
@@ -1027,6 +1065,14 @@ static void P_CreateBlockMap(void)
         }
     }
 
+    return NULL;
+}
+
+static void P_CreateBlockMap (void)
+{
+    const unsigned totalBlocks = (unsigned)bmapwidth * (unsigned)bmapheight;
+    BlockList *const restrict blocks = blocklists;
+
     // Compute total size for compressed blockmap
     unsigned lumpSize = totalBlocks + 6;
     for (unsigned b = 0; b < totalBlocks; ++b)
@@ -1057,6 +1103,7 @@ static void P_CreateBlockMap(void)
         }
     }
     free(blocks);
+    blocklists = NULL;
 
     // Finalize global blockmap pointer and links
     blockmap = blockmaplump + 4;
@@ -1069,9 +1116,11 @@ static void P_CreateBlockMap(void)
 // P_GroupLines
 // Builds sector line lists and subsector sector numbers.
 // Finds block bounding boxes for sectors.
+// [JN] Split into load jobs. P_GroupLines() itself allocates the sector
+// line lists, P_GroupSubsectors() and P_SectorBoxes() run as jobs.
 // -----------------------------------------------------------------------------
 
-void P_GroupLines (void)
+static const char *P_GroupSubsectors (void)
 {
     // Assign a sector for each subsector
     for (int i = 0; i < numsubsectors; ++i)
@@ -1090,9 +1139,20 @@ void P_GroupLines (void)
             }
         }
         if (!ss->sector)
-            I_Error("P_GroupLines: Subsector %d is not part of any sector!", i);
+        {
+            static char error[64];
+
+            M_snprintf(error, sizeof(error),
+                       "P_GroupLines: Subsector %d is not part of any sector!", i);
+            return error;
+        }
     }
 
+    return NULL;
+}
+
+void P_GroupLines (void)
+{
     // Count total lines and initialize linecount per sector
     totallines = 0;
     for (int i = 0; i < numlines; ++i)
@@ -1130,7 +1190,10 @@ void P_GroupLines (void)
         if (bs && bs != fs)
             bs->lines[bs->linecount++] = ln;
     }
+}
 
+static const char *P_SectorBoxes (void)
+{
     // Generate bounding boxes and blockboxes for each sector
     for (int i = 0; i < numsectors; ++i)
     {
@@ -1162,6 +1225,8 @@ void P_GroupLines (void)
         const int left = (bbox[BOXLEFT] - bmaporgx - MAXRADIUS) >> MAPBLOCKSHIFT;
         sec->blockbox[BOXLEFT] = (left < 0) ? 0 : left;
     }
+
+    return NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -1173,7 +1238,7 @@ void P_GroupLines (void)
 // i.e. r_bsp.c:R_AddLine()
 // -----------------------------------------------------------------------------
 
-static void P_RemoveSlimeTrails (void)
+static const char *P_RemoveSlimeTrails (void)
 {
     const int count = numsegs;
     seg_t *const segArray = segs;
@@ -1226,6 +1291,8 @@ static void P_RemoveSlimeTrails (void)
             }
         }
     }
+
+    return NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -1300,6 +1367,156 @@ static void P_LoadReject (int lumpnum)
     }
 }
 
+// -----------------------------------------------------------------------------
+// Map loading jobs
+// [JN] Passes that only work on level data which is already allocated run
+// as jobs, in parallel where their dependencies allow. Each round starts
+// every job whose dependencies are done, all but one of them in threads,
+// runs the last one on the main thread and waits for the rest.
+//
+// I_Error must not be called from a job thread. Jobs return an error
+// message instead, or NULL, and it is raised once the round is joined.
+// -----------------------------------------------------------------------------
+
+typedef struct
+{
+    const char   *name;
+    const char *(*func) (void);  // NULL if there is nothing to do
+    unsigned int  deps;          // Bit mask of jobs that must be done first
+    int           time;          // Microseconds spent
+    const char   *error;         // Returned by func
+} loadjob_t;
+
+#define MAXLOADSTATS 32
+
+static struct
+{
+    const char *name;
+    int         time;
+    boolean     job;
+} loadstat[MAXLOADSTATS];
+
+static int      numloadstats;
+static uint64_t loadstagetime;
+static boolean  loadstats;
+static boolean  loadthreads;
+
+static void P_LoadStat (const char *name, const int time, const boolean job)
+{
+    if (numloadstats < MAXLOADSTATS)
+    {
+        loadstat[numloadstats].name = name;
+        loadstat[numloadstats].time = time;
+        loadstat[numloadstats].job = job;
+        numloadstats++;
+    }
+}
+
+// Record the time spent since the previous stage.
+
+static void P_LoadStage (const char *name)
+{
+    const uint64_t now = I_GetTimeUS();
+
+    P_LoadStat(name, (int)(now - loadstagetime), false);
+    loadstagetime = now;
+}
+
+static int P_LoadJobThread (void *data)
+{
+    loadjob_t *const job = data;
+    const uint64_t starttime = I_GetTimeUS();
+
+    job->error = job->func();
+    job->time = (int)(I_GetTimeUS() - starttime);
+
+    return 0;
+}
+
+static void P_RunLoadJobs (loadjob_t *const jobs, const int numjobs)
+{
+    const unsigned int all = (1u << numjobs) - 1;
+    unsigned int done = 0;
+
+    for (int i = 0; i < numjobs; i++)
+    {
+        jobs[i].time = 0;
+
+        if (jobs[i].func == NULL)
+        {
+            done |= 1u << i;
+        }
+    }
+
+    while (done != all)
+    {
+        SDL_Thread *threads[32];
+        int ready[32];
+        int numready = 0;
+
+        for (int i = 0; i < numjobs; i++)
+        {
+            if (!(done & (1u << i)) && (jobs[i].deps & done) == jobs[i].deps)
+            {
+                ready[numready++] = i;
+            }
+        }
+
+        if (numready == 0)
+        {
+            I_Error("P_RunLoadJobs: Circular job dependencies");
+        }
+
+        for (int i = 0; i < numready - 1; i++)
+        {
+            loadjob_t *const job = &jobs[ready[i]];
+
+            threads[i] = loadthreads ?
+                         SDL_CreateThread(P_LoadJobThread, job->name, job) : NULL;
+
+            if (threads[i] == NULL)
+            {
+                P_LoadJobThread(job);
+            }
+        }
+
+        P_LoadJobThread(&jobs[ready[numready - 1]]);
+
+        for (int i = 0; i < numready - 1; i++)
+        {
+            if (threads[i] != NULL)
+            {
+                SDL_WaitThread(threads[i], NULL);
+            }
+        }
+
+        for (int i = 0; i < numready; i++)
+        {
+            if (jobs[ready[i]].error != NULL)
+            {
+                I_Error("%s", jobs[ready[i]].error);
+            }
+
+            done |= 1u << ready[i];
+        }
+    }
+
+    for (int i = 0; i < numjobs; i++)
+    {
+        if (jobs[i].func != NULL)
+        {
+            P_LoadStat(jobs[i].name, jobs[i].time, true);
+        }
+    }
+}
+
+static const char *P_SegLengthsJob (void)
+{
+    P_SegLengths(false);
+
+    return NULL;
+}
+
 // -----------------------------------------------------------------------------
 // P_SetupLevel
 // -----------------------------------------------------------------------------
@@ -1354,22 +1571,44 @@ void P_SetupLevel (int episode, int map)
     else
         printf("P_SetupLevel: E%dM%d, ", gameepisode, gamemap);
 
+    numloadstats = 0;
+    loadstagetime = I_GetTimeUS();
+
     // Load map format and data
     mapformat_t fmt    = P_CheckMapFormat(lumpnum);
     boolean validBMap  = P_LoadBlockMap(lumpnum + ML_BLOCKMAP);
     P_LoadVertexes(lumpnum + ML_VERTEXES);
     P_LoadSectors(lumpnum + ML_SECTORS);
     P_LoadSideDefs(lumpnum + ML_SIDEDEFS);
+    P_LoadStage("lumps");
+
+    // Parse the cached lumps, independent of each other
+    {
+        loadjob_t jobs[] = {
+            { "vertexes", P_ParseVertexes, 0 },
+            { "sectors",  P_ParseSectors,  0 },
+            { "sidedefs", P_ParseSideDefs, 0 },
+        };
+
+        P_RunLoadJobs(jobs, arrlen(jobs));
+        W_ReleaseLumpNum(lumpnum + ML_VERTEXES);
+        W_ReleaseLumpNum(lumpnum + ML_SECTORS);
+        W_ReleaseLumpNum(lumpnum + ML_SIDEDEFS);
+        P_LoadStage("parse");
+    }
 
     if (fmt & MFMT_HEXEN)
         P_LoadLineDefs_Hexen(lumpnum + ML_LINEDEFS);
     else
         P_LoadLineDefs(lumpnum + ML_LINEDEFS);
 
-    if (!validBMap)
-        P_CreateBlockMap();
+    P_LoadStage("linedefs");
 
-    if (fmt & (MFMT_ZDBSPX | MFMT_ZDBSPZ))
+    if (P_NodesNeeded(lumpnum, fmt))
+    {
+        P_BuildNodes(lumpnum);
+    }
+    else if (fmt & (MFMT_ZDBSPX | MFMT_ZDBSPZ))
     {
         P_LoadNodes_ZDBSP(lumpnum + ML_NODES, fmt & MFMT_ZDBSPZ);
     }
@@ -1386,17 +1625,42 @@ void P_SetupLevel (int episode, int map)
         P_LoadSegs(lumpnum + ML_SEGS);
     }
 
+    P_LoadStage("nodes");
     P_GroupLines();
+    P_LoadStage("line lists");
+    AM_clearWallGrid();
+
+    // Post-load passes
+    {
+        enum { subsectors, blocklists, slimetrails, seglengths, sectorboxes };
+        loadjob_t jobs[] = {
+            [subsectors]  = { "subsectors",  P_GroupSubsectors, 0 },
+            [blocklists]  = { "blocklists",  validBMap ? NULL : P_BuildBlockLists, 0 },
+            [slimetrails] = { "slimetrails", P_RemoveSlimeTrails, 0 },
+            [seglengths]  = { "seglengths",  P_SegLengthsJob, 1 << slimetrails },
+            [sectorboxes] = { "sectorboxes", P_SectorBoxes, 1 << blocklists },
+        };
+
+        P_RunLoadJobs(jobs, arrlen(jobs));
+        P_LoadStage("post");
+    }
+
+    if (!validBMap)
+    {
+        P_CreateBlockMap();
+        P_LoadStage("blockmap");
+    }
+
     P_LoadReject(lumpnum + ML_REJECT);
+    P_LoadStage("reject");
 
-    // Post-load adjustments
-    P_RemoveSlimeTrails();
-    P_SegLengths(false);
     memset(st_keyorskull, 0, sizeof st_keyorskull);
     bodyqueslot = 0;
     deathmatch_p = deathmatchstarts;
 
     P_LoadThings(lumpnum + ML_THINGS);
+    P_LoadStage("things");
+
     if (deathmatch)
     {
         for (int i = 0; i < MAXPLAYERS; ++i)
@@ -1410,15 +1674,28 @@ void P_SetupLevel (int episode, int map)
     // Clear respawn queue and spawn specials
     iquehead = iquetail = 0;
     P_SpawnSpecials();
+    P_LoadStage("specials");
 
     // Preload graphics and finalize
     if (precache)
+    {
         R_PrecacheLevel();
+        P_LoadStage("precache");
+    }
     P_LevelNameInit();
     crl_spectating = 0;
 
     // Log load time
     printf("loaded in %d ms.\n", I_GetTimeMS() - starttime);
+
+    if (loadstats)
+    {
+        for (int i = 0; i < numloadstats; i++)
+        {
+            printf(loadstat[i].job ? "    %-12s %7d us\n" : "  %-14s %7d us\n",
+                   loadstat[i].name, loadstat[i].time);
+        }
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -1430,4 +1707,16 @@ void P_Init (void)
     P_InitSwitchList();
     P_InitPicAnims();
     R_InitSprites(sprnames);
+    P_NodeBuildInit();
+
+    //!
+    // @category obscure
+    //
+    // Print the time taken by each stage of map loading.
+    //
+
+    loadstats = M_ParmExists("-loadstats");
+    loadthreads = SDL_GetCPUCount() > 1;
+
+    P_FastSimInit();
 }
@@ -18,6 +18,8 @@
 //
 
 
+#include <string.h>
+
 #include "doomdef.h"
 #include "doomstat.h"
 
@@ -32,12 +34,11 @@ fixed_t		sightzstart;		// eye z of looker
 fixed_t		topslope;
 fixed_t		bottomslope;		// slopes to top and bottom of target
 
-divline_t	strace;			// from t1 to t2
-fixed_t		t2x;
-fixed_t		t2y;
-
 int		sightcounts[2];
 
+// [JN] Sight checks of the game thread. Lines are marked with validcount.
+static sightctx_t mainsight;
+
 
 // PTR_SightTraverse() for Doom 1.2 sight calculations
 // taken from prboom-plus/src/p_sight.c:69-102
@@ -162,7 +163,7 @@ P_InterceptVector2
 // Returns true
 //  if strace crosses the given subsector successfully.
 //
-boolean P_CrossSubsector (int num)
+static boolean P_CrossSubsector (sightctx_t *ctx, int num)
 {
     seg_t*		seg;
     line_t*		line;
@@ -198,15 +199,26 @@ boolean P_CrossSubsector (int num)
 	line = seg->linedef;
 
 	// allready checked other side?
-	if (line->validcount == validcount)
-	    continue;
-	
-	line->validcount = validcount;
+	// [JN] Threads mark lines in their own array.
+	if (ctx->linemarks)
+	{
+	    if (ctx->linemarks[line - lines] == ctx->mark)
+	        continue;
+
+	    ctx->linemarks[line - lines] = ctx->mark;
+	}
+	else
+	{
+	    if (line->validcount == validcount)
+	        continue;
+
+	    line->validcount = validcount;
+	}
 
 	v1 = line->v1;
 	v2 = line->v2;
-	s1 = P_DivlineSide (v1->x,v1->y, &strace);
-	s2 = P_DivlineSide (v2->x, v2->y, &strace);
+	s1 = P_DivlineSide (v1->x,v1->y, &ctx->strace);
+	s2 = P_DivlineSide (v2->x, v2->y, &ctx->strace);
 
 	// line isn't crossed?
 	if (s1 == s2)
@@ -216,8 +228,8 @@ boolean P_CrossSubsector (int num)
 	divl.y = v1->y;
 	divl.dx = v2->x - v1->x;
 	divl.dy = v2->y - v1->y;
-	s1 = P_DivlineSide (strace.x, strace.y, &divl);
-	s2 = P_DivlineSide (t2x, t2y, &divl);
+	s1 = P_DivlineSide (ctx->strace.x, ctx->strace.y, &divl);
+	s2 = P_DivlineSide (ctx->t2x, ctx->t2y, &divl);
 
 	// line isn't crossed?
 	if (s1 == s2)
@@ -262,23 +274,23 @@ boolean P_CrossSubsector (int num)
 	if (openbottom >= opentop)	
 	    return false;		// stop
 	
-	frac = P_InterceptVector2 (&strace, &divl);
+	frac = P_InterceptVector2 (&ctx->strace, &divl);
 		
 	if (front->floorheight != back->floorheight)
 	{
-	    slope = FixedDiv (openbottom - sightzstart , frac);
-	    if (slope > bottomslope)
-		bottomslope = slope;
+	    slope = FixedDiv (openbottom - ctx->sightzstart , frac);
+	    if (slope > ctx->bottomslope)
+		ctx->bottomslope = slope;
 	}
 		
 	if (front->ceilingheight != back->ceilingheight)
 	{
-	    slope = FixedDiv (opentop - sightzstart , frac);
-	    if (slope < topslope)
-		topslope = slope;
+	    slope = FixedDiv (opentop - ctx->sightzstart , frac);
+	    if (slope < ctx->topslope)
+		ctx->topslope = slope;
 	}
 		
-	if (topslope <= bottomslope)
+	if (ctx->topslope <= ctx->bottomslope)
 	    return false;		// stop				
     }
     // passed the subsector ok
@@ -292,7 +304,7 @@ boolean P_CrossSubsector (int num)
 // Returns true
 //  if strace crosses the given node successfully.
 //
-boolean P_CrossBSPNode (int bspnum)
+static boolean P_CrossBSPNode (sightctx_t *ctx, int bspnum)
 {
     node_t*	bsp;
     int		side;
@@ -300,31 +312,75 @@ boolean P_CrossBSPNode (int bspnum)
     if (bspnum & NF_SUBSECTOR)
     {
 	if (bspnum == -1)
-	    return P_CrossSubsector (0);
+	    return P_CrossSubsector (ctx, 0);
 	else
-	    return P_CrossSubsector (bspnum&(~NF_SUBSECTOR));
+	    return P_CrossSubsector (ctx, bspnum&(~NF_SUBSECTOR));
     }
 		
     bsp = &nodes[bspnum];
     
     // decide which side the start point is on
-    side = P_DivlineSide (strace.x, strace.y, (divline_t *)bsp);
+    side = P_DivlineSide (ctx->strace.x, ctx->strace.y, (divline_t *)bsp);
     if (side == 2)
 	side = 0;	// an "on" should cross both sides
 
     // cross the starting side
-    if (!P_CrossBSPNode (bsp->children[side]) )
+    if (!P_CrossBSPNode (ctx, bsp->children[side]) )
 	return false;
 	
     // the partition plane is crossed here
-    if (side == P_DivlineSide (t2x, t2y,(divline_t *)bsp))
+    if (side == P_DivlineSide (ctx->t2x, ctx->t2y,(divline_t *)bsp))
     {
 	// the line doesn't touch the other side
 	return true;
     }
     
     // cross the ending side		
-    return P_CrossBSPNode (bsp->children[side^1]);
+    return P_CrossBSPNode (ctx, bsp->children[side^1]);
+}
+
+
+//
+// P_SightRejected
+// [JN] Returns true if the REJECT table says
+//  t1 and t2 can't possibly see each other.
+//
+boolean P_SightRejected (const mobj_t *t1, const mobj_t *t2)
+{
+    const int s1 = (t1->subsector->sector - sectors);
+    const int s2 = (t2->subsector->sector - sectors);
+    const int pnum = s1*numsectors + s2;
+
+    return (rejectmatrix[pnum>>3] & (1 << (pnum&7))) != 0;
+}
+
+
+//
+// P_CheckSightBSP
+// [JN] Looks from the eyes of t1 to any part of t2 through the BSP.
+//  All state lives in ctx, so threads can run it with their own.
+//
+boolean P_CheckSightBSP (sightctx_t *ctx, const mobj_t *t1, const mobj_t *t2)
+{
+    if (ctx->linemarks && ++ctx->mark == 0)
+    {
+        memset(ctx->linemarks, 0, numlines * sizeof(*ctx->linemarks));
+        ctx->mark = 1;
+    }
+
+    ctx->sightzstart = t1->z + t1->height - (t1->height>>2);
+    ctx->topslope = (t2->z+t2->height) - ctx->sightzstart;
+    ctx->bottomslope = (t2->z) - ctx->sightzstart;
+
+    ctx->strace.x = t1->x;
+    ctx->strace.y = t1->y;
+    ctx->t2x = t2->x;
+    ctx->t2y = t2->y;
+    ctx->strace.dx = t2->x - t1->x;
+    ctx->strace.dy = t2->y - t1->y;
+
+    // the head node is the last node output
+    return P_CrossBSPNode (ctx, numnodes-1);
 }
 
 
@@ -339,23 +395,10 @@ P_CheckSight
 ( mobj_t*	t1,
   mobj_t*	t2 )
 {
-    int		s1;
-    int		s2;
-    int		pnum;
-    int		bytenum;
-    int		bitnum;
-    
-    // First check for trivial rejection.
+    boolean	seen;
 
-    // Determine subsector entries in REJECT table.
-    s1 = (t1->subsector->sector - sectors);
-    s2 = (t2->subsector->sector - sectors);
-    pnum = s1*numsectors + s2;
-    bytenum = pnum>>3;
-    bitnum = 1 << (pnum&7);
-
-    // Check in REJECT table.
-    if (rejectmatrix[bytenum]&bitnum)
+    // First check for trivial rejection.
+    if (P_SightRejected(t1, t2))
     {
 	sightcounts[0]++;
 
@@ -363,31 +406,27 @@ P_CheckSight
 	return false;	
     }
 
+    // [JN] Fast sim: take the result computed at the start of the tic.
+    if (fastsim && P_FastSimSight(t1, t2, &seen))
+    {
+	return seen;
+    }
+
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
 
     validcount++;
 	
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
-	
     if (gameversion <= exe_doom_1_2)
     {
+        sightzstart = t1->z + t1->height - (t1->height>>2);
+        topslope = (t2->z+t2->height) - sightzstart;
+        bottomslope = (t2->z) - sightzstart;
+
         return P_PathTraverse(t1->x, t1->y, t2->x, t2->y,
                               PT_EARLYOUT | PT_ADDLINES, PTR_SightTraverse);
     }
 
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
-
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+    return P_CheckSightBSP (&mainsight, t1, t2);
 }
-
-
@@ -23,7 +23,6 @@
 #include "p_local.h"
 #include "doomstat.h"
 #include "ct_chat.h"
-#include "m_random.h"
 
 #include "id_vars.h"
 
@@ -93,7 +92,6 @@ void P_RemoveThinker (thinker_t* thinker)
 void P_RunThinkers (void)
 {
     thinker_t *currentthinker, *nextthinker;
-    static int bmap_count_common;
 
     currentthinker = thinkercap.next;
     while (currentthinker != &thinkercap)
@@ -108,45 +106,6 @@ void P_RunThinkers (void)
 	        goto skip;
 	    }
 	}
-	// [JN] Animate brightmaps.
-	// Note: not exactly a good place for handling render-specific properties,
-	// but we don't want make a separate run through all the thinkers and
-	// animation must be framerate independent.
-	if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
-	{
-	    if (vis_brightmaps)
-	    {
-	        if (bmap_count_common == 1)
-	        {
-	            // [JN] Random brightmap flickering effect.
-	            if (mo->sprite == SPR_CAND  // Candestick
-	            ||  mo->sprite == SPR_CBRA  // Candelabra
-	            ||  mo->sprite == SPR_FCAN  // Flaming Barrel
-	            ||  mo->sprite == SPR_TBLU  // Tall Blue Torch
-	            ||  mo->sprite == SPR_TGRN  // Tall Green Torch
-	            ||  mo->sprite == SPR_TRED  // Tall Red Torch
-	            ||  mo->sprite == SPR_SMBT  // Short Blue Torch
-	            ||  mo->sprite == SPR_SMGT  // Short Green Torch
-	            ||  mo->sprite == SPR_SMRT  // Short Red Torch
-	            ||  mo->sprite == SPR_POL3) // Pile of Skulls and Candles
-	            {
-	                mo->bmap_flick = ID_RealRandom() % 16;
-	            }
-	            // [JN] Smooth brightmap glowing effect.
-	            if (mo->sprite == SPR_FCAN  // Flaming Barrel
-	            ||  mo->sprite == SPR_CEYE  // Evil Eye
-	            ||  mo->sprite == SPR_FSKU) // Floating Skull Rock
-	            {
-	                mo->bmap_glow = ID_RealRandom() % 6;
-	            }
-	        }
-	    }
-	    else
-	    {
-	    	mo->bmap_flick = 0;
-	    	mo->bmap_glow = 0;
-	    }
-	}
 
 	if ( currentthinker->function.acv == (actionf_v)(-1) )
 	{
@@ -166,12 +125,13 @@ void P_RunThinkers (void)
 	}
 	currentthinker = nextthinker;
     }
-    
-	// [JN] Reset brightmap timer.
-	if (++bmap_count_common == 4)
-	{
-	    bmap_count_common = 0;
-	}
+
+    // [JN] Animate brightmaps. Not a render-specific place, but the
+    // animation must be framerate independent. Frozen things stay still.
+    if (!crl_freeze)
+    {
+        R_AnimateBrightmaps();
+    }
 }
 
 
@@ -211,8 +171,11 @@ void P_Ticker (void)
     for (i=0 ; i<MAXPLAYERS ; i++)
 	if (playeringame[i])
 	    P_PlayerThink (&players[i]);
-			
+
+    // [JN] Fast sim: check sight in parallel before the thinkers run.
+    P_FastSimPrepare ();
     P_RunThinkers ();
+    P_FastSimFinish ();
     
     // [JN] CRL - do not update mobjs and thinkers in freeze mode.
     if (!crl_freeze)
@@ -225,4 +188,7 @@ void P_Ticker (void)
     }
 
     realleveltime++;
+
+    // [JN] Hash the resulting state for desync detection.
+    P_StateHashTicker();
 }
@@ -20,8 +20,12 @@
 //
 
 
+#include <string.h>
+
 #include "doomstat.h"
+#include "m_random.h"
 #include "r_local.h"
+#include "z_zone.h"
 
 #include "id_vars.h"
 
@@ -30,7 +34,7 @@
 // [crispy] brightmap data
 // -----------------------------------------------------------------------------
 
-static const byte nobrightmap[256] = {0};
+const byte nobrightmap[256] = {0};
 
 static const byte fullbright[256] = {
     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
@@ -563,164 +567,145 @@ const byte *R_BrightmapForTexName (const char *texname)
 // [crispy] brightmaps for sprites
 // -----------------------------------------------------------------------------
 
+typedef struct
+{
+    spritenum_t  sprite;
+    const byte  *colormask;
+} spritebrightmap_t;
+
+// Brightmaps for sprites with brightmaps enabled.
+static const spritebrightmap_t spritebrightmaps_on[] = {
+    {SPR_BON2, greenonly1},     // Armor Bonus
+    {SPR_CELL, greenonly2},     // Cell Charge
+    {SPR_BAR1, greenonly3},     // Barrel
+    {SPR_CELP, yellowonly},     // Cell Charge Pack
+    {SPR_COLU, yellowonly},     // Floor Lamp
+    {SPR_FCAN, yellowonly},     // Burning Barrel
+    {SPR_BFUG, redonly},        // BFG9000
+    {SPR_PLAS, redonly},        // Plasmagun
+    {SPR_CAND, candle},         // Candlestick
+    {SPR_CBRA, candle},         // Candelabra
+    {SPR_TBLU, light_sources},  // Tall Blue Torch
+    {SPR_TGRN, light_sources},  // Tall Green Torch
+    {SPR_TRED, light_sources},  // Tall Red Torch
+    {SPR_SMBT, light_sources},  // Short Blue Torch
+    {SPR_SMGT, light_sources},  // Short Green Torch
+    {SPR_SMRT, light_sources},  // Short Red Torch
+    {SPR_TLMP, light_sources},  // Tall Technocolumn
+    {SPR_TLP2, light_sources},  // Short Technocolumn
+    {SPR_CEYE, greenonly1},     // Evil Eye
+    {SPR_FSKU, fullbright},     // Floating Skull Rock
+    {SPR_POL3, fullbright},     // Pile of Skulls and Candles
+};
+
+// Brightmaps for sprites with brightmaps disabled.
+static const spritebrightmap_t spritebrightmaps_off[] = {
+    {SPR_FCAN, fullbright},
+    {SPR_CAND, fullbright},
+    {SPR_CEYE, fullbright},
+    {SPR_FSKU, fullbright},
+    {SPR_CBRA, fullbright},
+    {SPR_COLU, fullbright},
+    {SPR_TLMP, fullbright},
+    {SPR_TLP2, fullbright},
+    {SPR_TBLU, fullbright},
+    {SPR_TGRN, fullbright},
+    {SPR_TRED, fullbright},
+    {SPR_SMBT, fullbright},
+    {SPR_SMGT, fullbright},
+    {SPR_SMRT, fullbright},
+};
+
+// [JN] Resolved at load time, indexed by vis_brightmaps and sprite number.
+static const byte *spritebrightmaps[2][NUMSPRITES];
+
 const byte *R_BrightmapForSprite (const int type)
 {
-    if (vis_brightmaps)
-    {
-        switch (type)
-        {
-            // Armor Bonus
-            case SPR_BON2:
-            {
-                return greenonly1;
-                break;
-            }
-            // Cell Charge
-            case SPR_CELL:
-            {
-                return greenonly2;
-                break;
-            }
-            // Barrel
-            case SPR_BAR1:
-            {
-                return greenonly3;
-                break;
-            }
-            // Cell Charge Pack
-            case SPR_CELP:
-            // Floor Lamp
-            case SPR_COLU:
-            // Burning Barrel
-            case SPR_FCAN:
-            {
-                return yellowonly;
-                break;
-            }
-            // BFG9000
-            case SPR_BFUG:
-            // Plasmagun
-            case SPR_PLAS:
-            {
-                return redonly;
-                break;
-            }
+    return spritebrightmaps[vis_brightmaps != 0][type];
+}
 
-            // Candlestick
-            case SPR_CAND:
-            // Candelabra
-            case SPR_CBRA:
-            {
-                return candle;
-                break;
-            }
-            // Tall Blue Torch
-            case SPR_TBLU:
-            // Tall Green Torch
-            case SPR_TGRN:
-            // Tall Red Torch
-            case SPR_TRED:
-            // Short Blue Torch
-            case SPR_SMBT:
-            // Short Green Torch
-            case SPR_SMGT:
-            // Short Red Torch
-            case SPR_SMRT:
-            // Tall Technocolumn
-            case SPR_TLMP:
-            // Short Technocolumn
-            case SPR_TLP2:
-            {
-                return light_sources;
-                break;
-            }
-            // Evil Eye
-            case SPR_CEYE:
-            {
-                return greenonly1;
-                break;
-            }
-            // Floating Skull Rock
-            case SPR_FSKU:
-            // Pile of Skulls and Candles
-            case SPR_POL3:
-            {
-                return fullbright;
-                break;
-            }
-        }
+// [JN] How animated brightmaps light every sprite, see R_ProjectSprite.
+const byte spritebrightanim[NUMSPRITES] = {
+    [SPR_BON2] = BMAP_SEMI,          // Armor Bonus
+    [SPR_BAR1] = BMAP_SEMI,          // Explosive Barrel
+    [SPR_CAND] = BMAP_DEMI_FLICK,    // Candestick
+    [SPR_CBRA] = BMAP_DEMI_FLICK,    // Candelabra
+    [SPR_FCAN] = BMAP_DEMI_GLOW,     // Flaming Barrel
+    [SPR_COLU] = BMAP_DEMI,          // Floor Lamp
+    [SPR_TLMP] = BMAP_DEMI,          // Tall Tech Lamp
+    [SPR_TLP2] = BMAP_DEMI,          // Short Tech Lamp
+    [SPR_TBLU] = BMAP_HEMI_FLICK,    // Tall Blue Torch
+    [SPR_TGRN] = BMAP_HEMI_FLICK,    // Tall Green Torch
+    [SPR_TRED] = BMAP_HEMI_FLICK,    // Tall Red Torch
+    [SPR_SMBT] = BMAP_FLICK_QUARTER, // Short Blue Torch
+    [SPR_SMGT] = BMAP_FLICK_QUARTER, // Short Green Torch
+    [SPR_SMRT] = BMAP_FLICK_QUARTER, // Short Red Torch
+    [SPR_CEYE] = BMAP_GLOW,          // Evil Eye
+    [SPR_FSKU] = BMAP_GLOW,          // Floating Skull Rock
+    [SPR_POL3] = BMAP_FLICK_THIRD,   // Pile of Skulls and Candles
+};
+
+// -----------------------------------------------------------------------------
+// [JN] Brightmap animation
+//  Flickering and glowing values shared by all animated sprites. A thing
+//  picks its slot by address, so neighbouring light sources still animate
+//  independently, but nothing has to be done per thinker.
+// -----------------------------------------------------------------------------
+
+int bmapflick[BMAPANIMSLOTS];
+int bmapglow[BMAPANIMSLOTS];
+
+void R_AnimateBrightmaps (void)
+{
+    static int bmap_count_common;
+
+    if (!vis_brightmaps)
+    {
+        // Full brightness while brightmaps are off.
+        memset(bmapflick, 0, sizeof(bmapflick));
+        memset(bmapglow, 0, sizeof(bmapglow));
     }
     else
+    if (bmap_count_common == 1)
     {
-        switch (type)
+        for (int i = 0; i < BMAPANIMSLOTS; i++)
         {
-            case SPR_FCAN:
-            case SPR_CAND:
-            case SPR_CEYE:
-            case SPR_FSKU:
-            case SPR_CBRA:
-            case SPR_COLU:
-            case SPR_TLMP:
-            case SPR_TLP2:
-            case SPR_TBLU:
-            case SPR_TGRN:
-            case SPR_TRED:
-            case SPR_SMBT:
-            case SPR_SMGT:
-            case SPR_SMRT:
-            {
-                return fullbright;
-                break;
-            }
+            // [JN] Random brightmap flickering effect.
+            bmapflick[i] = ID_RealRandom() % 16;
+            // [JN] Smooth brightmap glowing effect.
+            bmapglow[i] = ID_RealRandom() % 6;
         }
     }
 
-    return nobrightmap;
+    // [JN] Reset brightmap timer.
+    if (++bmap_count_common == 4)
+    {
+        bmap_count_common = 0;
+    }
 }
 
 // -----------------------------------------------------------------------------
 // [crispy] brightmaps for flats
 // -----------------------------------------------------------------------------
 
-static int bmapflatnum[3];
+// [JN] Resolved at load time, indexed by flat number.
+static const byte **flatbrightmaps;
 
 const byte *R_BrightmapForFlatNum (const int num)
 {
-    if (vis_brightmaps)
-    {
-        if (num == bmapflatnum[0]
-        ||  num == bmapflatnum[1]
-        ||  num == bmapflatnum[2])
-        {
-            return notgrayorbrown;
-        }
-    }
-
-    return nobrightmap;
+    return vis_brightmaps ? flatbrightmaps[num] : nobrightmap;
 }
 
 // -----------------------------------------------------------------------------
 // [crispy] brightmaps for states
 // -----------------------------------------------------------------------------
 
+// [JN] Resolved at load time, indexed by state number.
+static const byte *statebrightmaps[NUMSTATES];
+
 const byte *R_BrightmapForState (const int state)
 {
-    if (vis_brightmaps)
-    {
-        switch (state)
-        {
-            case S_BFG1:
-            case S_BFG2:
-            case S_BFG3:
-            case S_BFG4:
-            {
-                return redonly;
-                break;
-            }
-        }
-	}
-
-    return nobrightmap;
+    return vis_brightmaps ? statebrightmaps[state] : nobrightmap;
 }
 
 // -----------------------------------------------------------------------------
@@ -729,8 +714,36 @@ const byte *R_BrightmapForState (const int state)
 
 void R_InitBrightmaps (void)
 {
+    for (int i = 0; i < NUMSPRITES; i++)
+    {
+        spritebrightmaps[0][i] = spritebrightmaps[1][i] = nobrightmap;
+    }
+    for (int i = 0; i < arrlen(spritebrightmaps_off); i++)
+    {
+        spritebrightmaps[0][spritebrightmaps_off[i].sprite] = spritebrightmaps_off[i].colormask;
+    }
+    for (int i = 0; i < arrlen(spritebrightmaps_on); i++)
+    {
+        spritebrightmaps[1][spritebrightmaps_on[i].sprite] = spritebrightmaps_on[i].colormask;
+    }
+
+    for (int i = 0; i < NUMSTATES; i++)
+    {
+        statebrightmaps[i] = nobrightmap;
+    }
+    // BFG9000
+    statebrightmaps[S_BFG1] = redonly;
+    statebrightmaps[S_BFG2] = redonly;
+    statebrightmaps[S_BFG3] = redonly;
+    statebrightmaps[S_BFG4] = redonly;
+
+    flatbrightmaps = Z_Malloc(numflats * sizeof(*flatbrightmaps), PU_STATIC, 0);
+    for (int i = 0; i < numflats; i++)
+    {
+        flatbrightmaps[i] = nobrightmap;
+    }
     // [crispy] only three select brightmapped flats
-    bmapflatnum[0] = R_FlatNumForName("CONS1_1");
-    bmapflatnum[1] = R_FlatNumForName("CONS1_5");
-    bmapflatnum[2] = R_FlatNumForName("CONS1_7");
+    flatbrightmaps[R_FlatNumForName("CONS1_1")] = notgrayorbrown;
+    flatbrightmaps[R_FlatNumForName("CONS1_5")] = notgrayorbrown;
+    flatbrightmaps[R_FlatNumForName("CONS1_7")] = notgrayorbrown;
 }
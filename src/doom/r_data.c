@@ -19,9 +19,13 @@
 //
 
 #include <stdio.h>
+
+#include "SDL.h"
+
 #include "deh_main.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_timer.h"
 #include "z_zone.h"
 #include "w_wad.h"
 #include "m_misc.h"
@@ -31,6 +35,7 @@
 #include "v_video.h"
 
 #include "id_vars.h"
+#include "id_func.h"
 
 
 //
@@ -162,6 +167,9 @@ fixed_t*	spritetopoffset;
 lighttable_t	*colormaps;
 lighttable_t	*pal_color; // [crispy] array holding palette colors for true color mode
 
+// [JN] Bumped every time colormaps are rebuilt (gamma, saturation, etc.).
+unsigned int	colormaps_generation;
+
 // [FG] check if the lump can be a Doom patch
 // taken from PrBoom+ prboom2/src/r_patch.c:L350-L390
 
@@ -1103,10 +1111,10 @@ void R_InitSpriteLumps (void)
 //
 // Also, thanks Alaux!
 
-#define CALC_INTENSITY(pal, playpal, index) \
-    { pal[0] = playpal[3 * (index) + 0] * vid_r_intensity; \
-      pal[1] = playpal[3 * (index) + 1] * vid_g_intensity; \
-      pal[2] = playpal[3 * (index) + 2] * vid_b_intensity; }
+#define CALC_INTENSITY(pal, playpal, index, intensity) \
+    { pal[0] = playpal[3 * (index) + 0] * intensity[0]; \
+      pal[1] = playpal[3 * (index) + 1] * intensity[1]; \
+      pal[2] = playpal[3 * (index) + 2] * intensity[2]; }
 
 #define CALC_SATURATION(channels, pal, a_hi, a_lo) \
     { const float one_minus_a_hi = 1.0f - a_hi; \
@@ -1129,88 +1137,127 @@ void R_InitSpriteLumps (void)
       channels[2] = (byte)BETWEEN(0, 255, (int)(matrix[2][0] * r + matrix[2][1] * g + matrix[2][2] * b)); }
 
 
-void R_InitColormaps (void)
+// -----------------------------------------------------------------------------
+// [JN] Colormap cache.
+//
+// Tables are built for a key holding every setting they depend on, and
+// kept in a few slots. Switching back to settings seen before (gamma
+// slider steps, toggling saturation or colorblind filters) only copies
+// the cached tables into place. The live colormaps buffer itself never
+// moves, since light tables and others hold pointers into it.
+// After a change, the neighbouring gamma levels are built in background
+// threads, so stepping the gamma slider finds them ready.
+// -----------------------------------------------------------------------------
+
+#define COLORMAPSETS 6
+
+typedef struct
+{
+    int   gamma;
+    int   saturation;
+    int   colorblind;
+    int   numcolormaps;
+    int   truecolor;
+    int   invul;
+    int   original;
+    float contrast;
+    float intensity[3];
+} colormapkey_t;
+
+typedef struct
+{
+    colormapkey_t key;
+    boolean       valid;
+    SDL_Thread   *thread;   // Background build in progress, if not NULL
+    unsigned int  lastuse;
+    uint64_t      buildtime;
+
+    lighttable_t *colormaps;
+    pixel_t       pal_color[256];
+    uint8_t       shadow_alpha;
+    uint8_t       fuzz_alpha;
+} colormapset_t;
+
+static colormapset_t colormapsets[COLORMAPSETS];
+static unsigned int  colormapsets_use;
+
+// Copies of PLAYPAL and COLORMAP for the builders, so background threads
+// never touch the WAD cache. Only changed while no thread is running.
+static byte *cm_playpal;
+static byte *cm_colormap;
+
+static void R_BuildColormapSet (colormapset_t *const set)
 {
+	const colormapkey_t *const key = &set->key;
+	const byte *const playpal = cm_playpal;
+	const byte *const colormap = cm_colormap;
+	const byte *const gamma = gammatable[key->gamma];
+	const double (*const matrix)[3] = colorblind_matrix[key->colorblind];
+	const uint64_t starttime = I_GetTimeUS();
+	lighttable_t *const maps = set->colormaps;
 	int c, i, j = 0;
 	byte r, g, b;
 
-	byte *const playpal = W_CacheLumpName("PLAYPAL", PU_STATIC);
-	byte *const colormap = W_CacheLumpName("COLORMAP", PU_STATIC);
-
 	// [JN] Saturation floats, high and low.
 	// If saturation has been modified (< 100), set high and low
 	// values according to saturation level. Sum of r,g,b channels
 	// and floats must be 1.0 to get proper colors.
-	const float a_hi = vid_saturation < 100 ? I_SaturationPercent[vid_saturation] : 0;
-	const float a_lo = vid_saturation < 100 ? (a_hi / 2) : 0;
+	const float a_hi = key->saturation < 100 ? I_SaturationPercent[key->saturation] : 0;
+	const float a_lo = key->saturation < 100 ? (a_hi / 2) : 0;
 
-	// [crispy] Smoothest diminishing lighting.
-	// Compiled in but not enabled TrueColor mode
-	// can't use more than original 32 colormaps.
-	if (vid_truecolor && vis_smooth_light)
-	{
-		NUMCOLORMAPS = 256;
-	}
-	else
+	if (key->truecolor)
 	{
-		NUMCOLORMAPS = 32;
-	}
-
-	colormaps = I_Realloc(colormaps, (NUMCOLORMAPS + 1) * 256 * sizeof(lighttable_t));
-
-	if (vid_truecolor)
-	{
-		for (c = 0; c < NUMCOLORMAPS; c++)
+		for (c = 0; c < key->numcolormaps; c++)
 		{
-			const float scale = 1. * c / NUMCOLORMAPS;
+			const float scale = 1. * c / key->numcolormaps;
 
 			for (i = 0; i < 256; i++)
 			{
 				const byte k = colormap[i];
 				// [PN] Apply intensity and saturation corrections
-				static byte pal[3];
-				static byte channels[3];
+				byte pal[3];
+				byte channels[3];
 
-				CALC_INTENSITY(pal, playpal, k);
+				CALC_INTENSITY(pal, playpal, k, key->intensity);
 				CALC_SATURATION(channels, pal, a_hi, a_lo);
 
-				r = gammatable[vid_gamma][channels[0]] * (1. - scale) + gammatable[vid_gamma][0] * scale;
-				g = gammatable[vid_gamma][channels[1]] * (1. - scale) + gammatable[vid_gamma][0] * scale;
-				b = gammatable[vid_gamma][channels[2]] * (1. - scale) + gammatable[vid_gamma][0] * scale;
+				r = gamma[channels[0]] * (1. - scale) + gamma[0] * scale;
+				g = gamma[channels[1]] * (1. - scale) + gamma[0] * scale;
+				b = gamma[channels[2]] * (1. - scale) + gamma[0] * scale;
 
 				// [PN] Apply contrast adjustment after interpolation
 				channels[0] = r;
 				channels[1] = g;
 				channels[2] = b;
-				CALC_CONTRAST(channels, vid_contrast);
+				CALC_CONTRAST(channels, key->contrast);
 
 				// [PN] Apply colorblind filter
-				CALC_COLORBLIND(channels, colorblind_matrix[a11y_colorblind]);
+				CALC_COLORBLIND(channels, matrix);
 
-				colormaps[j++] = 0xff000000 | (channels[0] << 16) | (channels[1] << 8) | channels[2];
+				maps[j++] = 0xff000000 | (channels[0] << 16) | (channels[1] << 8) | channels[2];
 			}
 		}
 	}
 	else
 	{
-		for (c = 0; c < NUMCOLORMAPS; c++)
+		for (c = 0; c < key->numcolormaps; c++)
 		{
 			for (i = 0; i < 256; i++)
 			{
 				// [PN] Apply intensity and saturation corrections
-				static byte pal[3];
-				static byte channels[3];
+				byte pal[3];
+				byte channels[3];
 
-				CALC_INTENSITY(pal, playpal, colormap[c * 256 + i]);
+				CALC_INTENSITY(pal, playpal, colormap[c * 256 + i], key->intensity);
 				CALC_SATURATION(channels, pal, a_hi, a_lo);
-				CALC_CONTRAST(channels, vid_contrast);
-				CALC_COLORBLIND(channels, colorblind_matrix[a11y_colorblind]);
+				CALC_CONTRAST(channels, key->contrast);
+				CALC_COLORBLIND(channels, matrix);
 
-				r = gammatable[vid_gamma][channels[0]] & ~3;
-				g = gammatable[vid_gamma][channels[1]] & ~3;
-				b = gammatable[vid_gamma][channels[2]] & ~3;
+				r = gamma[channels[0]] & ~3;
+				g = gamma[channels[1]] & ~3;
+				b = gamma[channels[2]] & ~3;
 
-				colormaps[j++] = 0xff000000 | (r << 16) | (g << 8) | b;
+				maps[j++] = 0xff000000 | (r << 16) | (g << 8) | b;
 			}
 		}
 	}
@@ -1218,7 +1265,7 @@ void R_InitColormaps (void)
 	// [crispy] Invulnerability (c == COLORMAPS)
 	for (i = 0; i < 256; i++)
 	{
-		if (a11y_invul)
+		if (key->invul)
 		{
 			// [JN] A11Y - grayscale invulnerability effect,
 			// independendt from COLORMAP lump.
@@ -1228,21 +1275,21 @@ void R_InitColormaps (void)
 				(byte)((playpal[3 * i + 0] +
 						playpal[3 * i + 1] +
 						playpal[3 * i + 2]) / 3);
-			r = g = b = gammatable[vid_gamma][gray];
+			r = g = b = gamma[gray];
 		}
 		else
 		{
 			// [JN] Check if we have a modified COLORMAP lump to decide
 			// how invulnerability effect will be drawn.
 
-			if (original_colormap)
+			if (key->original)
 			{
 				// [JN] We don't. Generate it for better colors in TrueColor mode.
 				const byte gray = 0xff -
 					(byte) (0.299 * playpal[3 * i + 0] +
 							0.587 * playpal[3 * i + 1] +
 							0.114 * playpal[3 * i + 2]);
-				r = g = b = gammatable[vid_gamma][gray];
+				r = g = b = gamma[gray];
 			}
 			else
 			{
@@ -1251,56 +1298,242 @@ void R_InitColormaps (void)
 				// but barely will be notable, since no light levels are used.
 
 				// [PN] Apply intensity and saturation corrections
-				static byte pal[3];
-				static byte channels[3];
+				byte pal[3];
+				byte channels[3];
 
-				CALC_INTENSITY(pal, playpal, colormap[32 * 256 + i]);
+				CALC_INTENSITY(pal, playpal, colormap[32 * 256 + i], key->intensity);
 				CALC_SATURATION(channels, pal, a_hi, a_lo);
-				CALC_CONTRAST(channels, vid_contrast);
-				CALC_COLORBLIND(channels, colorblind_matrix[a11y_colorblind]);
+				CALC_CONTRAST(channels, key->contrast);
+				CALC_COLORBLIND(channels, matrix);
 
-				r = gammatable[vid_gamma][channels[0]] & ~3;
-				g = gammatable[vid_gamma][channels[1]] & ~3;
-				b = gammatable[vid_gamma][channels[2]] & ~3;
+				r = gamma[channels[0]] & ~3;
+				g = gamma[channels[1]] & ~3;
+				b = gamma[channels[2]] & ~3;
 			}
 		}
 
-		colormaps[j++] = 0xff000000 | (r << 16) | (g << 8) | b;
-	}
-
-	W_ReleaseLumpName("COLORMAP");
-
-	if (!pal_color)
-	{
-		pal_color = (pixel_t*) Z_Malloc(256 * sizeof(pixel_t), PU_STATIC, 0);
+		maps[j++] = 0xff000000 | (r << 16) | (g << 8) | b;
 	}
 
-	for (i = 0, j = 0; i < 256; i++)
+	for (i = 0; i < 256; i++)
 	{
 		// [PN] Apply intensity and saturation corrections
-		static byte pal[3];
-		static byte channels[3];
+		byte pal[3];
+		byte channels[3];
 
-		CALC_INTENSITY(pal, playpal, i);
+		CALC_INTENSITY(pal, playpal, i, key->intensity);
 		CALC_SATURATION(channels, pal, a_hi, a_lo);
-		CALC_CONTRAST(channels, vid_contrast);
-		CALC_COLORBLIND(channels, colorblind_matrix[a11y_colorblind]);
+		CALC_CONTRAST(channels, key->contrast);
+		CALC_COLORBLIND(channels, matrix);
 
-		r = gammatable[vid_gamma][channels[0]];
-		g = gammatable[vid_gamma][channels[1]];
-		b = gammatable[vid_gamma][channels[2]];
+		r = gamma[channels[0]];
+		g = gamma[channels[1]];
+		b = gamma[channels[2]];
 
-		pal_color[j++] = 0xff000000 | (r << 16) | (g << 8) | b;
+		set->pal_color[i] = 0xff000000 | (r << 16) | (g << 8) | b;
 	}
 
-	W_ReleaseLumpName("PLAYPAL");
-
 	// [JN] Recalculate shadow alpha value for shadowed patches,
 	// and fuzz alpha value for fuzz effect drawing based on contrast.
 	// 0x80 (128) represents 50% darkening, 0xD3 (211) represents 17% darkening.
 	// Ensure the result stays within 0-255.
-	shadow_alpha = (uint8_t)BETWEEN(0, 255 - (32 * vid_contrast), 0x80 / vid_contrast);
-	fuzz_alpha = (uint8_t)BETWEEN(0, 255 - (8 * vid_contrast), 0xD3 / vid_contrast);
+	set->shadow_alpha = (uint8_t)BETWEEN(0, 255 - (32 * key->contrast), 0x80 / key->contrast);
+	set->fuzz_alpha = (uint8_t)BETWEEN(0, 255 - (8 * key->contrast), 0xD3 / key->contrast);
+
+	set->buildtime = I_GetTimeUS() - starttime;
+	set->valid = true;
+}
+
+static int R_BuildColormapThread (void *data)
+{
+	R_BuildColormapSet(data);
+	return 0;
+}
+
+// Wait for a background build of the given set, if any.
+
+static void R_FinishColormapSet (colormapset_t *const set)
+{
+	if (set->thread)
+	{
+		SDL_WaitThread(set->thread, NULL);
+		set->thread = NULL;
+	}
+}
+
+static void R_ColormapKey (colormapkey_t *const key, const int gamma)
+{
+	// Zero the padding too, keys are compared as a whole.
+	memset(key, 0, sizeof(*key));
+
+	key->gamma = gamma;
+	key->saturation = vid_saturation;
+	key->colorblind = a11y_colorblind;
+	// [crispy] Smoothest diminishing lighting.
+	// Compiled in but not enabled TrueColor mode
+	// can't use more than original 32 colormaps.
+	key->numcolormaps = vid_truecolor && vis_smooth_light ? 256 : 32;
+	key->truecolor = vid_truecolor;
+	key->invul = a11y_invul;
+	key->original = original_colormap;
+	key->contrast = vid_contrast;
+	key->intensity[0] = vid_r_intensity;
+	key->intensity[1] = vid_g_intensity;
+	key->intensity[2] = vid_b_intensity;
+}
+
+static colormapset_t *R_FindColormapSet (const colormapkey_t *const key)
+{
+	for (int i = 0; i < COLORMAPSETS; i++)
+	{
+		colormapset_t *const set = &colormapsets[i];
+
+		if ((set->thread || set->valid)
+		&& !memcmp(&set->key, key, sizeof(*key)))
+		{
+			return set;
+		}
+	}
+
+	return NULL;
+}
+
+// Take the least recently used slot, never the one in use right now,
+// and make room in it for tables of the given key.
+
+static colormapset_t *R_ClaimColormapSet (const colormapkey_t *const key,
+                                          const colormapset_t *const keep)
+{
+	colormapset_t *set = NULL;
+
+	for (int i = 0; i < COLORMAPSETS; i++)
+	{
+		colormapset_t *const s = &colormapsets[i];
+
+		if (s != keep && (set == NULL || s->lastuse < set->lastuse))
+		{
+			set = s;
+		}
+	}
+
+	R_FinishColormapSet(set);
+
+	set->key = *key;
+	set->valid = false;
+	set->lastuse = ++colormapsets_use;
+	set->colormaps = I_Realloc(set->colormaps,
+	                           (key->numcolormaps + 1) * 256 * sizeof(lighttable_t));
+
+	return set;
+}
+
+// Refresh the lump copies. If either lump has changed (WAD reloaded),
+// every cached set is stale.
+
+static void R_UpdateColormapLumps (void)
+{
+	const int playpal_lump = W_GetNumForName("PLAYPAL");
+	const int colormap_lump = W_GetNumForName("COLORMAP");
+	const int playpal_len = MIN(W_LumpLength(playpal_lump), 768);
+	const int colormap_len = MIN(W_LumpLength(colormap_lump), 34 * 256);
+	const byte *const playpal = W_CacheLumpNum(playpal_lump, PU_STATIC);
+	const byte *const colormap = W_CacheLumpNum(colormap_lump, PU_STATIC);
+
+	if (!cm_playpal)
+	{
+		cm_playpal = calloc(1, 768);
+		cm_colormap = calloc(1, 34 * 256);
+	}
+
+	if (memcmp(cm_playpal, playpal, playpal_len)
+	||  memcmp(cm_colormap, colormap, colormap_len))
+	{
+		for (int i = 0; i < COLORMAPSETS; i++)
+		{
+			R_FinishColormapSet(&colormapsets[i]);
+			colormapsets[i].valid = false;
+		}
+
+		memcpy(cm_playpal, playpal, playpal_len);
+		memcpy(cm_colormap, colormap, colormap_len);
+	}
+
+	W_ReleaseLumpNum(playpal_lump);
+	W_ReleaseLumpNum(colormap_lump);
+}
+
+void R_InitColormaps (void)
+{
+	colormapkey_t key;
+	colormapset_t *set;
+	size_t size;
+
+	R_UpdateColormapLumps();
+	R_ColormapKey(&key, vid_gamma);
+
+	set = R_FindColormapSet(&key);
+
+	if (set)
+	{
+		R_FinishColormapSet(set);
+		set->lastuse = ++colormapsets_use;
+	}
+	else
+	{
+		set = R_ClaimColormapSet(&key, NULL);
+		R_BuildColormapSet(set);
+		IDTiming.colormaps = (int)set->buildtime;
+	}
+
+	// [JN] Only reallocate if the number of colormaps has changed,
+	// so pointers into the live tables stay valid otherwise.
+	if (!colormaps || NUMCOLORMAPS != key.numcolormaps)
+	{
+		NUMCOLORMAPS = key.numcolormaps;
+		colormaps = I_Realloc(colormaps, (NUMCOLORMAPS + 1) * 256 * sizeof(lighttable_t));
+	}
+
+	size = (NUMCOLORMAPS + 1) * 256 * sizeof(lighttable_t);
+	memcpy(colormaps, set->colormaps, size);
+
+	if (!pal_color)
+	{
+		pal_color = (pixel_t*) Z_Malloc(256 * sizeof(pixel_t), PU_STATIC, 0);
+	}
+
+	memcpy(pal_color, set->pal_color, sizeof(set->pal_color));
+	shadow_alpha = set->shadow_alpha;
+	fuzz_alpha = set->fuzz_alpha;
+
+	// [JN] Invalidate anything built from the old tables (sky cache).
+	colormaps_generation++;
+
+	// Build the neighbouring gamma levels in the background.
+	for (int step = -1; step <= 1; step += 2)
+	{
+		const int gamma = vid_gamma + step;
+		colormapkey_t next;
+
+		if (gamma < 0 || gamma >= MAXGAMMA)
+		{
+			continue;
+		}
+
+		R_ColormapKey(&next, gamma);
+
+		if (!R_FindColormapSet(&next))
+		{
+			colormapset_t *const prefetch = R_ClaimColormapSet(&next, set);
+
+			prefetch->thread = SDL_CreateThread(R_BuildColormapThread,
+			                                    "colormaps", prefetch);
+
+			if (!prefetch->thread)
+			{
+				R_BuildColormapSet(prefetch);
+			}
+		}
+	}
 }
 
 
@@ -422,13 +422,10 @@ typedef struct visplane_s
     int     minx;
     int     maxx;
 
-    // leave pads for [minx-1]/[maxx+1]
-    unsigned short pad1;
-    unsigned short top[MAXWIDTH];
-    unsigned short pad2;
-    unsigned short pad3;
-    unsigned short bottom[MAXWIDTH];
-    unsigned short pad4;
+    // [JN] Clip arrays are allocated from the visplane pool and sized
+    // to the current view width. Both leave pads for [minx-1]/[maxx+1].
+    unsigned short *top;
+    unsigned short *bottom;
 } visplane_t;
 
 //
@@ -527,6 +524,31 @@ extern const byte  *R_BrightmapForSprite (const int type);
 extern const byte  *R_BrightmapForFlatNum (const int num);
 extern const byte  *R_BrightmapForState (const int state);
 extern const byte **texturebrightmap;
+extern const byte   nobrightmap[256];
+
+// [JN] How a sprite is lit by animated brightmaps.
+typedef enum
+{
+    BMAP_PLAIN,         // Normal brightmap
+    BMAP_SEMI,          // Brightmap at reduced power
+    BMAP_DEMI,          // Sprite lit twice as far
+    BMAP_DEMI_FLICK,    // Same, brightmap flickers
+    BMAP_DEMI_GLOW,     // Same, brightmap glows
+    BMAP_HEMI_FLICK,    // Sprite lit four times as far, brightmap flickers
+    BMAP_FLICK_QUARTER, // Whole sprite flickers at a quarter
+    BMAP_FLICK_THIRD,   // Whole sprite flickers at a third
+    BMAP_GLOW,          // Whole sprite glows
+} bmapanim_t;
+
+#define BMAPANIMSLOTS 64
+
+// [JN] Animation slot of a thing.
+#define R_BrightmapSlot(mo) (((uintptr_t)(mo) / sizeof(mobj_t)) & (BMAPANIMSLOTS - 1))
+
+extern const byte spritebrightanim[NUMSPRITES];
+extern int bmapflick[BMAPANIMSLOTS];
+extern int bmapglow[BMAPANIMSLOTS];
+extern void R_AnimateBrightmaps (void);
 
 
 // -----------------------------------------------------------------------------
@@ -569,9 +591,12 @@ extern void  R_InitColormaps (void);
 extern void  R_InitData (void);
 extern void  R_PrecacheLevel (void);
 
+extern int   *texturewidth;
 extern int   *texturecompositesize;
 extern byte **texturecomposite;
 
+extern unsigned int colormaps_generation;
+
 extern int    numflats;
 
 // -----------------------------------------------------------------------------
@@ -580,12 +605,16 @@ extern int    numflats;
 
 extern void R_DrawColumn (void);
 extern void R_DrawColumnLow (void);
+extern void (*R_WallColumnFunc (const int texnum)) (void);
+extern boolean genericwalls;
 extern void R_DrawFuzzColumn (void);
 extern void R_DrawFuzzColumnLow (void);
 extern void R_DrawFuzzTLColumn (void);
 extern void R_DrawFuzzTLColumnLow (void);
 extern void R_DrawFuzzBWColumn (void);
 extern void R_DrawFuzzBWColumnLow (void);
+extern void R_DrawSkyColumn (void);
+extern void R_DrawSkyColumnLow (void);
 extern void R_DrawSpan (void);
 extern void R_DrawSpanLow (void);
 extern void R_DrawTLColumn (void);
@@ -630,6 +659,8 @@ extern lighttable_t *ds_colormap[2];
 extern const byte *dc_brightmap;
 extern const byte *ds_brightmap;
 
+extern const pixel_t *dc_skysource;
+
 // -----------------------------------------------------------------------------
 // R_MAIN
 // -----------------------------------------------------------------------------
@@ -640,11 +671,15 @@ extern void    R_InitLightTables (void);
 extern void    R_InitSkyMap (void);
 extern void    R_RenderPlayerView (player_t *player);
 extern void    R_SetViewSize (int blocks, int detail);
+extern void    R_WallBenchmark (void);
+extern int     benchwalls;
 
 // Utility functions.
 extern angle_t R_PointToAngle (fixed_t x, fixed_t y);
 extern angle_t R_PointToAngle2 (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2);
+extern angle_t R_PointToAngleFrom (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2);
 extern angle_t R_PointToAngleCrispy (fixed_t x, fixed_t y);
+extern angle_t R_PointToAngleCrispy2 (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2);
 extern fixed_t R_PointToDist (fixed_t x, fixed_t y);
 extern fixed_t R_ScaleFromGlobalAngle (angle_t visangle);
 extern int     R_PointOnSegSide (fixed_t x, fixed_t y, const seg_t *line);
@@ -694,6 +729,7 @@ extern void (*transcolfunc) (void);
 extern void (*tlcolfunc) (void);
 extern void (*tladdcolfunc) (void);
 extern void (*transtlfuzzcolfunc) (void);
+extern void (*skycolfunc) (void);
 extern void (*spanfunc) (void);
 
 // POV related.
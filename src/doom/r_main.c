@@ -26,6 +26,9 @@
 #include "doomstat.h" // [AM] leveltime, paused, menuactive
 #include "m_bbox.h"
 #include "d_main.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
 #include "m_menu.h"
 #include "p_local.h"
 #include "v_video.h"
@@ -132,6 +135,7 @@ void (*transcolfunc) (void);
 void (*tlcolfunc) (void);
 void (*tladdcolfunc) (void);
 void (*transtlfuzzcolfunc) (void);
+void (*skycolfunc) (void);
 void (*spanfunc) (void);
 
 
@@ -240,16 +244,14 @@ int R_PointOnSegSide (fixed_t x, fixed_t y, const seg_t *line)
 // called with either slope_div = SlopeDivCrispy() from R_PointToAngleCrispy()
 // or slope_div = SlopeDiv() else
 // [PN] Reformatted for readability and reduced nesting
-angle_t
-R_PointToAngleSlope
+// [JN] Split off R_PointToAngleSlope() to work on a vector that is
+// already relative to its origin, so callers don't need viewx/viewy.
+static angle_t
+R_VectorToAngle
 ( fixed_t	x,
   fixed_t	y,
   int (*slope_div) (unsigned int num, unsigned int den))
 {
-    // [PN] Shift to local player coordinates
-    x -= viewx;
-    y -= viewy;
-
     // [PN] If the point matches the player's position
     if (!x && !y)
         return 0;
@@ -290,6 +292,16 @@ R_PointToAngleSlope
     }
 }
 
+angle_t
+R_PointToAngleSlope
+( fixed_t	x,
+  fixed_t	y,
+  int (*slope_div) (unsigned int num, unsigned int den))
+{
+    // [PN] Shift to local player coordinates
+    return R_VectorToAngle(x - viewx, y - viewy, slope_div);
+}
+
 angle_t
 R_PointToAngle
 ( fixed_t	x,
@@ -299,7 +311,7 @@ R_PointToAngle
 }
 
 // [crispy] overflow-safe R_PointToAngle() flavor
-// called only from R_CheckBBox(), R_AddLine() and P_SegLengths()
+// called only from R_CheckBBox() and R_AddLine()
 angle_t
 R_PointToAngleCrispy
 ( fixed_t	x,
@@ -321,6 +333,28 @@ R_PointToAngleCrispy
     return R_PointToAngleSlope (x, y, SlopeDivCrispy);
 }
 
+// [JN] R_PointToAngleCrispy() from an explicit origin. Leaves viewx/viewy
+// alone, so P_SegLengths() can run in a map loading thread.
+angle_t
+R_PointToAngleCrispy2
+( fixed_t	x1,
+  fixed_t	y1,
+  fixed_t	x2,
+  fixed_t	y2 )
+{
+    int64_t dx = (int64_t)x2 - x1;
+    int64_t dy = (int64_t)y2 - y1;
+
+    // [crispy] preserving the angle by halfing the distance in both directions
+    if (dx < INT_MIN || dx > INT_MAX || dy < INT_MIN || dy > INT_MAX)
+    {
+	dx /= 2;
+	dy /= 2;
+    }
+
+    return R_VectorToAngle ((fixed_t)dx, (fixed_t)dy, SlopeDivCrispy);
+}
+
 
 angle_t
 R_PointToAngle2
@@ -336,6 +370,18 @@ R_PointToAngle2
     return R_PointToAngleSlope (x2, y2, SlopeDiv);
 }
 
+// [JN] Same as R_PointToAngle2(), without setting viewx/viewy, so that
+// threads other than the game thread can use it.
+angle_t
+R_PointToAngleFrom
+( fixed_t	x1,
+  fixed_t	y1,
+  fixed_t	x2,
+  fixed_t	y2 )
+{
+    return R_VectorToAngle (x2 - x1, y2 - y1, SlopeDiv);
+}
+
 
 // [crispy] WiggleFix: move R_ScaleFromGlobalAngle function to r_segs.c,
 // above R_StoreWallRange
@@ -803,6 +849,7 @@ void R_ExecuteSetViewSize (void)
 	tlcolfunc = R_DrawTLColumn;
 	tladdcolfunc = R_DrawTLAddColumn;
 	transtlfuzzcolfunc = R_DrawTransTLFuzzColumn;
+	skycolfunc = R_DrawSkyColumn;
 	spanfunc = R_DrawSpan;
     }
     else
@@ -815,6 +862,7 @@ void R_ExecuteSetViewSize (void)
 	tlcolfunc = R_DrawTLColumnLow;
 	tladdcolfunc = R_DrawTLAddColumnLow;
 	transtlfuzzcolfunc = R_DrawTransTLFuzzColumnLow;
+	skycolfunc = R_DrawSkyColumnLow;
 	spanfunc = R_DrawSpanLow;
     }
 
@@ -911,6 +959,8 @@ void R_ExecuteSetViewSize (void)
 
 void R_Init (void)
 {
+    int p;
+
     // [JN] Check for modified PLAYPAL lump.
     if (W_CheckMultipleLumps("PLAYPAL") > 1)
     {
@@ -935,6 +985,69 @@ void R_Init (void)
     R_InitTranslationTables ();
     printf (".");
     printf ("]");
+
+    //!
+    // @arg <frames>
+    // @category obscure
+    //
+    // Benchmark the wall column drawers on the starting map: render
+    // the starting view <frames> times with the specialized drawers
+    // and with the generic one, print the average frame time of each
+    // and quit.
+    //
+
+    p = M_CheckParmWithArgs("-benchwalls", 1);
+
+    if (p)
+    {
+        benchwalls = MAX(1, atoi(myargv[p + 1]));
+    }
+}
+
+// -----------------------------------------------------------------------------
+// R_WallBenchmark
+//  [JN] Times the starting view with the specialized wall column drawers
+//  against the generic R_DrawColumn. Both alternate in short blocks, so
+//  they see the same clock speed and cache state. Everything else in the
+//  frame is the same in both runs, so the difference is the wall drawers.
+// -----------------------------------------------------------------------------
+
+#define BENCHWALLS_BLOCK 16
+
+int benchwalls;
+
+void R_WallBenchmark (void)
+{
+    uint64_t elapsed[2] = { 0, 0 };
+    int frames = 0;
+
+    while (frames < benchwalls)
+    {
+        for (int generic = 0 ; generic < 2 ; generic++)
+        {
+            const uint64_t start = I_GetTimeUS();
+
+            genericwalls = generic;
+
+            for (int i = 0 ; i < BENCHWALLS_BLOCK ; i++)
+            {
+                R_RenderPlayerView(&players[displayplayer]);
+            }
+
+            elapsed[generic] += I_GetTimeUS() - start;
+        }
+
+        frames += BENCHWALLS_BLOCK;
+    }
+
+    genericwalls = false;
+
+    printf("R_WallBenchmark: %d frames at %dx%d, %s detail\n",
+           frames, viewwidth, viewheight, detailshift ? "low" : "high");
+    printf("  specialized: %8.1f us/frame\n", (double) elapsed[0] / frames);
+    printf("  generic:     %8.1f us/frame\n", (double) elapsed[1] / frames);
+
+    I_Quit();
 }
 
 
@@ -1134,6 +1247,10 @@ void R_RenderPlayerView (player_t *player)
         return;
     }
 
+    // [JN] The whole view window is redrawn. Mark it as damaged, so its
+    // rows are uploaded without being compared to the previous frame.
+    V_MarkRect(viewwindowx, viewwindowy, scaledviewwidth, viewheight);
+
     // check for new console commands.
     NetUpdate ();
 
@@ -35,26 +35,48 @@
 
 
 // -----------------------------------------------------------------------------
-// MAXVISPLANES is no longer a limit on the number of visplanes,
-// but a limit on the number of hash slots; larger numbers mean
-// better performance usually but after a point they are wasted,
-// and memory and time overheads creep in.
+// [JN] Visplane pool.
 //
-// Lee Killough
+// Visplanes are allocated in chunks and never freed between frames,
+// R_ClearPlanes only rewinds the pool. Each chunk also holds top/bottom
+// arrays for all of its planes, sized to the view width the pool was
+// built for, so a plane costs 4 * viewwidth bytes instead of 4 * MAXWIDTH.
+// The pool is rebuilt when the view width changes.
+//
+// Hash table starts at 128 slots and doubles (with a rehash) whenever
+// there are more than two visplanes per slot on average.
 // -----------------------------------------------------------------------------
 
-#define MAXVISPLANES	128                  // must be a power of 2
-
-static visplane_t *visplanes[MAXVISPLANES];  // [JN] killough
-static visplane_t *freetail;                 // [JN] killough
-static visplane_t **freehead = &freetail;    // [JN] killough
+#define VISPLANE_CHUNK      128
+#define VISPLANE_HASH_INIT  128                 // must be a power of 2
+
+static visplane_t **visplanes;                  // hash heads
+static unsigned int visplanes_hashsize;
+static visplane_t **visplane_pool;              // all allocated planes
+static int visplane_poolsize;
+static int visplane_poolused;
+static void **visplane_chunks;
+static int visplane_numchunks;
+static int visplane_width = -1;                 // viewwidth of the pool
 visplane_t *floorplane, *ceilingplane;
 
-// [JN] killough -- hash function for visplanes
-// Empirically verified to be fairly uniform:
+static void R_FreePlanePool (void);
+
+// [JN] Integer mixing hash, spreads nearby heights (which only differ
+// in their upper 16 bits) and picnums over the whole table.
+
+static inline unsigned int visplane_hash (int picnum, int lightlevel, fixed_t height)
+{
+    unsigned int h = (unsigned)picnum * 0x9e3779b1u
+                   + (unsigned)lightlevel * 0x85ebca77u
+                   + (unsigned)height;
+
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
 
-#define visplane_hash(picnum, lightlevel, height) \
-    ((unsigned)((picnum) * 3 + (lightlevel) + (height) * 7) & (MAXVISPLANES - 1))
+    return h & (visplanes_hashsize - 1);
+}
 
 // [JN] killough 8/1/98: set static number of openings to be large enough
 // (a static limit is okay in this case and avoids difficulties in r_segs.c)
@@ -221,45 +243,134 @@ void R_ClearPlanes (void)
         ceilingclip[i] = -1;
     }
 
-    // [PN] Optimize loop by avoiding unnecessary assignments and checks.
-    // Only process non-null visplanes and simplify inner loop performance.
-    for (i = 0; i < MAXVISPLANES; i++)
+    // [JN] Rebuild the pool if view width has changed.
+    if (visplane_width != viewwidth)
     {
-        if (visplanes[i] != NULL)
-        {
-            *freehead = visplanes[i];
-            visplanes[i] = NULL;
-            while (*freehead)
-            {
-                freehead = &(*freehead)->next;
-            }
-        }
+        R_FreePlanePool();
+        visplane_width = viewwidth;
+    }
+
+    if (!visplanes)
+    {
+        visplanes_hashsize = VISPLANE_HASH_INIT;
+        visplanes = calloc(visplanes_hashsize, sizeof(*visplanes));
+    }
+    else
+    {
+        memset(visplanes, 0, visplanes_hashsize * sizeof(*visplanes));
     }
 
+    visplane_poolused = 0;
+
     lastopening = openings;
 
     // texture calculation
     memset(cachedheight, 0, sizeof(cachedheight));
 }
 
+// -----------------------------------------------------------------------------
+// R_FreePlanePool
+//  [JN] Releases all visplanes and their clip arrays.
+// -----------------------------------------------------------------------------
+
+static void R_FreePlanePool (void)
+{
+    for (int i = 0 ; i < visplane_numchunks ; i++)
+    {
+        free(visplane_chunks[i]);
+    }
+
+    free(visplane_chunks);
+    free(visplane_pool);
+    visplane_chunks = NULL;
+    visplane_pool = NULL;
+    visplane_numchunks = 0;
+    visplane_poolsize = 0;
+    visplane_poolused = 0;
+}
+
+// -----------------------------------------------------------------------------
+// R_AllocPlaneChunk
+//  [JN] Adds VISPLANE_CHUNK planes to the pool, with their top/bottom
+//  arrays in the same allocation.
+// -----------------------------------------------------------------------------
+
+static void R_AllocPlaneChunk (void)
+{
+    const size_t stride = visplane_width + 2;  // pads at [-1] and [width]
+    visplane_t *planes;
+    unsigned short *clip;
+    byte *chunk;
+
+    chunk = I_Realloc(NULL, VISPLANE_CHUNK * (sizeof(visplane_t)
+                          + 2 * stride * sizeof(unsigned short)));
+    planes = (visplane_t *) chunk;
+    clip = (unsigned short *) (planes + VISPLANE_CHUNK);
+
+    visplane_chunks = I_Realloc(visplane_chunks,
+                                (visplane_numchunks + 1) * sizeof(*visplane_chunks));
+    visplane_chunks[visplane_numchunks++] = chunk;
+
+    visplane_pool = I_Realloc(visplane_pool,
+                              (visplane_poolsize + VISPLANE_CHUNK) * sizeof(*visplane_pool));
+
+    for (int i = 0 ; i < VISPLANE_CHUNK ; i++)
+    {
+        planes[i].top = clip + 1;
+        planes[i].bottom = clip + stride + 1;
+        clip += 2 * stride;
+        visplane_pool[visplane_poolsize++] = &planes[i];
+    }
+}
+
+// -----------------------------------------------------------------------------
+// R_GrowPlaneHash
+//  [JN] Doubles hash table size and reinserts all planes in creation
+//  order, so duplicated planes keep their relative order in the chains.
+// -----------------------------------------------------------------------------
+
+static void R_GrowPlaneHash (void)
+{
+    visplanes_hashsize <<= 1;
+    free(visplanes);
+    visplanes = calloc(visplanes_hashsize, sizeof(*visplanes));
+
+    for (int i = 0 ; i < visplane_poolused ; i++)
+    {
+        visplane_t *pl = visplane_pool[i];
+        const unsigned int hash = visplane_hash(pl->picnum, pl->lightlevel, pl->height);
+
+        pl->next = visplanes[hash];
+        visplanes[hash] = pl;
+    }
+}
+
 // -----------------------------------------------------------------------------
 // [crispy] remove MAXVISPLANES Vanilla limit
 // New function, by Lee Killough
 // -----------------------------------------------------------------------------
 
-static visplane_t *new_visplane (unsigned const int hash)
+static visplane_t *new_visplane (int picnum, int lightlevel, fixed_t height)
 {
-    visplane_t *check = freetail;
+    visplane_t *check;
+    unsigned int hash;
 
-    if (!check)
+    if (visplane_poolused == visplane_poolsize)
     {
-        check = calloc(1, sizeof(*check));
+        R_AllocPlaneChunk();
     }
-    else if (!(freetail = freetail->next))
+
+    if ((unsigned int) visplane_poolused >= visplanes_hashsize * 2)
     {
-        freehead = &freetail;
+        R_GrowPlaneHash();
     }
 
+    check = visplane_pool[visplane_poolused++];
+    check->height = height;
+    check->picnum = picnum;
+    check->lightlevel = lightlevel;
+
+    hash = visplane_hash(picnum, lightlevel, height);
     check->next = visplanes[hash];
     visplanes[hash] = check;
 
@@ -304,16 +415,12 @@ R_FindPlane
         && lightlevel == check->lightlevel)
             return check;
 
-    check = new_visplane(hash);
+    check = new_visplane(picnum, lightlevel, height);
 
-    check->height = height;
-    check->picnum = picnum;
-    check->lightlevel = lightlevel;
+    // [JN] Empty range, columns are cleared by R_CheckPlane once marked.
     check->minx = SCREENWIDTH;
     check->maxx = -1;
 
-    memset(check->top, UCHAR_MAX, viewwidth * sizeof(*check->top));
-
     return check;
 }
 
@@ -323,15 +430,13 @@ R_FindPlane
 
 visplane_t *R_DupPlane(const visplane_t *pl, int start, int stop)
 {
-    visplane_t  *new_pl = new_visplane(visplane_hash(pl->picnum, pl->lightlevel, pl->height));
+    visplane_t  *new_pl = new_visplane(pl->picnum, pl->lightlevel, pl->height);
 
-    new_pl->height = pl->height;
-    new_pl->picnum = pl->picnum;
-    new_pl->lightlevel = pl->lightlevel;
     new_pl->minx = start;
     new_pl->maxx = stop;
 
-    memset(new_pl->top, UCHAR_MAX, viewwidth * sizeof(*new_pl->top));
+    // [JN] Only the columns in use have to be cleared.
+    memset(new_pl->top + start, UCHAR_MAX, (stop - start + 1) * sizeof(*new_pl->top));
 
     return new_pl;
 }
@@ -369,6 +474,25 @@ R_CheckPlane
     for (x=intrl ; x <= intrh && pl->top[x] == USHRT_MAX; x++);
     if (x > intrh)
     {
+        // [JN] Clear columns which are entering the range. Columns
+        // outside of [minx, maxx] are never read, so they are left
+        // untouched until then.
+        if (pl->minx > pl->maxx)
+        {
+            memset(pl->top + start, UCHAR_MAX, (stop - start + 1) * sizeof(*pl->top));
+        }
+        else
+        {
+            if (unionl < pl->minx)
+            {
+                memset(pl->top + unionl, UCHAR_MAX, (pl->minx - unionl) * sizeof(*pl->top));
+            }
+            if (unionh > pl->maxx)
+            {
+                memset(pl->top + pl->maxx + 1, UCHAR_MAX, (unionh - pl->maxx) * sizeof(*pl->top));
+            }
+        }
+
         // Can use existing plane; extend range
         pl->minx = unionl, pl->maxx = unionh;
         return pl;
@@ -411,6 +535,203 @@ R_MakeSpans
 }
 
 
+// -----------------------------------------------------------------------------
+// [JN] Sky column cache.
+//
+// Sky is always fullbright and its texture coordinate only depends on the
+// row's distance from centery, so every texture column can be stored as
+// ready-to-copy pixels, indexed by (y - centery). This makes the cache
+// independent of the view pitch: looking up and down only extends the
+// filled range of a column, drawing is a plain strided copy.
+//
+// Entries are keyed on everything that affects the output: texture,
+// texturemid and iscale (sky transfers, stretching, detail), texture
+// height, view height and the colormap in use (plus its generation, as
+// colormaps are rebuilt in place on gamma and saturation changes).
+// A few entries are kept, so MBF sky transfers and remaster multi-skies
+// sharing a view do not evict each other every frame.
+// -----------------------------------------------------------------------------
+
+#define SKYCACHE_ENTRIES 4
+
+typedef struct
+{
+    int texture;
+    int texheight;
+    int viewheight;
+    fixed_t texturemid;
+    fixed_t iscale;
+    const lighttable_t *colormap;
+    unsigned int generation;
+
+    int width;          // texture width, columns
+    int rows;           // rows per column, 3 * viewheight
+    int origin;         // row index of y == centery
+    pixel_t *pixels;    // width * rows
+    short *filled;      // [lo, hi] valid row range per column, width * 2
+    size_t size;        // allocated pixels
+    int columns;        // allocated columns in filled
+    unsigned int lastuse;
+} skycache_t;
+
+static skycache_t skycache[SKYCACHE_ENTRIES];
+static unsigned int skycache_clock;
+
+static skycache_t *R_GetSkyCache (int texture, fixed_t texturemid, fixed_t iscale,
+                                  int texheight, const lighttable_t *colormap)
+{
+    skycache_t *sky = NULL;
+    int i;
+
+    skycache_clock++;
+
+    for (i = 0 ; i < SKYCACHE_ENTRIES ; i++)
+    {
+        skycache_t *const c = &skycache[i];
+
+        if (c->texture == texture && c->texturemid == texturemid
+        &&  c->iscale == iscale && c->texheight == texheight
+        &&  c->viewheight == viewheight && c->colormap == colormap
+        &&  c->generation == colormaps_generation && c->pixels)
+        {
+            c->lastuse = skycache_clock;
+            return c;
+        }
+
+        if (!sky || c->lastuse < sky->lastuse)
+        {
+            sky = c;
+        }
+    }
+
+    // Not cached, recycle the least recently used entry.
+    sky->texture = texture;
+    sky->texturemid = texturemid;
+    sky->iscale = iscale;
+    sky->texheight = texheight;
+    sky->viewheight = viewheight;
+    sky->colormap = colormap;
+    sky->generation = colormaps_generation;
+    sky->width = texturewidth[texture];
+    sky->rows = 3 * viewheight;
+    sky->origin = sky->rows / 2;
+    sky->lastuse = skycache_clock;
+
+    if (sky->size < (size_t)sky->width * sky->rows)
+    {
+        sky->size = (size_t)sky->width * sky->rows;
+        sky->pixels = I_Realloc(sky->pixels, sky->size * sizeof(*sky->pixels));
+    }
+    if (sky->columns < sky->width)
+    {
+        sky->columns = sky->width;
+        sky->filled = I_Realloc(sky->filled, sky->columns * 2 * sizeof(*sky->filled));
+    }
+
+    // Mark all columns empty.
+    for (i = 0 ; i < sky->width ; i++)
+    {
+        sky->filled[2 * i] = 0;
+        sky->filled[2 * i + 1] = -1;
+    }
+
+    return sky;
+}
+
+// Computes rows [lo, hi] of a cached column, with the same texture
+// coordinate math R_DrawColumn uses for a column starting at each row.
+
+static void R_FillSkyRows (const skycache_t *sky, pixel_t *dest,
+                           const byte *source, int lo, int hi)
+{
+    const lighttable_t *const colormap = sky->colormap;
+    const int heightmask = sky->texheight - 1;
+    const fixed_t heightshifted = sky->texheight << FRACBITS;
+
+    for (int i = lo ; i <= hi ; i++)
+    {
+        fixed_t frac = sky->texturemid + (i - sky->origin) * sky->iscale;
+
+        if (sky->texheight & heightmask)
+        {
+            frac = (frac % heightshifted + heightshifted) % heightshifted;
+            dest[i] = colormap[source[frac >> FRACBITS]];
+        }
+        else
+        {
+            dest[i] = colormap[source[(frac >> FRACBITS) & heightmask]];
+        }
+    }
+}
+
+// Returns the cached column for the given sky angle, making sure
+// rows [lo, hi] (relative to origin) are valid.
+
+static const pixel_t *R_SkyColumn (skycache_t *sky, int angle, int lo, int hi)
+{
+    const int col = angle % sky->width;
+    pixel_t *const pixels = sky->pixels + (size_t)col * sky->rows;
+    short *const filled = sky->filled + 2 * col;
+
+    if (filled[0] > filled[1])
+    {
+        R_FillSkyRows(sky, pixels, R_GetColumnMod2(sky->texture, col), lo, hi);
+        filled[0] = lo;
+        filled[1] = hi;
+    }
+    else if (lo < filled[0] || hi > filled[1])
+    {
+        const byte *const source = R_GetColumnMod2(sky->texture, col);
+
+        if (lo < filled[0])
+        {
+            R_FillSkyRows(sky, pixels, source, lo, filled[0] - 1);
+            filled[0] = lo;
+        }
+        if (hi > filled[1])
+        {
+            R_FillSkyRows(sky, pixels, source, filled[1] + 1, hi);
+            filled[1] = hi;
+        }
+    }
+
+    return pixels;
+}
+
+// Draws one sky visplane from the cache. Returns false if the view
+// pitch is outside the cached range and the caller has to fall back.
+
+static boolean R_DrawSkyPlane (const visplane_t *pl, int texture, angle_t an, angle_t flip)
+{
+    skycache_t *sky;
+
+    if (centery < -viewheight / 2 || centery > viewheight + viewheight / 2)
+    {
+        return false;
+    }
+
+    sky = R_GetSkyCache(texture, dc_texturemid, dc_iscale, dc_texheight, dc_colormap[0]);
+
+    for (int x = pl->minx ; x <= pl->maxx ; x++)
+    {
+        if ((dc_yl = pl->top[x]) != USHRT_MAX && dc_yl <= (dc_yh = pl->bottom[x]))
+        {
+            // [crispy] Optionally draw skies horizontally linear.
+            const int angle = ((an + (vis_linear_sky ?
+                                linearskyangle[x] : xtoviewangle[x]))^flip)>>ANGLETOSKYSHIFT;
+            const int lo = dc_yl - centery + sky->origin;
+            const int hi = dc_yh - centery + sky->origin;
+
+            dc_x = x;
+            dc_skysource = R_SkyColumn(sky, angle, lo, hi) + lo;
+            skycolfunc();
+        }
+    }
+
+    return true;
+}
+
+
 
 //
 // R_DrawPlanes
@@ -421,10 +742,33 @@ void R_DrawPlanes (void)
     // [JN] CRL - openings counter.
     IDRender.numopenings = lastopening - openings;
 
-    for (int i = 0 ; i < MAXVISPLANES ; i++)
-    for (visplane_t *pl = visplanes[i] ; pl ; pl = pl->next, IDRender.numplanes++)
-    if (pl->minx <= pl->maxx)
+    // [JN] Visplane counters, longest chain is only needed for the widget.
+    IDRender.numplanes = visplane_poolused;
+    if (widget_render)
     {
+        IDRender.planechain = 0;
+
+        for (unsigned int i = 0 ; i < visplanes_hashsize ; i++)
+        {
+            int chain = 0;
+
+            for (const visplane_t *pl = visplanes[i] ; pl ; pl = pl->next)
+            {
+                chain++;
+            }
+            if (chain > IDRender.planechain)
+            {
+                IDRender.planechain = chain;
+            }
+        }
+    }
+
+    // [JN] Draw in creation order, as vanilla does.
+    for (int i = 0 ; i < visplane_poolused ; i++)
+    if (visplane_pool[i]->minx <= visplane_pool[i]->maxx)
+    {
+        visplane_t *const pl = visplane_pool[i];
+
         // sky flat
         // [crispy] add support for MBF sky tranfers
         // [JN] Minimal support for Doom 1 + Doom 2 multiple skies.
@@ -475,6 +819,11 @@ void R_DrawPlanes (void)
                 dc_iscale = (dc_iscale * dc_texheight) / SKYSTRETCH_HEIGHT;  // [PN] Adjust scale
                 dc_texturemid = (dc_texturemid * dc_texheight) / SKYSTRETCH_HEIGHT;  // [PN] Adjust mid
             }
+            // [JN] Draw from the sky column cache if possible.
+            if (R_DrawSkyPlane(pl, texture, an, flip))
+            {
+                continue;
+            }
             for (int x = pl->minx ; x <= pl->maxx ; x++)
             {
                 if ((dc_yl = pl->top[x]) != USHRT_MAX && dc_yl <= (dc_yh = pl->bottom[x]))
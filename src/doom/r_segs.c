@@ -295,6 +295,11 @@ void R_RenderSegLoop (void)
 {
     fixed_t texturecolumn = 0;  // [JN] Purely to shut up the compiler.
 
+    // [JN] Pick the specialized column drawers once per seg.
+    void (*const midcolfunc) (void) = midtexture ? R_WallColumnFunc(midtexture) : NULL;
+    void (*const topcolfunc) (void) = toptexture ? R_WallColumnFunc(toptexture) : NULL;
+    void (*const bottomcolfunc) (void) = bottomtexture ? R_WallColumnFunc(bottomtexture) : NULL;
+
     for ( ; rw_x < rw_stopx ; rw_x++)
     {
         // mark floor / ceiling areas
@@ -387,7 +392,7 @@ void R_RenderSegLoop (void)
             dc_source = R_GetColumn(midtexture, texturecolumn);
             dc_texheight = textureheight[midtexture] >> FRACBITS;
             dc_brightmap = texturebrightmap[midtexture];
-            colfunc ();
+            midcolfunc ();
             ceilingclip[rw_x] = viewheight;
             floorclip[rw_x] = -1;
         }
@@ -408,7 +413,7 @@ void R_RenderSegLoop (void)
                     dc_source = R_GetColumn(toptexture,texturecolumn);
                     dc_texheight = textureheight[toptexture]>>FRACBITS;
                     dc_brightmap = texturebrightmap[toptexture];
-                    colfunc ();
+                    topcolfunc ();
                     ceilingclip[rw_x] = mid;
                 }
                 else
@@ -439,7 +444,7 @@ void R_RenderSegLoop (void)
                     dc_source = R_GetColumn(bottomtexture,texturecolumn);
                     dc_texheight = textureheight[bottomtexture]>>FRACBITS;
                     dc_brightmap = texturebrightmap[bottomtexture];
-                    colfunc ();
+                    bottomcolfunc ();
                     floorclip[rw_x] = mid;
                 }
                 else
@@ -21,11 +21,21 @@
 
 // [crispy] adapted from smmu/r_ripple.c, by Simon Howard
 
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
 #include "tables.h"
 #include "i_system.h"
 #include "w_wad.h"
 #include "z_zone.h"
 #include "doomstat.h"
+#include "r_local.h"
+
+#include "id_func.h"
 
 
 // swirl factors
@@ -39,25 +49,39 @@
 #define AMP2 2                          // [PN] Amplitude for the secondary distortion.
 #define SPEED 32                        // [PN] Speed of the wave distortion.
 
+// [JN] Offsets fit into 16 bits, which halves the tables and keeps
+// the current frame in cache while a flat is generated.
+
 // Classic SMMU swirling effect
-static int *offsets = NULL;             // [PN] Array to store offsets for all frames.
-static int *offset;                     // [PN] Current pointer to offsets for a specific frame.
-static int *offset_frames[SEQUENCE];    // [PN] Array of pointers to frame offsets.
+static uint16_t *offsets = NULL;        // [PN] Array to store offsets for all frames.
+static uint16_t *offset_frames[SEQUENCE];  // [PN] Array of pointers to frame offsets.
 
 // Warping effect 1
-static int *offsets1 = NULL;
-static int *offset1;
-static int *offset_frames1[SEQUENCE];
+static uint16_t *offsets1 = NULL;
+static uint16_t *offset_frames1[SEQUENCE];
 
 // Warping effect 2
-static int *offsets2 = NULL;
-static int *offset2;
-static int *offset_frames2[SEQUENCE];
+static uint16_t *offsets2 = NULL;
+static uint16_t *offset_frames2[SEQUENCE];
 
 // Warping effect 3
-static int *offsets3 = NULL;
-static int *offset3;
-static int *offset_frames3[SEQUENCE];
+static uint16_t *offsets3 = NULL;
+static uint16_t *offset_frames3[SEQUENCE];
+
+// [JN] Distorted flats, generated at most once per tic for every flat and
+// shared by all visplanes that show it. Each flat has two buffers: a new
+// tic is generated into the one not handed out last, so a pointer from
+// the previous tic stays valid.
+typedef struct
+{
+    byte data[2][FLATSIZE];
+    int  front;     // Buffer holding the current frame
+    int  tic;       // leveltime the current frame was generated for
+    int  effect;    // Distortion the current frame was generated with
+} liquidflat_t;
+
+static liquidflat_t **liquidflats;
+static int numliquidflats;
 
 void R_InitDistortedFlats (void)
 {
@@ -66,7 +90,6 @@ void R_InitDistortedFlats (void)
 		// Classic SMMU swirling effect.
 		// ANIMATED: 65536, internal: -1
 		offsets = I_Realloc(offsets, SEQUENCE * FLATSIZE * sizeof(*offsets));
-		offset = offsets;
 
 		for (int i = 0; i < SEQUENCE; i++)
 		{
@@ -103,7 +126,6 @@ void R_InitDistortedFlats (void)
         // [PN] Warping effect 1, more uniform. Used for slime and blood.
         // ANIMATED: 65537, internal: -2.
         offsets1 = I_Realloc(offsets1, SEQUENCE * FLATSIZE * sizeof(*offsets1));
-        offset1 = offsets1;
 
         for (int i = 0; i < SEQUENCE; i++)
         {
@@ -126,7 +148,6 @@ void R_InitDistortedFlats (void)
         // [JN] Warping effect 2, less uniform. Used for lava.
         // ANIMATED: 65538, internal: -3.
         offsets2 = I_Realloc(offsets2, SEQUENCE * FLATSIZE * sizeof(*offsets2));
-        offset2 = offsets2;
 
         for (int i = 0; i < SEQUENCE; i++)
         {
@@ -149,7 +170,6 @@ void R_InitDistortedFlats (void)
         // [JN] Warping effect 3, weak diagonal effect. Used for sludge.
         // ANIMATED: 65539, internal: -4.
         offsets3 = I_Realloc(offsets3, SEQUENCE * FLATSIZE * sizeof(*offsets3));
-        offset3 = offsets3;
 
         for (int i = 0; i < SEQUENCE; i++)
         {
@@ -173,117 +193,173 @@ void R_InitDistortedFlats (void)
             }
         }
 	}
+
+    if (numliquidflats != numflats)
+    {
+        for (int i = 0; i < numliquidflats; i++)
+        {
+            free(liquidflats[i]);
+        }
+        liquidflats = I_Realloc(liquidflats, numflats * sizeof(*liquidflats));
+        memset(liquidflats, 0, numflats * sizeof(*liquidflats));
+        numliquidflats = numflats;
+    }
 }
 
-byte *R_SwirlingFlat (int flatnum)
+// -----------------------------------------------------------------------------
+// [JN] AVX2 distortion.
+//
+// The offset table lookup is a byte gather, done eight pixels at a time
+// the same way as in R_DrawSpanAVX2: each texel is fetched as the dword
+// containing it and shifted down. Offsets are below FLATSIZE, so this
+// never reads past the end of the flat. Output is identical to the scalar
+// loop, which is used when the CPU has no AVX2.
+// -----------------------------------------------------------------------------
+
+#if defined(__AVX2__)
+#define R_SWIRL_AVX2
+#define R_SWIRL_AVX2_TARGET
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define R_SWIRL_AVX2
+#define R_SWIRL_AVX2_TARGET __attribute__((target("avx2")))
+#define R_SWIRL_AVX2_RUNTIME
+#endif
+
+#ifdef R_SWIRL_AVX2
+
+R_SWIRL_AVX2_TARGET
+static inline __m256i R_SwirlGather (const byte *base, const uint16_t *offset)
 {
-	static int swirltic = -1;
-	static int swirlflat = -1;
-	static byte distortedflat[FLATSIZE];
-
-	if (swirltic != leveltime)
-	{
-		offset = offset_frames[leveltime & (SEQUENCE - 1)];
+    const __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) offset));
+    const __m256i dword = _mm256_i32gather_epi32((const int *) base,
+                                                 _mm256_srli_epi32(index, 2), 4);
+    const __m256i shift = _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(3)), 3);
 
-		swirltic = leveltime;
-		swirlflat = -1;
-	}
+    return _mm256_and_si256(_mm256_srlv_epi32(dword, shift), _mm256_set1_epi32(0xFF));
+}
 
-	if (swirlflat != flatnum)
-	{
-		const char *normalflat = W_CacheLumpNum(flatnum, PU_STATIC);
+// Distorts count / 32 blocks of pixels and returns the number of pixels done.
 
-        // [PN] Loop through each pixel and apply the distortion.
-		for (int i = 0; i < FLATSIZE; i++)
-			distortedflat[i] = normalflat[offset[i]];
+R_SWIRL_AVX2_TARGET
+static int R_DistortFlatAVX2 (byte *restrict dest, const byte *restrict source,
+                              const uint16_t *restrict offset, const int count)
+{
+    // Packing interleaves the 128-bit lanes, this puts the dwords back.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int i;
 
-		W_ReleaseLumpNum(flatnum);
-		swirlflat = flatnum;
-	}
+    for (i = 0; i + 32 <= count; i += 32)
+    {
+        const __m256i p0 = R_SwirlGather(source, offset + i);
+        const __m256i p1 = R_SwirlGather(source, offset + i + 8);
+        const __m256i p2 = R_SwirlGather(source, offset + i + 16);
+        const __m256i p3 = R_SwirlGather(source, offset + i + 24);
+        const __m256i words = _mm256_packus_epi16(_mm256_packus_epi32(p0, p1),
+                                                  _mm256_packus_epi32(p2, p3));
+
+        _mm256_storeu_si256((__m256i *) (dest + i),
+                            _mm256_permutevar8x32_epi32(words, order));
+    }
 
-	return distortedflat;
+    return i;
 }
 
-byte *R_WarpingFlat1 (int flatnum)
+static boolean R_SwirlHaveAVX2 (void)
 {
-    static int swirltic = -1;
-    static int swirlflat = -1;
-    static byte distortedflat[FLATSIZE];
+#ifdef R_SWIRL_AVX2_RUNTIME
+    static int have_avx2 = -1;
 
-    if (swirltic != leveltime)
+    if (have_avx2 < 0)
     {
-        offset1 = offset_frames1[leveltime & (SEQUENCE - 1)];
-        swirltic = leveltime;
-        swirlflat = -1;
+        __builtin_cpu_init();
+        have_avx2 = __builtin_cpu_supports("avx2") != 0;
     }
 
-    if (swirlflat != flatnum)
-    {
-        const char *normalflat = W_CacheLumpNum(flatnum, PU_STATIC);
-
-        // [PN] Loop through each pixel and apply the distortion.
-        for (int i = 0; i < FLATSIZE; i++)
-            distortedflat[i] = normalflat[offset1[i]];
+    return have_avx2;
+#else
+    return true;
+#endif
+}
 
-        W_ReleaseLumpNum(flatnum);
-        swirlflat = flatnum;
-    }
+#endif // R_SWIRL_AVX2
 
-    return distortedflat;
-}
+// -----------------------------------------------------------------------------
+// R_DistortedFlat
+//  [JN] Distorted frame of the given flat for the current tic, generated
+//  on the first request in a tic and reused by every later one.
+// -----------------------------------------------------------------------------
 
-byte *R_WarpingFlat2 (int flatnum)
+static byte *R_DistortedFlat (int flatnum, int effect, uint16_t *const *frames)
 {
-    static int swirltic = -1;
-    static int swirlflat = -1;
-    static byte distortedflat[FLATSIZE];
+    const int index = flatnum - firstflat;
+    liquidflat_t *flat;
 
-    if (swirltic != leveltime)
+    if (index < 0 || index >= numliquidflats)
     {
-        offset2 = offset_frames2[leveltime & (SEQUENCE - 1)];
-        swirltic = leveltime;
-        swirlflat = -1;
+        I_Error("R_DistortedFlat: flat %d out of range", flatnum);
     }
 
-    if (swirlflat != flatnum)
+    flat = liquidflats[index];
+
+    if (flat == NULL)
+    {
+        flat = liquidflats[index] = I_Realloc(NULL, sizeof(*flat));
+        flat->front = 0;
+        flat->tic = -1;
+        flat->effect = 0;
+    }
+
+    if (flat->tic == leveltime && flat->effect == effect)
     {
-        const char *normalflat = W_CacheLumpNum(flatnum, PU_STATIC);
+        IDRender.liquidhits++;
+    }
+    else
+    {
+        const uint16_t *restrict const offset = frames[leveltime & (SEQUENCE - 1)];
+        const byte *restrict const normalflat = W_CacheLumpNum(flatnum, PU_STATIC);
+        byte *restrict const distortedflat = flat->data[flat->front ^ 1];
+        int i = 0;
+
+#ifdef R_SWIRL_AVX2
+        if (R_SwirlHaveAVX2())
+        {
+            i = R_DistortFlatAVX2(distortedflat, normalflat, offset, FLATSIZE);
+        }
+#endif
 
         // [PN] Loop through each pixel and apply the distortion.
-        for (int i = 0; i < FLATSIZE; i++)
-            distortedflat[i] = normalflat[offset2[i]];
+        for ( ; i < FLATSIZE; i++)
+        {
+            distortedflat[i] = normalflat[offset[i]];
+        }
 
         W_ReleaseLumpNum(flatnum);
-        swirlflat = flatnum;
+
+        flat->front ^= 1;
+        flat->tic = leveltime;
+        flat->effect = effect;
+        IDRender.liquidmisses++;
     }
 
-    return distortedflat;
+    return flat->data[flat->front];
 }
 
-byte *R_WarpingFlat3 (int flatnum)
+byte *R_SwirlingFlat (int flatnum)
 {
-    static int swirltic = -1;
-    static int swirlflat = -1;
-    static byte distortedflat[FLATSIZE];
-
-    if (swirltic != leveltime)
-    {
-        offset3 = offset_frames3[leveltime & (SEQUENCE - 1)];
-        swirltic = leveltime;
-        swirlflat = -1;
-    }
-
-    if (swirlflat != flatnum)
-    {
-        const char *normalflat = W_CacheLumpNum(flatnum, PU_STATIC);
+    return R_DistortedFlat(flatnum, 1, offset_frames);
+}
 
-        // [PN] Loop through each pixel and apply the distortion.
-        for (int i = 0; i < FLATSIZE; i++)
-            distortedflat[i] = normalflat[offset3[i]];
+byte *R_WarpingFlat1 (int flatnum)
+{
+    return R_DistortedFlat(flatnum, 2, offset_frames1);
+}
 
-        W_ReleaseLumpNum(flatnum);
-        swirlflat = flatnum;
-    }
+byte *R_WarpingFlat2 (int flatnum)
+{
+    return R_DistortedFlat(flatnum, 3, offset_frames2);
+}
 
-    return distortedflat;
+byte *R_WarpingFlat3 (int flatnum)
+{
+    return R_DistortedFlat(flatnum, 4, offset_frames3);
 }
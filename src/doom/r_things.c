@@ -20,6 +20,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "deh_main.h"
 #include "doomdef.h"
@@ -46,23 +47,27 @@
 static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs; // killough
 static vissprite_t *vissprites, **vissprite_ptrs;                     // killough
 
-typedef struct drawseg_xrange_item_s
-{
-    short x1, x2;
-    drawseg_t *user;
-} drawseg_xrange_item_t;
+// -----------------------------------------------------------------------------
+// [JN] Screen-column index of drawsegs for sprite clipping.
+//
+// Only drawsegs with silhouettes or masked textures can affect sprites.
+// The view is split into DS_BUCKETS column ranges, and each bucket lists
+// (by index, last to first) the drawsegs that overlap it. A sprite merges
+// the lists of the buckets it covers, dropping duplicates, so it visits
+// only nearby drawsegs but still in the original back-to-front order.
+// Sprites covering more than DS_MERGE_MAX buckets walk the full list.
+// -----------------------------------------------------------------------------
 
-typedef struct drawsegs_xrange_s
-{
-    drawseg_xrange_item_t *items;
-    int count;
-} drawsegs_xrange_t;
+#define DS_BUCKETS   64
+#define DS_MERGE_MAX 8
 
-#define DS_RANGES_COUNT 3
-static drawsegs_xrange_t drawsegs_xranges[DS_RANGES_COUNT];
-static drawseg_xrange_item_t *drawsegs_xrange;
-static unsigned int drawsegs_xrange_size = 0;
-static int drawsegs_xrange_count = 0;
+static int *ds_all;                         // all candidates, last to first
+static int  ds_all_count;
+static int *ds_index;                       // bucket lists, back to back
+static int  ds_bucketstart[DS_BUCKETS + 1];
+static int  ds_bucketwidth;
+static int *ds_merged;                      // per-sprite merge buffer
+static size_t ds_all_size, ds_index_size;
 
 
 //
@@ -749,78 +754,51 @@ static void R_ProjectSprite (mobj_t* thing)
     //   * Hemi-bright. Lits up brightmapped pixels with full power,
     //     and non-brightmapped pixels with distance index miltipled by 4.
     //   * Just animated. Lits up all sprite pixels and applies animation.
-        // Semi-brigths:
-        if (thing->sprite == SPR_BON2   // Armor Bonus
-        ||  thing->sprite == SPR_BAR1)  // Explosive Barrel
-        {
-            vis->colormap[1] = spritelights[BMAPMAXDIMINDEX];
-        }
-        // Demi-brigths:
-        else
-        if (thing->sprite == SPR_CAND   // Candestick
-        ||  thing->sprite == SPR_CBRA   // Candelabra
-        ||  thing->sprite == SPR_COLU   // Floor Lamp
-        ||  thing->sprite == SPR_FCAN   // Flaming Barrel
-        ||  thing->sprite == SPR_TLMP   // Tall Tech Lamp
-        ||  thing->sprite == SPR_TLP2)  // Short Tech Lamp
-        {
-            const int demi_bright = MIN(index*2, BMAPMAXDIMINDEX);
-
-            vis->colormap[0] = spritelights[demi_bright];
-
-            // Animated brightmaps:
-            if (thing->sprite == SPR_CAND   // Candestick
-            ||  thing->sprite == SPR_CBRA)  // Candelabra
-            {
-                vis->colormap[1] = &colormaps[(thing->bmap_flick<<BMAPANIMSHIFT)*256];
-            }
-            else
-            if (thing->sprite == SPR_FCAN)  // Flaming Barrel
-            {
-                vis->colormap[1] = &colormaps[(thing->bmap_glow<<BMAPANIMSHIFT)*256];
-            }
-            else
-            {
-                vis->colormap[1] = colormaps;
-            }
-        }
-        // Hemi-brigths:
-        else
-        if (thing->sprite == SPR_TBLU   // Tall Blue Torch
-        ||  thing->sprite == SPR_TGRN   // Tall Green Torch
-        ||  thing->sprite == SPR_TRED)  // Tall Red Torch
-        {
-            const int hemi_bright = MIN(index*4, BMAPMAXDIMINDEX);
+        const int flick = bmapflick[R_BrightmapSlot(thing)] << BMAPANIMSHIFT;
+        const int glow = bmapglow[R_BrightmapSlot(thing)] << BMAPANIMSHIFT;
 
-            vis->colormap[0] = spritelights[hemi_bright];
-            vis->colormap[1] = &colormaps[(thing->bmap_flick<<BMAPANIMSHIFT)/3*256];
-        }
-        // Just animated:
-        else
-        if (thing->sprite == SPR_SMBT   // Short Blue Torch
-        ||  thing->sprite == SPR_SMGT   // Short Green Torch
-        ||  thing->sprite == SPR_SMRT)  // Short Red Torch
-        {
-            vis->colormap[0] = vis->colormap[1]
-                             = &colormaps[(thing->bmap_flick<<BMAPANIMSHIFT)/4*256];
-        }
-        else
-        if (thing->sprite == SPR_CEYE   // Evil Eye
-        ||  thing->sprite == SPR_FSKU)  // Floating Skull Rock
-        {
-            vis->colormap[0] = vis->colormap[1]
-                             = &colormaps[(thing->bmap_glow<<BMAPANIMSHIFT)*256];
-        }
-        else
-        if (thing->sprite == SPR_POL3)  // Pile of Skulls and Candles
-        {
-            vis->colormap[0] = vis->colormap[1]
-                             = &colormaps[(thing->bmap_flick<<BMAPANIMSHIFT)/3*256];
-        }
-        // Normal brightmap:
-        else
+        switch (spritebrightanim[thing->sprite])
         {
-            vis->colormap[1] = colormaps;
+            // Semi-brigths:
+            case BMAP_SEMI:
+                vis->colormap[1] = spritelights[BMAPMAXDIMINDEX];
+                break;
+
+            // Demi-brigths:
+            case BMAP_DEMI:
+                vis->colormap[0] = spritelights[MIN(index*2, BMAPMAXDIMINDEX)];
+                vis->colormap[1] = colormaps;
+                break;
+            case BMAP_DEMI_FLICK:
+                vis->colormap[0] = spritelights[MIN(index*2, BMAPMAXDIMINDEX)];
+                vis->colormap[1] = &colormaps[flick*256];
+                break;
+            case BMAP_DEMI_GLOW:
+                vis->colormap[0] = spritelights[MIN(index*2, BMAPMAXDIMINDEX)];
+                vis->colormap[1] = &colormaps[glow*256];
+                break;
+
+            // Hemi-brigths:
+            case BMAP_HEMI_FLICK:
+                vis->colormap[0] = spritelights[MIN(index*4, BMAPMAXDIMINDEX)];
+                vis->colormap[1] = &colormaps[flick/3*256];
+                break;
+
+            // Just animated:
+            case BMAP_FLICK_QUARTER:
+                vis->colormap[0] = vis->colormap[1] = &colormaps[flick/4*256];
+                break;
+            case BMAP_GLOW:
+                vis->colormap[0] = vis->colormap[1] = &colormaps[glow*256];
+                break;
+            case BMAP_FLICK_THIRD:
+                vis->colormap[0] = vis->colormap[1] = &colormaps[flick/3*256];
+                break;
+
+            // Normal brightmap:
+            default:
+                vis->colormap[1] = colormaps;
+                break;
         }
     }	
     vis->brightmap = R_BrightmapForSprite(thing->sprite);
@@ -1129,20 +1107,159 @@ static void R_SortVisSprites (void)
 
 
 
+// -----------------------------------------------------------------------------
+// R_BuildDrawsegIndex
+// [JN] Fills the drawseg bucket lists for this frame.
+// -----------------------------------------------------------------------------
+
+static void R_BuildDrawsegIndex (void)
+{
+    int pos[DS_BUCKETS];
+    size_t total = 0;
+    int i;
+
+    if (ds_all_size < maxdrawsegs)
+    {
+        ds_all_size = maxdrawsegs;
+        ds_all = I_Realloc(ds_all, ds_all_size * sizeof(*ds_all));
+        ds_merged = I_Realloc(ds_merged, ds_all_size * sizeof(*ds_merged));
+    }
+
+    ds_bucketwidth = (viewwidth + DS_BUCKETS - 1) / DS_BUCKETS;
+    memset(pos, 0, sizeof(pos));
+    ds_all_count = 0;
+
+    // Collect candidates and count bucket sizes.
+    for (i = ds_p - drawsegs ; --i >= 0 ; )
+    {
+        const drawseg_t *const ds = &drawsegs[i];
+
+        if (ds->silhouette || ds->maskedtexturecol)
+        {
+            const int b2 = ds->x2 / ds_bucketwidth;
+
+            for (int b = ds->x1 / ds_bucketwidth ; b <= b2 ; b++)
+            {
+                pos[b]++;
+            }
+            total += b2 - ds->x1 / ds_bucketwidth + 1;
+            ds_all[ds_all_count++] = i;
+        }
+    }
+
+    if (ds_index_size < total)
+    {
+        ds_index_size = 2 * total;
+        ds_index = I_Realloc(ds_index, ds_index_size * sizeof(*ds_index));
+    }
+
+    // Bucket offsets.
+    ds_bucketstart[0] = 0;
+    for (i = 0 ; i < DS_BUCKETS ; i++)
+    {
+        ds_bucketstart[i + 1] = ds_bucketstart[i] + pos[i];
+        pos[i] = ds_bucketstart[i];
+    }
+
+    // Fill, keeping the last to first order.
+    for (i = 0 ; i < ds_all_count ; i++)
+    {
+        const drawseg_t *const ds = &drawsegs[ds_all[i]];
+        const int b2 = ds->x2 / ds_bucketwidth;
+
+        for (int b = ds->x1 / ds_bucketwidth ; b <= b2 ; b++)
+        {
+            ds_index[pos[b]++] = ds_all[i];
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// R_SpriteDrawsegs
+// [JN] Returns the drawsegs (last to first) a sprite has to check.
+// -----------------------------------------------------------------------------
+
+static const int *R_SpriteDrawsegs (const vissprite_t *spr, int *count)
+{
+    const int b1 = spr->x1 / ds_bucketwidth;
+    const int b2 = spr->x2 / ds_bucketwidth;
+    const int *head[DS_MERGE_MAX];
+    const int *tail[DS_MERGE_MAX];
+    int k = 0, n = 0;
+
+    if (b1 == b2)
+    {
+        *count = ds_bucketstart[b1 + 1] - ds_bucketstart[b1];
+        return ds_index + ds_bucketstart[b1];
+    }
+
+    if (b2 - b1 >= DS_MERGE_MAX)
+    {
+        *count = ds_all_count;
+        return ds_all;
+    }
+
+    for (int b = b1 ; b <= b2 ; b++)
+    {
+        if (ds_bucketstart[b] < ds_bucketstart[b + 1])
+        {
+            head[k] = ds_index + ds_bucketstart[b];
+            tail[k] = ds_index + ds_bucketstart[b + 1];
+            k++;
+        }
+    }
+
+    // Merge lists sorted by descending index, a drawseg spanning
+    // several buckets is taken once.
+    while (k > 0)
+    {
+        int top = -1;
+
+        for (int j = 0 ; j < k ; j++)
+        {
+            if (*head[j] > top)
+            {
+                top = *head[j];
+            }
+        }
+
+        ds_merged[n++] = top;
+
+        for (int j = 0 ; j < k ; )
+        {
+            if (*head[j] == top && ++head[j] == tail[j])
+            {
+                k--;
+                head[j] = head[k];
+                tail[j] = tail[k];
+            }
+            else
+            {
+                j++;
+            }
+        }
+    }
+
+    *count = n;
+    return ds_merged;
+}
+
 //
 // R_DrawSprite
 //
 static void R_DrawSprite (vissprite_t* spr)
 {
     drawseg_t*		ds;
-    int			clipbot[MAXWIDTH];  // [JN] 32-bit integer math
-    int			cliptop[MAXWIDTH];  // [JN] 32-bit integer math
+    static int		clipbot[MAXWIDTH];  // [JN] 32-bit integer math
+    static int		cliptop[MAXWIDTH];  // [JN] 32-bit integer math
     int			x;
     int			r1;
     int			r2;
     fixed_t		scale;
     fixed_t		lowscale;
     int			silhouette;
+    const int		*dslist;
+    int			dscount;
 		
     for (x = spr->x1 ; x<=spr->x2 ; x++)
 	clipbot[x] = cliptop[x] = -2;
@@ -1150,8 +1267,14 @@ static void R_DrawSprite (vissprite_t* spr)
     // Scan drawsegs from end to start for obscuring segs.
     // The first drawseg that has a greater scale
     //  is the clip seg.
-    for (ds=ds_p-1 ; ds >= drawsegs ; ds--)
+    // [JN] Only drawsegs from the screen columns the sprite covers.
+    dslist = R_SpriteDrawsegs(spr, &dscount);
+    IDRender.spritesegs += dscount;
+
+    for (int i = 0 ; i < dscount ; i++)
     {
+	ds = &drawsegs[dslist[i]];
+
 	// determine if the drawseg obscures the sprite
 	if (ds->x1 > spr->x2
 	    || ds->x2 < spr->x1
@@ -1253,53 +1376,11 @@ void R_DrawMasked (void)
 
     R_SortVisSprites();
 
-    // [JN] Andrey Budko
-    // Makes sense for scenes with huge amount of drawsegs.
-    // ~12% of speed improvement on epic.wad map05
-    for (i = 0 ; i < DS_RANGES_COUNT ; i++)
-    {
-        drawsegs_xranges[i].count = 0;
-    }
-
+    // [JN] Index drawsegs by screen columns for sprite clipping.
+    IDRender.spritesegs = 0;
     if (num_vissprite > 0)
     {
-        if (drawsegs_xrange_size < maxdrawsegs)
-        {
-            drawsegs_xrange_size = 2 * maxdrawsegs;
-
-            for(i = 0; i < DS_RANGES_COUNT; i++)
-            {
-                drawsegs_xranges[i].items = I_Realloc(
-                drawsegs_xranges[i].items,
-                drawsegs_xrange_size * sizeof(drawsegs_xranges[i].items[0]));
-            }
-        }
-
-        for (ds = ds_p; ds-- > drawsegs;)
-        {
-            if (ds->silhouette || ds->maskedtexturecol)
-            {
-                drawsegs_xranges[0].items[drawsegs_xranges[0].count].x1 = ds->x1;
-                drawsegs_xranges[0].items[drawsegs_xranges[0].count].x2 = ds->x2;
-                drawsegs_xranges[0].items[drawsegs_xranges[0].count].user = ds;
-
-                // [JN] Andrey Budko: ~13% of speed improvement on sunder.wad map10
-                if (ds->x1 < centerx)
-                {
-                    drawsegs_xranges[1].items[drawsegs_xranges[1].count] = 
-                    drawsegs_xranges[0].items[drawsegs_xranges[0].count];
-                    drawsegs_xranges[1].count++;
-                }
-                if (ds->x2 >= centerx)
-                {
-                    drawsegs_xranges[2].items[drawsegs_xranges[2].count] = 
-                    drawsegs_xranges[0].items[drawsegs_xranges[0].count];
-                    drawsegs_xranges[2].count++;
-                }
-
-                drawsegs_xranges[0].count++;
-            }
-        }
+        R_BuildDrawsegIndex();
     }
 
     // draw all vissprites back to front
@@ -1307,24 +1388,6 @@ void R_DrawMasked (void)
     IDRender.numsprites = num_vissprite;
     for (i = num_vissprite ; --i>=0 ; )
     {
-        vissprite_t* spr = vissprite_ptrs[i];
-
-        if (spr->x2 < centerx)
-        {
-            drawsegs_xrange = drawsegs_xranges[1].items;
-            drawsegs_xrange_count = drawsegs_xranges[1].count;
-        }
-        else if (spr->x1 >= centerx)
-        {
-            drawsegs_xrange = drawsegs_xranges[2].items;
-            drawsegs_xrange_count = drawsegs_xranges[2].count;
-        }
-        else
-        {
-            drawsegs_xrange = drawsegs_xranges[0].items;
-            drawsegs_xrange_count = drawsegs_xranges[0].count;
-        }
-
         R_DrawSprite(vissprite_ptrs[i]);    // [JN] killough
     }
 
@@ -18,6 +18,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "i_sound.h"
 #include "i_system.h"
@@ -81,12 +82,56 @@ typedef struct
 
     int pitch;
 
+    // [JN] Parameters last handed to the sound module, and the position
+    // of the origin they were calculated for.
+    int volume;
+    int sep;
+    fixed_t x, y, z;
+
 } channel_t;
 
 // The set of channels available
 
 static channel_t *channels;
 
+// [JN] Audible sounds that did not get a voice wait here until one
+// frees up. The sound module can only start a sound from its beginning,
+// so a sound that waited for longer than VIRTUAL_TICS is dropped.
+
+#define MAX_VIRTUAL_CHANNELS 64
+#define VIRTUAL_TICS 4
+
+typedef struct
+{
+    sfxinfo_t *sfxinfo;
+    mobj_t *origin;
+    int pitch;
+    int volume;
+    int starttic;
+} virtual_t;
+
+static virtual_t virtuals[MAX_VIRTUAL_CHANNELS];
+static int numvirtuals;
+
+// [JN] Sound scheduler counters, accumulated over a level.
+
+soundstats_t sound_stats;
+
+// [JN] Sounds started since the last update. In fast-forward mode a
+// whole batch of tics runs between two updates, and repeats of a sound
+// from the same origin within it are merged into the first one.
+
+#define MAX_BATCH_SOUNDS 64
+
+typedef struct
+{
+    const mobj_t *origin;
+    int sfx_id;
+} batchsound_t;
+
+static batchsound_t batchsounds[MAX_BATCH_SOUNDS];
+static int numbatchsounds;
+
 // Maximum volume of a sound effect.
 // Internal default is max out of 0-15.
 
@@ -209,6 +254,8 @@ void S_ChangeSFXSystem (void)
         channels[i].sfxinfo = 0;
     }
 
+    numvirtuals = 0;
+
     // Reinitialize sfx usefulness
     for (i = 1 ; i < NUMSFX ; i++)
     {
@@ -299,6 +346,11 @@ void S_Start(void)
         }
     }
 
+    numvirtuals = 0;
+
+    // [JN] Sound scheduler counters are shown per level.
+    memset(&sound_stats, 0, sizeof(sound_stats));
+
     // start new music for the level
     if (musicVolume) // [crispy] do not reset pause state at zero music volume
     mus_paused = 0;
@@ -386,6 +438,22 @@ void S_Start(void)
     S_ChangeMusic(mnum, true);
 }
 
+// -----------------------------------------------------------------------------
+// S_DropVirtual
+// [JN] Forget the waiting sounds of the given origin.
+// -----------------------------------------------------------------------------
+
+static void S_DropVirtual(const mobj_t *origin)
+{
+    for (int i = 0 ; i < numvirtuals ; i++)
+    {
+        if (virtuals[i].origin == origin)
+        {
+            virtuals[i--] = virtuals[--numvirtuals];
+        }
+    }
+}
+
 void S_StopSound(mobj_t *origin)
 {
     int cnum;
@@ -398,65 +466,85 @@ void S_StopSound(mobj_t *origin)
             break;
         }
     }
+
+    S_DropVirtual(origin);
+}
+
+// -----------------------------------------------------------------------------
+// S_Outranks
+// [JN] True if a sound of the given volume is at least as important as
+//  another one. Lower priority values win, ties go to the louder sound.
+// -----------------------------------------------------------------------------
+
+static inline boolean S_Outranks(const sfxinfo_t *sfx, int volume,
+                                 const sfxinfo_t *other, int othervolume)
+{
+    return other->priority > sfx->priority
+       || (other->priority == sfx->priority && othervolume <= volume);
 }
 
 //
 // S_GetChannel :
 //   If none available, return -1.  Otherwise channel #.
+// [JN] Kills the old sound of the origin, looks for a free channel and
+//  for the least important sound to steal from, all in a single pass.
 //
 
-static int S_GetChannel(mobj_t *origin, sfxinfo_t *sfxinfo)
+static int S_GetChannel(mobj_t *origin, sfxinfo_t *sfxinfo, int volume)
 {
-    // channel number to use
-    int                cnum;
-
-    channel_t*        c;
+    int cnum;
+    int freenum = -1;
+    int victim = -1;
+    boolean killed = false;
 
-    // Find an open channel
-    for (cnum=0 ; cnum<snd_channels ; cnum++)
+    for (cnum = 0 ; cnum < snd_channels ; cnum++)
     {
-        if (!channels[cnum].sfxinfo)
+        const channel_t *const c = &channels[cnum];
+
+        if (!c->sfxinfo)
         {
-            break;
+            if (freenum < 0)
+            {
+                freenum = cnum;
+            }
         }
-        else if (origin && channels[cnum].origin == origin)
+        else if (!killed && c->origin == origin)
         {
+            // kill old sound
             S_StopChannel(cnum);
-            break;
-        }
-    }
+            killed = true;
 
-    // None available
-    if (cnum == snd_channels)
-    {
-        // Look for lower priority
-        for (cnum=0 ; cnum<snd_channels ; cnum++)
-        {
-            if (channels[cnum].sfxinfo->priority >= sfxinfo->priority)
+            if (freenum < 0)
             {
-                break;
+                freenum = cnum;
             }
         }
-
-        if (cnum == snd_channels)
+        else if (victim < 0
+             || !S_Outranks(c->sfxinfo, c->volume,
+                            channels[victim].sfxinfo, channels[victim].volume))
         {
-            // FUCK!  No lower priority.  Sorry, Charlie.
-            return -1;
-        }
-        else
-        {
-            // Otherwise, kick out lower priority.
-            S_StopChannel(cnum);
+            victim = cnum;
         }
     }
 
-    c = &channels[cnum];
+    S_DropVirtual(origin);
 
-    // channel is decided to be cnum.
-    c->sfxinfo = sfxinfo;
-    c->origin = origin;
+    if (freenum < 0)
+    {
+        if (victim < 0 || !S_Outranks(sfxinfo, volume,
+                                      channels[victim].sfxinfo,
+                                      channels[victim].volume))
+        {
+            // No less important sound to kick out.
+            return -1;
+        }
 
-    return cnum;
+        S_StopChannel(victim);
+        sound_stats.stolen++;
+        freenum = victim;
+    }
+
+    return freenum;
 }
 
 // -----------------------------------------------------------------------------
@@ -522,26 +610,6 @@ static int S_AdjustSoundParams(mobj_t *listener, mobj_t *source,
         return 0;
     }
 
-    // angle of source to listener
-    angle = R_PointToAngle2(listener->x,
-                            listener->y,
-                            source->x,
-                            source->y);
-
-    if (angle > listener->angle)
-    {
-        angle = angle - listener->angle;
-    }
-    else
-    {
-        angle = angle + (0xffffffff - listener->angle);
-    }
-
-    angle >>= ANGLETOFINESHIFT;
-
-    // stereo separation
-    *sep = 128 - (FixedMul(stereo_swing, finesine[angle]) >> FRACBITS);
-
     // volume calculation
     if (approx_dist < S_CLOSE_DIST)
     {
@@ -566,7 +634,33 @@ static int S_AdjustSoundParams(mobj_t *listener, mobj_t *source,
             / S_ATTENUATOR;
     }
 
-    return (*vol > 0);
+    // [JN] Don't bother with the angle of a sound that can't be heard.
+    if (*vol <= 0)
+    {
+        return 0;
+    }
+
+    // angle of source to listener
+    angle = R_PointToAngle2(listener->x,
+                            listener->y,
+                            source->x,
+                            source->y);
+
+    if (angle > listener->angle)
+    {
+        angle = angle - listener->angle;
+    }
+    else
+    {
+        angle = angle + (0xffffffff - listener->angle);
+    }
+
+    angle >>= ANGLETOFINESHIFT;
+
+    // stereo separation
+    *sep = 128 - (FixedMul(stereo_swing, finesine[angle]) >> FRACBITS);
+
+    return 1;
 }
 
 // clamp supplied integer to the range 0 <= x <= 255.
@@ -584,11 +678,163 @@ static int Clamp(int x)
     return x;
 }
 
+// -----------------------------------------------------------------------------
+// S_SourceParams
+// [JN] Volume and stereo separation of a sound from the given origin,
+//  as heard by the listener. Returns false if it can't be heard.
+// -----------------------------------------------------------------------------
+
+static boolean S_SourceParams(mobj_t *listener, mobj_t *origin,
+                              const sfxinfo_t *sfx, int *vol, int *sep)
+{
+    *vol = snd_SfxVolume;
+    *sep = NORM_SEP;
+
+    if (sfx->link)
+    {
+        *vol += sfx->volume;
+
+        if (*vol < 1)
+        {
+            return false;
+        }
+
+        if (*vol > snd_SfxVolume)
+        {
+            *vol = snd_SfxVolume;
+        }
+    }
+
+    // Check to see if it is audible,
+    //  and if not, modify the params
+    if (origin && origin != listener && origin != players[displayplayer].so) // [crispy] weapon sound source
+    {
+        if (!S_AdjustSoundParams(listener, origin, vol, sep))
+        {
+            return false;
+        }
+
+        if (origin->x == listener->x && origin->y == listener->y)
+        {
+            *sep = NORM_SEP;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// S_StartChannel
+// [JN] Hand the sound over to the sound module on the given channel.
+// -----------------------------------------------------------------------------
+
+static void S_StartChannel(int cnum, sfxinfo_t *sfx, mobj_t *origin,
+                           int volume, int sep, int pitch)
+{
+    channel_t *const c = &channels[cnum];
+
+    // increase the usefulness
+    if (sfx->usefulness++ < 0)
+    {
+        sfx->usefulness = 1;
+    }
+
+    if (sfx->lumpnum < 0)
+    {
+        sfx->lumpnum = I_GetSfxLumpNum(sfx);
+    }
+
+    c->sfxinfo = sfx;
+    c->origin = origin;
+    c->pitch = pitch;
+    c->volume = volume;
+    c->sep = sep;
+
+    if (origin)
+    {
+        c->x = origin->x;
+        c->y = origin->y;
+        c->z = origin->z;
+    }
+
+    c->handle = I_StartSound(sfx, cnum, volume, sep, pitch);
+}
+
+// -----------------------------------------------------------------------------
+// S_AddVirtual
+// [JN] Let a sound that didn't get a voice wait for one. If all virtual
+//  channels are taken, the least important waiting sound gives way.
+// -----------------------------------------------------------------------------
+
+static void S_AddVirtual(sfxinfo_t *sfx, mobj_t *origin, int volume, int pitch)
+{
+    virtual_t *v;
+
+    if (numvirtuals < MAX_VIRTUAL_CHANNELS)
+    {
+        v = &virtuals[numvirtuals++];
+    }
+    else
+    {
+        v = &virtuals[0];
+
+        for (int i = 1 ; i < numvirtuals ; i++)
+        {
+            if (!S_Outranks(virtuals[i].sfxinfo, virtuals[i].volume,
+                            v->sfxinfo, v->volume))
+            {
+                v = &virtuals[i];
+            }
+        }
+
+        if (!S_Outranks(sfx, volume, v->sfxinfo, v->volume))
+        {
+            sound_stats.culled++;
+            return;
+        }
+
+        sound_stats.dropped++;
+    }
+
+    v->sfxinfo = sfx;
+    v->origin = origin;
+    v->volume = volume;
+    v->pitch = pitch;
+    v->starttic = I_GetTime();
+    sound_stats.virtualized++;
+}
+
+// -----------------------------------------------------------------------------
+// S_MergeBatched
+// [JN] Check if the sound was already started from the same origin in this
+//  fast-forward batch, and remember it if not. Once the batch is full,
+//  further sounds are simply played.
+// -----------------------------------------------------------------------------
+
+static boolean S_MergeBatched(const mobj_t *origin, int sfx_id)
+{
+    for (int i = 0 ; i < numbatchsounds ; i++)
+    {
+        if (batchsounds[i].origin == origin && batchsounds[i].sfx_id == sfx_id)
+        {
+            return true;
+        }
+    }
+
+    if (numbatchsounds < MAX_BATCH_SOUNDS)
+    {
+        batchsounds[numbatchsounds].origin = origin;
+        batchsounds[numbatchsounds].sfx_id = sfx_id;
+        numbatchsounds++;
+    }
+
+    return false;
+}
+
 void S_StartSound(void *origin_p, int sfx_id)
 {
     sfxinfo_t *sfx;
     mobj_t *origin;
-    int rc;
     int sep;
     int pitch;
     int cnum;
@@ -601,7 +847,6 @@ void S_StartSound(void *origin_p, int sfx_id)
     }
 
     origin = (mobj_t *) origin_p;
-    volume = snd_SfxVolume;
 
     // check for bogus sound #
     if (sfx_id < 1 || sfx_id > NUMSFX)
@@ -611,50 +856,22 @@ void S_StartSound(void *origin_p, int sfx_id)
 
     sfx = &S_sfx[sfx_id];
 
-    // Initialize sound parameters
-    pitch = NORM_PITCH;
-    if (sfx->link)
+    if (D_TurboActive() && S_MergeBatched(origin, sfx_id))
     {
-        volume += sfx->volume;
-        pitch = sfx->pitch;
-
-        if (volume < 1)
-        {
-            return;
-        }
-
-        if (volume > snd_SfxVolume)
-        {
-            volume = snd_SfxVolume;
-        }
+        sound_stats.merged++;
+        return;
     }
 
-
-    // Check to see if it is audible,
-    //  and if not, modify the params
-    if (origin && origin != players[displayplayer].mo && origin != players[displayplayer].so) // [crispy] weapon sound source
+    // [JN] Cull inaudible sounds before any channel work is done.
+    if (!S_SourceParams(players[displayplayer].mo, origin, sfx, &volume, &sep))
     {
-        rc = S_AdjustSoundParams(players[displayplayer].mo,
-                                 origin,
-                                 &volume,
-                                 &sep);
-
-        if (origin->x == players[displayplayer].mo->x
-         && origin->y == players[displayplayer].mo->y)
-        {
-            sep = NORM_SEP;
-        }
-
-        if (!rc)
-        {
-            return;
-        }
-    }
-    else
-    {
-        sep = NORM_SEP;
+        sound_stats.culled++;
+        return;
     }
 
+    // Initialize sound parameters
+    pitch = sfx->link ? sfx->pitch : NORM_PITCH;
+
     // hacks to vary the sfx pitches
     if (sfx_id >= sfx_sawup && sfx_id <= sfx_sawhit)
     {
@@ -666,30 +883,18 @@ void S_StartSound(void *origin_p, int sfx_id)
     }
     pitch = Clamp(pitch);
 
-    // kill old sound
-    S_StopSound(origin);
-
-    // try to find a channel
-    cnum = S_GetChannel(origin, sfx);
+    // try to find a channel, killing the old sound of the origin
+    cnum = S_GetChannel(origin, sfx, volume);
 
     if (cnum < 0)
     {
+        // [JN] No voice for now, wait for one.
+        S_AddVirtual(sfx, origin, volume, pitch);
         return;
     }
 
-    // increase the usefulness
-    if (sfx->usefulness++ < 0)
-    {
-        sfx->usefulness = 1;
-    }
-
-    if (sfx->lumpnum < 0)
-    {
-        sfx->lumpnum = I_GetSfxLumpNum(sfx);
-    }
-
-    channels[cnum].pitch = pitch;
-    channels[cnum].handle = I_StartSound(sfx, cnum, volume, sep, channels[cnum].pitch);
+    S_StartChannel(cnum, sfx, origin, volume, sep, pitch);
+    sound_stats.started++;
 }
 
 void S_StartSoundOnce (void *origin_p, int sfx_id)
@@ -706,6 +911,14 @@ void S_StartSoundOnce (void *origin_p, int sfx_id)
         }
     }
 
+    for (int i = 0; i < numvirtuals; i++)
+    {
+        if (virtuals[i].sfxinfo == sfx && virtuals[i].origin == origin_p)
+        {
+            return;
+        }
+    }
+
     S_StartSound(origin_p, sfx_id);
 }
 
@@ -735,71 +948,179 @@ void S_ResumeSound(void)
 // Updates music & sounds
 //
 
+// -----------------------------------------------------------------------------
+// S_ListenerChanged
+// [JN] True if anything that sound parameters depend on has changed
+//  since the last update: the listener, its position, or the settings.
+// -----------------------------------------------------------------------------
+
+static boolean S_ListenerChanged(const mobj_t *listener)
+{
+    static struct
+    {
+        const mobj_t *mo;
+        fixed_t x, y, z;
+        angle_t angle;
+        int volume, swing, zaxis;
+    } last;
+    boolean changed;
+
+    if (!listener)
+    {
+        return true;
+    }
+
+    changed = last.mo != listener
+           || last.x != listener->x || last.y != listener->y
+           || last.z != listener->z || last.angle != listener->angle
+           || last.volume != snd_SfxVolume || last.swing != stereo_swing
+           || last.zaxis != aud_z_axis_sfx;
+
+    last.mo = listener;
+    last.x = listener->x;
+    last.y = listener->y;
+    last.z = listener->z;
+    last.angle = listener->angle;
+    last.volume = snd_SfxVolume;
+    last.swing = stereo_swing;
+    last.zaxis = aud_z_axis_sfx;
+
+    return changed;
+}
+
+// -----------------------------------------------------------------------------
+// S_PromoteVirtuals
+// [JN] Hand free voices over to the most important waiting sounds.
+//  Sounds that waited for too long or went out of hearing are dropped.
+// -----------------------------------------------------------------------------
+
+static void S_PromoteVirtuals(mobj_t *listener)
+{
+    int vol[MAX_VIRTUAL_CHANNELS];
+    int sep[MAX_VIRTUAL_CHANNELS];
+    const int now = I_GetTime();
+
+    for (int i = 0 ; i < numvirtuals ; i++)
+    {
+        virtual_t *const v = &virtuals[i];
+
+        if (now - v->starttic > VIRTUAL_TICS)
+        {
+            sound_stats.dropped++;
+        }
+        else if (!S_SourceParams(listener, v->origin, v->sfxinfo,
+                                 &vol[i], &sep[i]))
+        {
+            sound_stats.culled++;
+        }
+        else
+        {
+            continue;
+        }
+
+        vol[i] = vol[numvirtuals - 1];
+        sep[i] = sep[numvirtuals - 1];
+        virtuals[i--] = virtuals[--numvirtuals];
+    }
+
+    for (int cnum = 0 ; cnum < snd_channels && numvirtuals > 0 ; cnum++)
+    {
+        int best = 0;
+
+        if (channels[cnum].sfxinfo)
+        {
+            continue;
+        }
+
+        for (int i = 1 ; i < numvirtuals ; i++)
+        {
+            if (!S_Outranks(virtuals[best].sfxinfo, vol[best],
+                            virtuals[i].sfxinfo, vol[i]))
+            {
+                best = i;
+            }
+        }
+
+        S_StartChannel(cnum, virtuals[best].sfxinfo, virtuals[best].origin,
+                       vol[best], sep[best], virtuals[best].pitch);
+        sound_stats.started++;
+        sound_stats.promoted++;
+
+        numvirtuals--;
+        virtuals[best] = virtuals[numvirtuals];
+        vol[best] = vol[numvirtuals];
+        sep[best] = sep[numvirtuals];
+    }
+}
+
+//
+// Updates music & sounds
+// [JN] Parameters are only recalculated for sounds whose origin or
+//  listener has moved, and only changed ones are sent to the module.
+//
+
 void S_UpdateSounds(mobj_t *listener)
 {
-    int                audible;
     int                cnum;
     int                volume;
     int                sep;
-    sfxinfo_t*        sfx;
+    boolean            changed;
     channel_t*        c;
 
     I_UpdateSound();
 
+    numbatchsounds = 0;
+
+    changed = S_ListenerChanged(listener);
+
     for (cnum=0; cnum<snd_channels; cnum++)
     {
         c = &channels[cnum];
-        sfx = c->sfxinfo;
 
-        if (c->sfxinfo)
+        if (!c->sfxinfo)
         {
-            if (I_SoundIsPlaying(c->handle))
-            {
-                // initialize parameters
-                volume = snd_SfxVolume;
-                sep = NORM_SEP;
+            continue;
+        }
 
-                if (sfx->link)
-                {
-                    volume += sfx->volume;
-                    if (volume < 1)
-                    {
-                        S_StopChannel(cnum);
-                        continue;
-                    }
-                    else if (volume > snd_SfxVolume)
-                    {
-                        volume = snd_SfxVolume;
-                    }
-                }
+        if (!I_SoundIsPlaying(c->handle))
+        {
+            // if channel is allocated but sound has stopped,
+            //  free it
+            S_StopChannel(cnum);
+            continue;
+        }
 
-                // check non-local sounds for distance clipping
-                //  or modify their params
-                if (c->origin && listener != c->origin && c->origin != players[displayplayer].so) // [crispy] weapon sound source
-                {
-                    audible = S_AdjustSoundParams(listener,
-                                                  c->origin,
-                                                  &volume,
-                                                  &sep);
-
-                    if (!audible)
-                    {
-                        S_StopChannel(cnum);
-                    }
-                    else
-                    {
-                        I_UpdateSoundParams(c->handle, volume, sep);
-                    }
-                }
+        // check non-local sounds for distance clipping
+        //  or modify their params
+        if (c->origin && listener != c->origin && c->origin != players[displayplayer].so) // [crispy] weapon sound source
+        {
+            if (!changed && c->x == c->origin->x
+             && c->y == c->origin->y && c->z == c->origin->z)
+            {
+                continue;
             }
-            else
+
+            c->x = c->origin->x;
+            c->y = c->origin->y;
+            c->z = c->origin->z;
+
+            if (!S_SourceParams(listener, c->origin, c->sfxinfo, &volume, &sep))
             {
-                // if channel is allocated but sound has stopped,
-                //  free it
                 S_StopChannel(cnum);
             }
+            else if (volume != c->volume || sep != c->sep)
+            {
+                c->volume = volume;
+                c->sep = sep;
+                I_UpdateSoundParams(c->handle, volume, sep);
+            }
         }
     }
+
+    if (numvirtuals > 0)
+    {
+        S_PromoteVirtuals(listener);
+    }
 }
 
 void S_SetMusicVolume(int volume)
@@ -950,6 +1271,8 @@ void S_MuteUnmuteSound (boolean mute)
             S_StopChannel(i);
         }
 
+        numvirtuals = 0;
+
         // Set volume variables to zero.
         S_SetMusicVolume(0);
         S_SetSfxVolume(0);
@@ -90,6 +90,20 @@ extern void S_MuteUnmuteSound (boolean mute);
 
 extern int current_mus_num;
 
+// [JN] Sound scheduler counters, accumulated over a level.
+typedef struct
+{
+    int started;      // sounds handed to the sound module
+    int culled;       // sounds dropped as inaudible or least important
+    int stolen;       // playing sounds cut off by more important ones
+    int virtualized;  // sounds that had to wait for a voice
+    int promoted;     // waiting sounds that got a voice
+    int dropped;      // waiting sounds that never got one
+    int merged;       // repeats dropped within a fast-forward batch
+} soundstats_t;
+
+extern soundstats_t sound_stats;
+
 // [JN] jff 3/17/98 holds last IDMUS number, or -1
 extern int idmusnum;
 
@@ -25,6 +25,7 @@
 
 #include "i_swap.h" // [crispy] SHORT()
 #include "i_system.h"
+#include "i_timer.h"
 #include "i_video.h"
 #include "z_zone.h"
 #include "m_controls.h"
@@ -88,6 +89,15 @@
 // graphics are drawn to a backing screen and blitted to the real screen
 static pixel_t *st_backing_screen;
 
+// [JN] Composed status bar with all its elements drawn. It is blitted
+// as a whole for as long as nothing shown on the bar changes.
+static pixel_t *st_layer;
+static boolean  st_layer_valid;
+
+// [JN] Status bar redraws and layer blits, per second.
+int st_redraws, st_blits;
+static int st_redrawcount, st_blitcount, st_countertime;
+
 // main player in game
 static player_t *plyr; 
 
@@ -1870,6 +1880,120 @@ static void ST_DrawElementsDoom64 (int wide_x)
     dp_translucent = false;
 }
 
+// -----------------------------------------------------------------------------
+// ST_LayerChanged
+// [JN] Everything the classic status bar shows. Returns true if any of it
+// differs from what the cached layer was composed with.
+// -----------------------------------------------------------------------------
+
+typedef struct
+{
+    int screenwidth, resolution, wide_x;
+    int screensize, automap;
+    int player, netgame, deathmatch;
+    int ammo, health, armor, frags;
+    int weapons, face;
+    int cards[NUMCARDS];
+    int tryopen[NUMCARDS];
+    int keyorskull[3];
+    int ammos[NUMAMMO];
+    int maxammos[NUMAMMO];
+    const byte *colors[4];
+} st_layerstate_t;
+
+static st_layerstate_t st_layerstate;
+
+static boolean ST_LayerChanged (const int wide_x)
+{
+    const ammotype_t ammotype = weaponinfo[plyr->readyweapon].ammo;
+    const boolean neghealth = st_negative_health && plyr->health <= 0 && !no_sttminus;
+    st_layerstate_t state;
+    boolean changed;
+
+    // Zero the padding too, states are compared as a whole.
+    memset(&state, 0, sizeof(state));
+
+    state.screenwidth = SCREENWIDTH;
+    state.resolution = vid_resolution;
+    state.wide_x = wide_x;
+    state.screensize = dp_screen_size;
+    state.automap = automapactive | (automap_overlay << 1);
+    state.player = displayplayer;
+    state.netgame = netgame;
+    state.deathmatch = deathmatch;
+
+    state.ammo = ammotype == am_noammo ? -1 : plyr->ammo[ammotype];
+    state.health = neghealth ? plyr->health_negative : plyr->health;
+    state.armor = plyr->armorpoints;
+
+    if (deathmatch)
+    {
+        st_fragscount = ST_UpdateFragsCounter(displayplayer, false);
+        state.frags = st_fragscount;
+    }
+
+    for (int i = 0 ; i < NUMWEAPONS ; i++)
+    {
+        state.weapons |= (plyr->weaponowned[i] != 0) << i;
+    }
+
+    state.face = st_faceindex;
+
+    for (int i = 0 ; i < NUMCARDS ; i++)
+    {
+        state.cards[i] = plyr->cards[i];
+        state.tryopen[i] = st_blinking_keys ? plyr->tryopen[i] : 0;
+    }
+
+    for (int i = 0 ; i < 3 ; i++)
+    {
+        state.keyorskull[i] = st_keyorskull[i];
+    }
+
+    for (int i = 0 ; i < NUMAMMO ; i++)
+    {
+        state.ammos[i] = plyr->ammo[i];
+        state.maxammos[i] = plyr->maxammo[i];
+    }
+
+    state.colors[0] = ST_WidgetColor(hudcolor_ammo);
+    state.colors[1] = ST_WidgetColor(hudcolor_health);
+    state.colors[2] = ST_WidgetColor(hudcolor_frags);
+    state.colors[3] = ST_WidgetColor(hudcolor_armor);
+
+    changed = !st_layer_valid || memcmp(&state, &st_layerstate, sizeof(state));
+    memcpy(&st_layerstate, &state, sizeof(state));
+
+    return changed;
+}
+
+// -----------------------------------------------------------------------------
+// ST_CountLayer
+// [JN] Count status bar redraws and blits, latched once a second.
+// -----------------------------------------------------------------------------
+
+static void ST_CountLayer (const boolean redraw)
+{
+    const int now = I_GetTimeMS();
+
+    if (redraw)
+    {
+        st_redrawcount++;
+    }
+    else
+    {
+        st_blitcount++;
+    }
+
+    if (now - st_countertime >= 1000)
+    {
+        st_redraws = st_redrawcount;
+        st_blits = st_blitcount;
+        st_redrawcount = st_blitcount = 0;
+        st_countertime = now;
+    }
+}
+
 // -----------------------------------------------------------------------------
 // ST_Drawer
 // [JN] Main drawing function, totally rewritten.
@@ -1889,6 +2013,21 @@ void ST_Drawer (boolean force)
         // [JN] Always show values of chosen player.
         plyr = &players[displayplayer];
 
+        // [JN] Nothing on the classic bar has changed since it was composed,
+        // so just put the cached layer back over whatever was drawn there.
+        if (st_background_on)
+        {
+            const boolean changed = ST_LayerChanged(wide_x);
+
+            if (!changed && !st_fullupdate)
+            {
+                V_CopyRect(0, 0, st_layer, SCREENWIDTH, ST_HEIGHT * vid_resolution,
+                           0, ST_Y * vid_resolution);
+                ST_CountLayer(false);
+                return;
+            }
+        }
+
         // Status bar background.
         if (st_background_on && st_fullupdate)
         {
@@ -1970,6 +2109,14 @@ void ST_Drawer (boolean force)
         else
         {
             ST_DrawElementsOriginal(wide_x);
+
+            // [JN] Keep the composed bar for the following frames.
+            V_UseBuffer(st_layer);
+            V_CopyRect(0, ST_Y * vid_resolution, I_VideoBuffer,
+                       SCREENWIDTH, ST_HEIGHT * vid_resolution, 0, 0);
+            V_RestoreBuffer();
+            st_layer_valid = true;
+            ST_CountLayer(true);
         }
     }
 }
@@ -2134,6 +2281,8 @@ void ST_Init (void)
     ST_loadData();
     st_backing_screen = (pixel_t *) Z_Malloc(MAXWIDTH * (ST_HEIGHT * MAXHIRES)
                       * sizeof(*st_backing_screen), PU_STATIC, 0);
+    st_layer = (pixel_t *) Z_Malloc(MAXWIDTH * (ST_HEIGHT * MAXHIRES)
+             * sizeof(*st_layer), PU_STATIC, 0);
 }
 
 // -----------------------------------------------------------------------------
@@ -69,5 +69,6 @@ extern cheatseq_t cheat_mypos;
 
 extern int st_palette;
 extern boolean st_fullupdate;
+extern int st_redraws, st_blits;
 
 #endif
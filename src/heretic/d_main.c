@@ -1508,7 +1508,8 @@ void D_DoomMain(void)
 
     finishStartup();
 
-    // [JN] Show startup process time.
+    // [JN] Show lump lookup statistics and startup process time.
+    W_PrintLookupStats();
     printf("Startup process took %d ms.\n", SDL_GetTicks() - starttime);
 
     D_DoomLoop();               // Never returns
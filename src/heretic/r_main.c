@@ -1059,6 +1059,10 @@ void R_RenderPlayerView (player_t *player)
         return;
     }
 
+    // [JN] The whole view window is redrawn. Mark it as damaged, so its
+    // rows are uploaded without being compared to the previous frame.
+    V_MarkRect(viewwindowx, viewwindowy, scaledviewwidth, viewheight);
+
     // check for new console commands.
     NetUpdate ();
 
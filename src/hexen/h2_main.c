@@ -593,7 +593,8 @@ void D_DoomMain(void)
         }
     }
 
-    // [JN] Show startup process time.
+    // [JN] Show lump lookup statistics and startup process time.
+    W_PrintLookupStats();
     printf("Startup process took %d ms.\n", SDL_GetTicks() - starttime);
 
     H2_GameLoop();              // Never returns
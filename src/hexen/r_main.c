@@ -1077,6 +1077,10 @@ void R_RenderPlayerView(player_t * player)
         return;
     }
 
+    // [JN] The whole view window is redrawn. Mark it as damaged, so its
+    // rows are uploaded without being compared to the previous frame.
+    V_MarkRect(viewwindowx, viewwindowy, scaledviewwidth, viewheight);
+
     NetUpdate();                // check for new console commands
     if (!crl_freeze)
     {
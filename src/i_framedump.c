@@ -0,0 +1,613 @@
+//
+// Copyright(C) 2016-2025 Julia Nechaevskaya
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    Offline frame dump: rendered frames and mixed sound effects are
+//    written to files at a fixed virtual frame rate.
+//
+//    The game runs on a virtual clock that moves one frame period per
+//    dumped frame, so the output does not depend on how fast frames
+//    are rendered. Frames are queued to an encoder thread, which does
+//    the color conversion and writes them out.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "i_framedump.h"
+#include "i_swap.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_fixed.h"
+#include "m_misc.h"
+
+#include "id_vars.h"
+
+
+#define DUMPFRAMES   4   // Frames queued for the encoder
+#define DUMPCHANNELS 32  // Sound channels, as many as the SDL sound module
+
+boolean framedump = false;
+
+static FILE *videofile;
+static FILE *audiofile;
+static boolean y4m;
+static int dumpfps;
+static int dumpwidth, dumpheight;
+static int old_uncapped_fps;
+static uint64_t dumpstart;      // Virtual time of the first frame
+static int64_t dumpframes;      // Frames handed to the encoder
+static Uint32 dumprealtime;     // Real time at start, for the summary
+
+// -----------------------------------------------------------------------------
+// Encoder queue
+// -----------------------------------------------------------------------------
+
+typedef struct
+{
+    pixel_t *pixels;
+    size_t   size;
+    int      width;
+    int      height;
+    pixel_t  pane;
+    int      pane_alpha;
+    int      copies;    // Number of frame periods the frame lasts
+} dumpframe_t;
+
+static dumpframe_t dumpqueue[DUMPFRAMES];
+static int queuehead;   // Next slot to fill
+static int queuetail;   // Next slot to encode
+static int queuecount;
+static boolean dumpquit;
+static SDL_Thread *dumpthread;
+static SDL_mutex *dumplock;
+static SDL_cond *dumpcond;
+
+// Converted frame, owned by the encoder.
+static byte *outbuf;
+static size_t outsize;
+
+// -----------------------------------------------------------------------------
+// Offline sound mixing
+// -----------------------------------------------------------------------------
+
+typedef struct
+{
+    const int16_t *samples;
+    int length;     // In stereo samples
+    int pos;
+    int left;
+    int right;
+} dumpchannel_t;
+
+static dumpchannel_t dumpchannels[DUMPCHANNELS];
+static int soundrate;
+static int64_t soundframes;     // Stereo samples written to the WAV file
+static int32_t *mixbuf;
+static int16_t *wavbuf;
+static int mixsize;
+
+// -----------------------------------------------------------------------------
+// I_BlendPane
+//  [JN] Same blending the renderer does with the palette flash pane.
+// -----------------------------------------------------------------------------
+
+static inline void I_BlendPane (const dumpframe_t *frame, const pixel_t pixel,
+                                int *r, int *g, int *b)
+{
+    const int a = frame->pane_alpha;
+
+    *r = (pixel >> 16) & 0xff;
+    *g = (pixel >> 8) & 0xff;
+    *b = pixel & 0xff;
+
+    if (a)
+    {
+        *r = (((frame->pane >> 16) & 0xff) * a + *r * (255 - a) + 127) / 255;
+        *g = (((frame->pane >> 8) & 0xff) * a + *g * (255 - a) + 127) / 255;
+        *b = ((frame->pane & 0xff) * a + *b * (255 - a) + 127) / 255;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// I_EncodeRGBA
+//  [JN] Raw frames, 8 bits per channel in R, G, B, A order.
+// -----------------------------------------------------------------------------
+
+static size_t I_EncodeRGBA (const dumpframe_t *frame)
+{
+    const int area = frame->width * frame->height;
+    byte *out = outbuf;
+
+    for (int i = 0 ; i < area ; i++, out += 4)
+    {
+        int r, g, b;
+
+        I_BlendPane(frame, frame->pixels[i], &r, &g, &b);
+        out[0] = r;
+        out[1] = g;
+        out[2] = b;
+        out[3] = 0xff;
+    }
+
+    return (size_t)area * 4;
+}
+
+// -----------------------------------------------------------------------------
+// I_EncodeY4M
+//  [JN] Full range BT.601 YCbCr with 4:2:0 chroma, the "C420jpeg" format.
+//  Chroma is taken from the average of each 2x2 block.
+// -----------------------------------------------------------------------------
+
+static size_t I_EncodeY4M (const dumpframe_t *frame)
+{
+    const int w = frame->width;
+    const int h = frame->height;
+    const int cw = (w + 1) / 2;
+    const int ch = (h + 1) / 2;
+    byte *const lumas = outbuf;
+    byte *const cbs = lumas + w * h;
+    byte *const crs = cbs + cw * ch;
+
+    for (int cy = 0 ; cy < ch ; cy++)
+    {
+        for (int cx = 0 ; cx < cw ; cx++)
+        {
+            int sr = 0, sg = 0, sb = 0, n = 0;
+
+            for (int y = cy * 2 ; y < cy * 2 + 2 && y < h ; y++)
+            {
+                for (int x = cx * 2 ; x < cx * 2 + 2 && x < w ; x++)
+                {
+                    int r, g, b;
+
+                    I_BlendPane(frame, frame->pixels[y * w + x], &r, &g, &b);
+                    lumas[y * w + x] = (77 * r + 150 * g + 29 * b + 128) >> 8;
+                    sr += r;
+                    sg += g;
+                    sb += b;
+                    n++;
+                }
+            }
+
+            sr /= n;
+            sg /= n;
+            sb /= n;
+            cbs[cy * cw + cx] = BETWEEN(0, 255, 128 + ((-43 * sr - 85 * sg + 128 * sb + 128) >> 8));
+            crs[cy * cw + cx] = BETWEEN(0, 255, 128 + ((128 * sr - 107 * sg - 21 * sb + 128) >> 8));
+        }
+    }
+
+    return (size_t)w * h + 2 * (size_t)cw * ch;
+}
+
+static void I_EncodeFrame (const dumpframe_t *frame)
+{
+    const size_t needed = (size_t)frame->width * frame->height * 4;
+    size_t length;
+
+    if (outsize < needed)
+    {
+        outbuf = I_Realloc(outbuf, needed);
+        outsize = needed;
+    }
+
+    length = y4m ? I_EncodeY4M(frame) : I_EncodeRGBA(frame);
+
+    // Frames that lasted longer than one period are repeated.
+    for (int i = 0 ; i < frame->copies ; i++)
+    {
+        if (y4m)
+        {
+            fputs("FRAME\n", videofile);
+        }
+        fwrite(outbuf, 1, length, videofile);
+    }
+}
+
+static int I_FrameDumpThread (void *unused)
+{
+    SDL_LockMutex(dumplock);
+
+    while (true)
+    {
+        if (queuecount == 0)
+        {
+            if (dumpquit)
+            {
+                break;
+            }
+
+            SDL_CondWait(dumpcond, dumplock);
+            continue;
+        }
+
+        // The main thread doesn't touch queued slots.
+        SDL_UnlockMutex(dumplock);
+        I_EncodeFrame(&dumpqueue[queuetail]);
+        SDL_LockMutex(dumplock);
+
+        queuetail = (queuetail + 1) % DUMPFRAMES;
+        queuecount--;
+        SDL_CondBroadcast(dumpcond);
+    }
+
+    SDL_UnlockMutex(dumplock);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// WAV output
+// -----------------------------------------------------------------------------
+
+static void I_WriteWAVHeader (const uint32_t datasize)
+{
+    byte header[44];
+
+    #define PUT16(p, v) { (p)[0] = (v) & 0xff; (p)[1] = ((v) >> 8) & 0xff; }
+    #define PUT32(p, v) { PUT16(p, v); PUT16((p) + 2, (v) >> 16); }
+
+    memcpy(header, "RIFF", 4);
+    PUT32(header + 4, datasize + 36);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    PUT32(header + 16, 16);             // Format chunk size
+    PUT16(header + 20, 1);              // PCM
+    PUT16(header + 22, 2);              // Channels
+    PUT32(header + 24, soundrate);
+    PUT32(header + 28, soundrate * 4);  // Bytes per second
+    PUT16(header + 32, 4);              // Bytes per sample frame
+    PUT16(header + 34, 16);             // Bits per sample
+    memcpy(header + 36, "data", 4);
+    PUT32(header + 40, datasize);
+
+    #undef PUT16
+    #undef PUT32
+
+    fwrite(header, 1, sizeof(header), audiofile);
+}
+
+// -----------------------------------------------------------------------------
+// I_MixSound
+//  [JN] Mixes the sound effects up to the end of the dumped frames, the
+//  way SDL_mixer does it with panning: every sample scaled by its side's
+//  volume, summed and clipped.
+// -----------------------------------------------------------------------------
+
+static void I_MixSound (void)
+{
+    const int64_t target = dumpframes * soundrate / dumpfps;
+    const int count = (int)(target - soundframes);
+
+    if (audiofile == NULL || count <= 0)
+    {
+        return;
+    }
+
+    if (mixsize < count)
+    {
+        mixbuf = I_Realloc(mixbuf, count * 2 * sizeof(*mixbuf));
+        wavbuf = I_Realloc(wavbuf, count * 2 * sizeof(*wavbuf));
+        mixsize = count;
+    }
+
+    memset(mixbuf, 0, count * 2 * sizeof(*mixbuf));
+
+    for (int c = 0 ; c < DUMPCHANNELS ; c++)
+    {
+        dumpchannel_t *const channel = &dumpchannels[c];
+        const int16_t *src;
+        int n;
+
+        if (channel->samples == NULL || channel->pos >= channel->length)
+        {
+            continue;
+        }
+
+        src = channel->samples + channel->pos * 2;
+        n = MIN(count, channel->length - channel->pos);
+
+        for (int i = 0 ; i < n ; i++)
+        {
+            mixbuf[i * 2] += src[i * 2] * channel->left / 255;
+            mixbuf[i * 2 + 1] += src[i * 2 + 1] * channel->right / 255;
+        }
+
+        channel->pos += n;
+    }
+
+    for (int i = 0 ; i < count * 2 ; i++)
+    {
+        wavbuf[i] = SHORT((int16_t)BETWEEN(-32768, 32767, mixbuf[i]));
+    }
+
+    fwrite(wavbuf, 4, count, audiofile);
+    soundframes = target;
+}
+
+void I_FrameDumpSoundRate (int freq)
+{
+    soundrate = freq;
+}
+
+void I_FrameDumpStartSound (int channel, const int16_t *samples, int length)
+{
+    if (channel >= 0 && channel < DUMPCHANNELS)
+    {
+        dumpchannels[channel].samples = samples;
+        dumpchannels[channel].length = length;
+        dumpchannels[channel].pos = 0;
+    }
+}
+
+void I_FrameDumpSoundParams (int channel, int left, int right)
+{
+    if (channel >= 0 && channel < DUMPCHANNELS)
+    {
+        dumpchannels[channel].left = left;
+        dumpchannels[channel].right = right;
+    }
+}
+
+void I_FrameDumpStopSound (int channel)
+{
+    if (channel >= 0 && channel < DUMPCHANNELS)
+    {
+        dumpchannels[channel].samples = NULL;
+    }
+}
+
+boolean I_FrameDumpSoundPlaying (int channel)
+{
+    return channel >= 0 && channel < DUMPCHANNELS
+        && dumpchannels[channel].samples != NULL
+        && dumpchannels[channel].pos < dumpchannels[channel].length;
+}
+
+// -----------------------------------------------------------------------------
+// I_FrameDumpFrame
+//  [JN] Queues the frame for every frame period that has begun since the
+//  last one, mixes sound up to the same point and moves the virtual clock
+//  to the beginning of the next period. Normally that is exactly one
+//  period, unless the game slept on the clock in between.
+// -----------------------------------------------------------------------------
+
+void I_FrameDumpFrame (const pixel_t *pixels, int width, int height,
+                       pixel_t pane, int pane_alpha)
+{
+    const int64_t period = (I_GetVirtualClock() - dumpstart) * dumpfps / 1000000;
+    const size_t size = (size_t)width * height * sizeof(*pixels);
+    dumpframe_t *frame;
+
+    if (dumpwidth == 0)
+    {
+        dumpwidth = width;
+        dumpheight = height;
+
+        if (y4m)
+        {
+            // Pixels are 5:6 when the image is stretched to 4:3.
+            fprintf(videofile, "YUV4MPEG2 W%d H%d F%d:1 Ip A%s C420jpeg\n",
+                    width, height, dumpfps,
+                    vid_aspect_ratio_correct ? "5:6" : "1:1");
+        }
+    }
+    else if (width != dumpwidth || height != dumpheight)
+    {
+        I_Error("I_FrameDumpFrame: Resolution changed from %dx%d to %dx%d",
+                dumpwidth, dumpheight, width, height);
+    }
+
+    // Wait until the encoder frees a slot.
+    SDL_LockMutex(dumplock);
+    while (queuecount == DUMPFRAMES)
+    {
+        SDL_CondWait(dumpcond, dumplock);
+    }
+    SDL_UnlockMutex(dumplock);
+
+    frame = &dumpqueue[queuehead];
+
+    if (frame->size < size)
+    {
+        frame->pixels = I_Realloc(frame->pixels, size);
+        frame->size = size;
+    }
+
+    memcpy(frame->pixels, pixels, size);
+    frame->width = width;
+    frame->height = height;
+    frame->pane = pane;
+    frame->pane_alpha = pane_alpha;
+    frame->copies = period >= dumpframes ? (int)(period - dumpframes + 1) : 1;
+
+    if (dumpthread)
+    {
+        SDL_LockMutex(dumplock);
+        queuehead = (queuehead + 1) % DUMPFRAMES;
+        queuecount++;
+        SDL_CondBroadcast(dumpcond);
+        SDL_UnlockMutex(dumplock);
+    }
+    else
+    {
+        I_EncodeFrame(frame);
+    }
+
+    dumpframes += frame->copies;
+    I_MixSound();
+
+    I_SetVirtualClock(dumpstart + (dumpframes * 1000000 + dumpfps - 1) / dumpfps);
+}
+
+// -----------------------------------------------------------------------------
+// I_FinishFrameDump
+//  [JN] Writes out the queued frames and completes the WAV header.
+// -----------------------------------------------------------------------------
+
+static void I_FinishFrameDump (void)
+{
+    const Uint32 realtime = SDL_GetTicks() - dumprealtime;
+
+    if (dumpthread)
+    {
+        SDL_LockMutex(dumplock);
+        dumpquit = true;
+        SDL_CondBroadcast(dumpcond);
+        SDL_UnlockMutex(dumplock);
+
+        SDL_WaitThread(dumpthread, NULL);
+        dumpthread = NULL;
+    }
+
+    fclose(videofile);
+
+    if (audiofile)
+    {
+        // Not possible for pipes, which keep the placeholder sizes.
+        if (fseek(audiofile, 0, SEEK_SET) == 0)
+        {
+            I_WriteWAVHeader((uint32_t)(soundframes * 4));
+        }
+
+        fclose(audiofile);
+    }
+
+    vid_uncapped_fps = old_uncapped_fps;
+    framedump = false;
+
+    printf("I_FinishFrameDump: %d frames, %.1f seconds dumped in %.1f seconds\n",
+           (int)dumpframes, (double)dumpframes / dumpfps, realtime / 1000.0);
+}
+
+void I_InitFrameDump (void)
+{
+    char *wavname = NULL;
+    int p;
+
+    //!
+    // @category video
+    // @arg <file>
+    //
+    // Don't present frames or follow real time, write every frame to the
+    // given file instead: as YUV4MPEG2 if its name ends in .y4m, as raw
+    // RGBA otherwise. Sound effects are mixed into a WAV file with the
+    // same name. Named pipes work as well.
+    //
+
+    p = M_CheckParmWithArgs("-framedump", 1);
+
+    if (!p)
+    {
+        return;
+    }
+
+    y4m = strlen(myargv[p + 1]) > 4
+       && !strcasecmp(myargv[p + 1] + strlen(myargv[p + 1]) - 4, ".y4m");
+
+    videofile = M_fopen(myargv[p + 1], "wb");
+
+    if (videofile == NULL)
+    {
+        I_Error("I_InitFrameDump: Couldn't open %s", myargv[p + 1]);
+    }
+
+    // Name of the WAV file: the same, with the extension replaced.
+    {
+        char *name = M_StringDuplicate(myargv[p + 1]);
+        const char *dir = strrchr(name, DIR_SEPARATOR);
+        char *ext = strrchr(name, '.');
+
+        if (ext && (dir == NULL || ext > dir))
+        {
+            *ext = '\0';
+        }
+
+        wavname = M_StringJoin(name, ".wav", NULL);
+        free(name);
+    }
+
+    //!
+    // @category video
+    // @arg <file>
+    //
+    // Write the sound effects of -framedump to the given WAV file.
+    //
+
+    p = M_CheckParmWithArgs("-dumpwav", 1);
+
+    if (p)
+    {
+        free(wavname);
+        wavname = M_StringDuplicate(myargv[p + 1]);
+    }
+
+    //!
+    // @category video
+    // @arg <n>
+    //
+    // Frame rate of -framedump, 35 by default. Other rates use uncapped
+    // frame rate interpolation.
+    //
+
+    dumpfps = TICRATE;
+    p = M_CheckParmWithArgs("-dumpfps", 1);
+
+    if (p)
+    {
+        dumpfps = BETWEEN(1, 1000, atoi(myargv[p + 1]));
+    }
+
+    // The sound module reports its rate once it has started.
+    if (soundrate > 0)
+    {
+        audiofile = M_fopen(wavname, "wb");
+
+        if (audiofile)
+        {
+            I_WriteWAVHeader(UINT32_MAX - 36);
+        }
+        else
+        {
+            fprintf(stderr, "I_InitFrameDump: Couldn't open %s\n", wavname);
+        }
+    }
+
+    free(wavname);
+
+    // Restored at exit, before the configuration is saved.
+    old_uncapped_fps = vid_uncapped_fps;
+    vid_uncapped_fps = (dumpfps != TICRATE);
+
+    dumplock = SDL_CreateMutex();
+    dumpcond = SDL_CreateCond();
+
+    if (dumplock && dumpcond)
+    {
+        dumpthread = SDL_CreateThread(I_FrameDumpThread, "I_FrameDump", NULL);
+    }
+
+    I_AtExit(I_FinishFrameDump, true);
+
+    dumprealtime = SDL_GetTicks();
+    dumpstart = I_StartVirtualClock();
+    framedump = true;
+
+    printf("I_InitFrameDump: Dumping frames at %d fps%s\n", dumpfps,
+           audiofile ? ", with sound" : "");
+}
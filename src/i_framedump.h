@@ -0,0 +1,48 @@
+//
+// Copyright(C) 2016-2025 Julia Nechaevskaya
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    Offline frame dump: rendered frames and mixed sound effects are
+//    written to files at a fixed virtual frame rate.
+//
+
+
+#ifndef __I_FRAMEDUMP__
+#define __I_FRAMEDUMP__
+
+#include "doomtype.h"
+
+// True while frames are dumped instead of being presented.
+
+extern boolean framedump;
+
+// Check the command line for -framedump and start dumping if given.
+
+void I_InitFrameDump(void);
+
+// Hand over the finished frame, with the palette flash pane blended
+// on top of it by pane_alpha.
+
+void I_FrameDumpFrame(const pixel_t *pixels, int width, int height,
+                      pixel_t pane, int pane_alpha);
+
+// Offline sound effects mixing, fed by the SDL sound module. Samples
+// are 16-bit stereo at the given rate, volumes range from 0 to 255.
+
+void I_FrameDumpSoundRate(int freq);
+void I_FrameDumpStartSound(int channel, const int16_t *samples, int length);
+void I_FrameDumpSoundParams(int channel, int left, int right);
+void I_FrameDumpStopSound(int channel);
+boolean I_FrameDumpSoundPlaying(int channel);
+
+#endif
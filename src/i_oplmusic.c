@@ -1845,15 +1845,28 @@ void I_OPL_DevMessages(char *result, size_t result_len)
     int instr_num;
     int lines;
     int i;
+    opl_stats_t stats;
+
+    OPL_GetStats(&stats);
+
+    M_snprintf(result, result_len,
+               "Queue: %u/%u peak, %u waits, %u drops\n"
+               "Lock: %u us wait, %u us max, %u defers\n\n",
+               stats.queue_peak, stats.queue_size,
+               stats.queue_waits, stats.queue_drops,
+               (unsigned int) stats.lock_wait_us,
+               (unsigned int) stats.lock_max_us,
+               stats.callback_defers);
+    lines = 3;
 
     if (num_tracks == 0)
     {
-        M_snprintf(result, result_len, "No OPL track!");
+        M_StringConcat(result, "No OPL track!", result_len);
         return;
     }
 
-    M_snprintf(result, result_len, "Tracks:\n");
-    lines = 1;
+    M_StringConcat(result, "Tracks:\n", result_len);
+    lines += 1;
 
     for (i = 0; i < NumActiveChannels(); ++i)
     {
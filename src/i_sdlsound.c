@@ -32,6 +32,7 @@
 #endif
 
 #include "deh_str.h"
+#include "i_framedump.h"
 #include "i_sound.h"
 #include "i_system.h"
 #include "i_swap.h"
@@ -353,6 +354,7 @@ static void ReleaseSoundOnChannel(int channel)
     allocated_sound_t *snd = channels_playing[channel];
 
     Mix_HaltChannel(channel);
+    I_FrameDumpStopSound(channel);
 
     if (snd == NULL)
     {
@@ -971,6 +973,12 @@ static void I_SDL_UpdateSoundParams(int handle, int vol, int sep)
     if (right < 0) right = 0;
     else if (right > 255) right = 255;
 
+    if (framedump)
+    {
+        I_FrameDumpSoundParams(handle, left, right);
+        return;
+    }
+
     Mix_SetPanning(handle, left, right);
 }
 
@@ -1039,8 +1047,17 @@ static int I_SDL_StartSound(sfxinfo_t *sfxinfo, int channel, int vol, int sep, i
     }
 
     // play sound
+    // [JN] Frame dumps mix sound offline instead.
 
-    Mix_PlayChannel(channel, &snd->chunk, 0);
+    if (framedump)
+    {
+        I_FrameDumpStartSound(channel, (const int16_t *) snd->chunk.abuf,
+                              snd->chunk.alen / 4);
+    }
+    else
+    {
+        Mix_PlayChannel(channel, &snd->chunk, 0);
+    }
 
     channels_playing[channel] = snd;
 
@@ -1072,6 +1089,11 @@ static boolean I_SDL_SoundIsPlaying(int handle)
         return false;
     }
 
+    if (framedump)
+    {
+        return I_FrameDumpSoundPlaying(handle);
+    }
+
     return Mix_Playing(handle);
 }
 
@@ -1164,6 +1186,7 @@ static boolean I_SDL_InitSound(GameMission_t mission)
     ExpandSoundData = ExpandSoundData_SDL;
 
     Mix_QuerySpec(&mixer_freq, &mixer_format, &mixer_channels);
+    I_FrameDumpSoundRate(mixer_freq);
 
 #ifdef HAVE_LIBSAMPLERATE
     if (use_libsamplerate != 0)
@@ -32,10 +32,21 @@ static Uint32 basetime = 0;
 static uint64_t basecounter = 0; // [crispy]
 static uint64_t basefreq = 0; // [crispy]
 
+// [JN] Virtual clock, in microseconds since basetime. Once started, it
+// replaces real time and only moves when it is set or slept on.
+static boolean virtualclock = false;
+static uint64_t virtualtime = 0;
+static int64_t virtualdelta = 0; // I_GetTimeUS() minus virtualtime
+
 int  I_GetTime (void)
 {
     Uint32 ticks;
 
+    if (virtualclock)
+    {
+        return virtualtime * TICRATE / 1000000;
+    }
+
     ticks = SDL_GetTicks();
 
     if (basetime == 0)
@@ -54,6 +65,11 @@ int I_GetTimeMS(void)
 {
     Uint32 ticks;
 
+    if (virtualclock)
+    {
+        return virtualtime / 1000;
+    }
+
     ticks = SDL_GetTicks();
 
     if (basetime == 0)
@@ -68,11 +84,20 @@ uint64_t I_GetTimeUS(void)
 {
     uint64_t counter;
 
+    if (virtualclock)
+    {
+        return virtualtime + virtualdelta;
+    }
+
     counter = SDL_GetPerformanceCounter();
 
     if (basecounter == 0)
         basecounter = counter;
 
+    // [JN] May be called before I_InitTimer, e.g. by WAD lookups.
+    if (basefreq == 0)
+        basefreq = SDL_GetPerformanceFrequency();
+
     return ((counter - basecounter) * 1000000ull) / basefreq;
 }
 
@@ -80,6 +105,12 @@ uint64_t I_GetTimeUS(void)
 
 void I_Sleep(int ms)
 {
+    if (virtualclock)
+    {
+        virtualtime += ms * 1000;
+        return;
+    }
+
     SDL_Delay(ms);
 }
 
@@ -104,5 +135,39 @@ void I_InitTimer(void)
 
 fixed_t I_GetFracRealTime(void)
 {
+    if (virtualclock)
+    {
+        return virtualtime * TICRATE % 1000000 * FRACUNIT / 1000000;
+    }
+
     return (int64_t)I_GetTimeMS() * TICRATE % 1000 * FRACUNIT / 1000;
 }
+
+// -----------------------------------------------------------------------------
+// I_StartVirtualClock
+//  [JN] Detaches all timer functions from real time. The clock starts at
+//  the beginning of the next tic and returns that time, in microseconds.
+// -----------------------------------------------------------------------------
+
+uint64_t I_StartVirtualClock(void)
+{
+    const uint64_t realus = I_GetTimeUS();
+    const uint64_t tic = I_GetTime() + 1;
+
+    // Round up, so that I_GetTime() at this time is exactly the next tic.
+    virtualtime = (tic * 1000000 + TICRATE - 1) / TICRATE;
+    virtualdelta = (int64_t)realus - (int64_t)virtualtime;
+    virtualclock = true;
+
+    return virtualtime;
+}
+
+uint64_t I_GetVirtualClock(void)
+{
+    return virtualtime;
+}
+
+void I_SetVirtualClock(uint64_t us)
+{
+    virtualtime = us;
+}
@@ -46,5 +46,10 @@ void I_WaitVBL(int count);
 
 // [crispy]
 fixed_t I_GetFracRealTime(void);
+
+// [JN] Virtual clock, in microseconds, replacing real time once started.
+uint64_t I_StartVirtualClock(void);
+uint64_t I_GetVirtualClock(void);
+void I_SetVirtualClock(uint64_t us);
 #endif
 
@@ -35,12 +35,14 @@
 #include "d_loop.h"
 #include "deh_str.h"
 #include "doomtype.h"
+#include "i_framedump.h"
 #include "i_input.h"
 #include "i_joystick.h"
 #include "i_system.h"
 #include "i_timer.h"
 #include "i_video.h"
 #include "m_argv.h"
+#include "m_bbox.h"
 #include "m_config.h"
 #include "m_misc.h"
 #include "tables.h"
@@ -90,6 +92,31 @@ SDL_Surface *argbbuffer = NULL;
 static SDL_Texture *texture = NULL;
 static SDL_Texture *texture_upscaled = NULL;
 
+// [JN] Streaming texture upload.
+//
+// With the software renderer, locked texture pixels are the texture's own
+// surface and stay valid between locks. In that case the texture is kept
+// locked while the game draws and argbbuffer merely wraps its pixels, so
+// nothing has to be copied on present.
+//
+// Other renderers only give out a write-only staging area on lock, so
+// argbbuffer stays in system memory and only rows that changed since the
+// previous present are uploaded. Rows inside the V_MarkRect dirty box,
+// such as the view window, are known to have changed. Only the rest,
+// where drawing is not tracked, are compared by per-row hash.
+
+static boolean texture_direct;
+static boolean nolocktexture;
+static uint64_t *row_hashes;
+static int row_hashes_size;
+static boolean row_hashes_valid;
+
+// Gap (in rows) up to which two dirty row runs are uploaded as one.
+#define UPLOAD_MERGE_GAP 16
+
+// Bytes uploaded to the texture by the last I_FinishUpdate.
+int id_upload_bytes;
+
 
 // palette
 
@@ -103,6 +130,9 @@ static SDL_Texture *bluepane = NULL;
 static SDL_Texture *graypane = NULL;
 static SDL_Texture *orngpane = NULL;
 static int pane_alpha;
+// [JN] Pane colors, for frame dumps, which blend them themselves.
+static SDL_Texture *pane_textures[7];
+static pixel_t pane_colors[7];
 static boolean palette_to_set;
 // [JN] Smooth palette.
 int    red_pane_alpha, yel_pane_alpha, grn_pane_alpha;
@@ -624,6 +654,12 @@ void I_GetEvent(void)
                 }
                 break;
 
+            // [JN] Texture contents are lost, upload the whole frame.
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                row_hashes_valid = false;
+                break;
+
             default:
                 break;
         }
@@ -861,10 +897,181 @@ static void CreateUpscaledTexture(boolean force)
     }
 }
 
+// -----------------------------------------------------------------------------
+// [JN] Streaming texture upload, see the comment at texture_direct.
+// -----------------------------------------------------------------------------
+
+// Releases the locked texture before it (or argbbuffer) is destroyed.
+// argbbuffer becomes NULL and has to be recreated by the caller.
+
+static void ReleaseTextureBuffer (void)
+{
+    if (texture_direct)
+    {
+        SDL_UnlockTexture(texture);
+        SDL_FreeSurface(argbbuffer);
+        argbbuffer = NULL;
+        texture_direct = false;
+    }
+}
+
+// Called whenever the texture has been (re)created. If the renderer
+// allows it, moves argbbuffer into the locked texture pixels.
+// Requires SDL 2.0.18, older versions recreate the texture on vsync
+// toggle, which would pull the buffer from under the renderer.
+
+static void SetupTextureBuffer (void)
+{
+    row_hashes_valid = false;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    {
+        SDL_RendererInfo info;
+        SDL_Surface *surface;
+        void *pixels;
+        int pitch;
+
+        if (nolocktexture || texture_direct
+        ||  SDL_GetRendererInfo(renderer, &info) != 0
+        ||  !(info.flags & SDL_RENDERER_SOFTWARE))
+        {
+            return;
+        }
+
+        if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0)
+        {
+            return;
+        }
+
+        surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels, SCREENWIDTH, SCREENHEIGHT,
+                                                     32, pitch, SDL_PIXELFORMAT_ARGB8888);
+
+        if (surface == NULL || pitch != SCREENWIDTH * (int)sizeof(pixel_t))
+        {
+            SDL_FreeSurface(surface);
+            SDL_UnlockTexture(texture);
+            return;
+        }
+
+        memcpy(pixels, argbbuffer->pixels, SCREENAREA * sizeof(pixel_t));
+        SDL_FreeSurface(argbbuffer);
+        argbbuffer = surface;
+        texture_direct = true;
+    }
+#endif
+}
+
+static inline uint64_t HashRow (const byte *row, int bytes)
+{
+    uint64_t a = 0x9e3779b97f4a7c15ull;
+    uint64_t b = 0xc2b2ae3d27d4eb4full;
+
+    // Two independent lanes, 16 bytes per step (rows are a multiple
+    // of 4 pixels wide).
+    for (int i = 0; i < bytes; i += 16)
+    {
+        uint64_t w0, w1;
+
+        memcpy(&w0, row + i, sizeof(w0));
+        memcpy(&w1, row + i + 8, sizeof(w1));
+        a = (a ^ w0) * 0xff51afd7ed558ccdull;
+        b = (b ^ w1) * 0xc4ceb9fe1a85ec53ull;
+        a = (a << 29) | (a >> 35);
+        b = (b << 29) | (b >> 35);
+    }
+
+    return a ^ (b * 0x9e3779b97f4a7c15ull);
+}
+
+static void UploadRows (int first, int last)
+{
+    const SDL_Rect rect = { 0, first, SCREENWIDTH, last - first + 1 };
+
+    SDL_UpdateTexture(texture, &rect,
+                      (const byte *) argbbuffer->pixels + first * argbbuffer->pitch,
+                      argbbuffer->pitch);
+    id_upload_bytes += rect.h * SCREENWIDTH * sizeof(pixel_t);
+}
+
+// Uploads rows of argbbuffer that changed since the last upload,
+// merging runs that are close together.
+
+static void UploadDirtyRows (void)
+{
+    const byte *const pixels = argbbuffer->pixels;
+    const int pitch = argbbuffer->pitch;
+    const int rowbytes = SCREENWIDTH * sizeof(pixel_t);
+    const int marktop = MAX(dirtybox[BOXBOTTOM], 0);
+    const int markbottom = MIN(dirtybox[BOXTOP], SCREENHEIGHT - 1);
+    int first = -1, last = -1;
+
+    id_upload_bytes = 0;
+
+    if (row_hashes_size != SCREENHEIGHT)
+    {
+        row_hashes = I_Realloc(row_hashes, SCREENHEIGHT * sizeof(*row_hashes));
+        row_hashes_size = SCREENHEIGHT;
+        row_hashes_valid = false;
+    }
+
+    for (int y = 0; y < SCREENHEIGHT; y++)
+    {
+        if (y >= marktop && y <= markbottom)
+        {
+            // Marked as damaged, hash it next time it is not.
+            row_hashes[y] = 0;
+        }
+        else
+        {
+            const uint64_t hash = HashRow(pixels + y * pitch, rowbytes);
+
+            if (row_hashes_valid && row_hashes[y] == hash)
+            {
+                continue;
+            }
+
+            row_hashes[y] = hash;
+        }
+
+        if (first >= 0 && y - last > UPLOAD_MERGE_GAP)
+        {
+            UploadRows(first, last);
+            first = -1;
+        }
+        if (first < 0)
+        {
+            first = y;
+        }
+        last = y;
+    }
+
+    if (first >= 0)
+    {
+        UploadRows(first, last);
+    }
+
+    row_hashes_valid = true;
+}
+
 // [AM] Fractional part of the current tic, in the half-open
 //      range of [0.0, 1.0).  Used for interpolation.
 fixed_t fractionaltic;
 
+// [JN] Color of the current palette pane, zero if there is none.
+
+static pixel_t CurrentPaneColor (void)
+{
+    for (int i = 0; i < arrlen(pane_textures); i++)
+    {
+        if (curpane != NULL && pane_textures[i] == curpane)
+        {
+            return pane_colors[i];
+        }
+    }
+
+    return 0;
+}
+
 //
 // I_FinishUpdate
 //
@@ -877,6 +1084,18 @@ void I_FinishUpdate (void)
     if (!initialized)
         return;
 
+    // [JN] Frame dump mode: the frame goes to the dump, the window is
+    // hidden and never presented to.
+    if (framedump)
+    {
+        if (vid_diskicon && diskicon_enabled)
+        V_DrawDiskIcon();
+
+        I_FrameDumpFrame(I_VideoBuffer, SCREENWIDTH, SCREENHEIGHT,
+                         CurrentPaneColor(), curpane ? pane_alpha : 0);
+        return;
+    }
+
     if (noblit)
         return;
 
@@ -942,7 +1161,19 @@ void I_FinishUpdate (void)
     if (vid_diskicon && diskicon_enabled)
     V_DrawDiskIcon();
 
-    SDL_UpdateTexture(texture, NULL, argbbuffer->pixels, argbbuffer->pitch);
+    // [JN] Either the game has drawn straight into the texture,
+    // or upload the rows that have changed.
+    if (texture_direct)
+    {
+        SDL_UnlockTexture(texture);
+        id_upload_bytes = 0;
+    }
+    else
+    {
+        UploadDirtyRows();
+    }
+
+    M_ClearBox(dirtybox);
 
     // Make sure the pillarboxes are kept clear each frame.
 
@@ -977,6 +1208,20 @@ void I_FinishUpdate (void)
 
     SDL_RenderPresent(renderer);
 
+    // [JN] Lock the texture again for drawing the next frame.
+    // The software renderer always hands out the same pixels.
+    if (texture_direct)
+    {
+        void *pixels;
+        int pitch;
+
+        if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0
+        ||  pixels != argbbuffer->pixels)
+        {
+            I_Error("I_FinishUpdate: streaming texture pixels have moved");
+        }
+    }
+
     if (vid_uncapped_fps && !singletics)
     {
         // Limit framerate
@@ -1230,6 +1475,18 @@ void I_GraphicsCheckCommandLine(void)
 
     noblit = M_CheckParm ("-noblit");
 
+    //!
+    // @category video
+    //
+    // Don't draw straight into the locked screen texture when using
+    // the software renderer, copy the frame to it on every update.
+    //
+
+    nolocktexture = M_ParmExists("-nolocktexture");
+
+    // [JN] Offline frame dump, see i_framedump.c for its parameters.
+    I_InitFrameDump();
+
     //!
     // @category video 
     //
@@ -1517,6 +1774,8 @@ void I_SetColorPanes (boolean recreate_argbbuffer)
 
         // [PN] Create texture from surface
         *(panes[i].texture) = SDL_CreateTextureFromSurface(renderer, argbbuffer);
+        pane_textures[i] = *(panes[i].texture);
+        pane_colors[i] = I_MapRGB(r, g, b);
 
         // [PN] Set blend mode
         SDL_SetTextureBlendMode(*(panes[i].texture), SDL_BLENDMODE_BLEND);
@@ -1541,6 +1800,12 @@ static void SetVideoMode(void)
     // retina displays, especially when using small window sizes.
     window_flags |= SDL_WINDOW_ALLOW_HIGHDPI;
 
+    // [JN] Frame dumps are rendered offscreen.
+    if (framedump)
+    {
+        window_flags |= SDL_WINDOW_HIDDEN;
+    }
+
     // [JN] Choose render driver to use.
     SDL_SetHint(SDL_HINT_RENDER_DRIVER, vid_screen_scaler_api);
 
@@ -1722,6 +1987,8 @@ static void SetVideoMode(void)
                                 SDL_TEXTUREACCESS_STREAMING,
                                 SCREENWIDTH, SCREENHEIGHT);
 
+    SetupTextureBuffer();
+
     // [JN] Workaround for SDL 2.0.14+ alt-tab bug
 #if defined(_WIN32)
     SDL_SetHintWithPriority(SDL_HINT_VIDEO_MINIMIZE_ON_FOCUS_LOSS, "1", SDL_HINT_OVERRIDE);
@@ -1927,6 +2194,7 @@ void I_ReInitGraphics (int reinit)
 		// [crispy] re-initialize resolution-agnostic patch drawing
 		V_Init();
 
+		ReleaseTextureBuffer();
 		SDL_FreeSurface(argbbuffer);
 		argbbuffer = SDL_CreateRGBSurfaceWithFormat(
 			0, SCREENWIDTH, SCREENHEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
@@ -1974,6 +2242,11 @@ void I_ReInitGraphics (int reinit)
 		                            SDL_TEXTUREACCESS_STREAMING,
 		                            SCREENWIDTH, SCREENHEIGHT);
 
+		// [JN] Possibly move the frame buffer into the new texture.
+		SetupTextureBuffer();
+		I_VideoBuffer = argbbuffer->pixels;
+		V_RestoreBuffer();
+
 		// [crispy] force its re-creation
 		CreateUpscaledTexture(true);
 	}
@@ -2012,7 +2285,7 @@ void I_ReInitGraphics (int reinit)
 
 // [crispy] take screenshot of the rendered image
 
-void I_RenderReadPixels (byte **data, int *w, int *h)
+void I_RenderReadPixels (byte **data, size_t *size, int *w, int *h)
 {
 	SDL_Rect rect;
 	SDL_PixelFormat *format;
@@ -2064,10 +2337,15 @@ void I_RenderReadPixels (byte **data, int *w, int *h)
     }
 
     // [crispy] allocate memory for screenshot image
-    pixels = malloc(rect.h * temp);
+    // [JN] Reuse the caller's buffer when it is big enough.
+    if (*data == NULL || *size < (size_t)rect.h * temp)
+    {
+        *size = (size_t)rect.h * temp;
+        *data = I_Realloc(*data, *size);
+    }
+    pixels = *data;
     SDL_RenderReadPixels(renderer, &rect, format->format, pixels, temp);
 
-    *data = pixels;
     *w = rect.w;
     *h = rect.h;
 
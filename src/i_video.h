@@ -92,7 +92,9 @@ void I_GraphicsCheckCommandLine(void);
 
 void I_ShutdownGraphics(void);
 
-void I_RenderReadPixels (byte **data, int *w, int *h);
+// Read back the presented image as RGBA into *data, which is grown
+// with I_Realloc when *size is too small for it.
+void I_RenderReadPixels (byte **data, size_t *size, int *w, int *h);
 
 // Takes full 8 bit values.
 void I_SetPalette (int palette);
@@ -170,6 +172,7 @@ extern int vid_integer_scaling;
 extern int vid_vga_porch_flash;
 extern int vid_force_software_renderer;
 extern int id_fps_value;
+extern int id_upload_bytes;
 extern int demowarp;
 
 // [JN] Smooth palette.
@@ -49,6 +49,7 @@ int vid_diskicon = 1;
 int vid_endoom = 0;
 int vid_graphical_startup = 0;
 int vid_banners = 1;
+int vid_screenshot_fast = 1;
 // Post-processing
 int post_supersample = 0;
 int post_overglow = 0;
@@ -258,6 +259,7 @@ void ID_BindVariables (GameMission_t mission)
     {
         M_BindIntVariable("vid_banners",                &vid_banners);
     }  
+    M_BindIntVariable("vid_screenshot_fast",            &vid_screenshot_fast);
     // Post-processing
     M_BindIntVariable("post_supersample",               &post_supersample);
     M_BindIntVariable("post_overglow",                  &post_overglow);
@@ -187,6 +187,7 @@ static default_t	doom_defaults_list[] =
     CONFIG_VARIABLE_INT(vid_endoom),
     CONFIG_VARIABLE_INT(vid_graphical_startup),    
     CONFIG_VARIABLE_INT(vid_banners),
+    CONFIG_VARIABLE_INT(vid_screenshot_fast),
     CONFIG_VARIABLE_INT(post_supersample),
     CONFIG_VARIABLE_INT(post_overglow),
     CONFIG_VARIABLE_INT(post_bloom),
@@ -170,6 +170,14 @@ sha1_digest_t net_local_deh_sha1sum;
 
 unsigned int net_local_is_freedoom;
 
+// [JN] State hashes received from other clients, waiting for the game
+// to compare them against its own.
+
+#define STATEHASH_QUEUE 64
+
+static net_statehash_t statehash_queue[STATEHASH_QUEUE];
+static unsigned int statehash_head, statehash_tail;
+
 #define NET_CL_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
 
 // Called when we become disconnected from the server
@@ -927,6 +935,82 @@ static void NET_CL_ParseConsoleMessage(net_packet_t *packet)
     printf("Message from server:\n%s\n", msg);
 }
 
+// [JN] State hashes of another client, relayed by the server
+
+static void NET_CL_ParseStateHash(net_packet_t *packet)
+{
+    net_statehash_t *hash;
+
+    if (client_state != CLIENT_STATE_IN_GAME)
+    {
+        return;
+    }
+
+    if (statehash_tail - statehash_head >= STATEHASH_QUEUE)
+    {
+        NET_Log("client: state hash queue full, dropping oldest");
+        ++statehash_head;
+    }
+
+    hash = &statehash_queue[statehash_tail % STATEHASH_QUEUE];
+
+    if (!NET_ReadStateHash(packet, hash))
+    {
+        NET_Log("client: error: failed to read state hash");
+        return;
+    }
+
+    ++statehash_tail;
+}
+
+// [JN] True if the server relays state hashes between clients.
+
+boolean NET_CL_StateHashEnabled(void)
+{
+    return net_client_connected
+        && client_connection.protocol >= NET_PROTOCOL_INTERNATIONAL_DOOM_0;
+}
+
+void NET_CL_SendStateHash(net_statehash_t *hash)
+{
+    net_packet_t *packet;
+
+    if (!NET_CL_StateHashEnabled() || drone)
+    {
+        return;
+    }
+
+    if (hash->kind == NET_STATEHASH_TIC)
+    {
+        packet = NET_NewPacket(64);
+        NET_WriteInt16(packet, NET_PACKET_TYPE_STATEHASH);
+        NET_WriteStateHash(packet, hash);
+        NET_Conn_SendPacket(&client_connection, packet);
+        NET_FreePacket(packet);
+    }
+    else
+    {
+        packet = NET_Conn_NewReliable(&client_connection,
+                                      NET_PACKET_TYPE_STATEHASH);
+        NET_WriteStateHash(packet, hash);
+    }
+}
+
+// Returns false when no more state hashes are waiting.
+
+boolean NET_CL_GetStateHash(net_statehash_t *hash)
+{
+    if (statehash_head == statehash_tail)
+    {
+        return false;
+    }
+
+    *hash = statehash_queue[statehash_head % STATEHASH_QUEUE];
+    ++statehash_head;
+
+    return true;
+}
+
 // parse a received packet
 
 static void NET_CL_ParsePacket(net_packet_t *packet)
@@ -982,6 +1066,10 @@ static void NET_CL_ParsePacket(net_packet_t *packet)
                 NET_CL_ParseConsoleMessage(packet);
                 break;
 
+            case NET_PACKET_TYPE_STATEHASH:
+                NET_CL_ParseStateHash(packet);
+                break;
+
             default:
                 break;
         }
@@ -31,6 +31,9 @@ void NET_CL_LaunchGame(void);
 void NET_CL_StartGame(net_gamesettings_t *settings);
 void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic);
 boolean NET_CL_GetSettings(net_gamesettings_t *_settings);
+boolean NET_CL_StateHashEnabled(void);
+void NET_CL_SendStateHash(net_statehash_t *hash);
+boolean NET_CL_GetStateHash(net_statehash_t *hash);
 void NET_Init(void);
 
 void NET_BindVariables(void);
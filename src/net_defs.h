@@ -127,6 +127,10 @@ typedef enum
     // Add your own protocol here; be sure to add a name for it to the list
     // in net_common.c too.
 
+    // [JN] Same as above, plus NET_PACKET_TYPE_STATEHASH for comparing
+    // playsim state hashes between clients.
+    NET_PROTOCOL_INTERNATIONAL_DOOM_0,
+
     NET_NUM_PROTOCOLS,
     NET_PROTOCOL_UNKNOWN,
 } net_protocol_t;
@@ -152,6 +156,7 @@ typedef enum
     NET_PACKET_TYPE_QUERY_RESPONSE,
     NET_PACKET_TYPE_LAUNCH,
     NET_PACKET_TYPE_NAT_HOLE_PUNCH,
+    NET_PACKET_TYPE_STATEHASH,
 } net_packet_type_t;
 
 typedef enum
@@ -243,6 +248,24 @@ typedef struct
     net_ticdiff_t cmds[NET_MAXPLAYERS];
 } net_full_ticcmd_t;
 
+// [JN] Playsim state hashes of one tic, sent between clients using
+// NET_PROTOCOL_INTERNATIONAL_DOOM_0. The meaning of the words is up to
+// the game; the server only relays them. Kind NET_STATEHASH_TIC is sent
+// every tic and may be lost, other kinds are sent reliably.
+
+#define NET_STATEHASH_TIC      0
+#define NET_STATEHASH_MAXWORDS 256
+
+typedef struct
+{
+    int player;             // Sender, filled in by the server.
+    unsigned int kind;
+    unsigned int tic;
+    unsigned int start;     // Index of words[0] in a longer list.
+    unsigned int num_words;
+    unsigned int words[NET_STATEHASH_MAXWORDS];
+} net_statehash_t;
+
 // Data sent in response to server queries
 
 typedef struct
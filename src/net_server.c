@@ -1418,6 +1418,56 @@ static void NET_SV_ParseResendRequest(net_packet_t *packet, net_client_t *client
     NET_SV_SendTics(client, start, last);
 }
 
+// [JN] Relay a client's state hashes to the other clients. Only clients
+// that negotiated NET_PROTOCOL_INTERNATIONAL_DOOM_0 send them, and only
+// those clients get them.
+
+static void NET_SV_ParseStateHash(net_packet_t *packet, net_client_t *client)
+{
+    static net_statehash_t hash;
+    net_packet_t *relay;
+    int i;
+
+    if (server_state != SERVER_IN_GAME
+     || client->connection.protocol < NET_PROTOCOL_INTERNATIONAL_DOOM_0)
+    {
+        NET_Log("server: error: unexpected state hash packet");
+        return;
+    }
+
+    if (client->drone || !NET_ReadStateHash(packet, &hash))
+    {
+        NET_Log("server: error: failed to read state hash");
+        return;
+    }
+
+    hash.player = client->player_number;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (!ClientConnected(&clients[i]) || &clients[i] == client
+         || clients[i].connection.protocol < NET_PROTOCOL_INTERNATIONAL_DOOM_0)
+        {
+            continue;
+        }
+
+        if (hash.kind == NET_STATEHASH_TIC)
+        {
+            relay = NET_NewPacket(64);
+            NET_WriteInt16(relay, NET_PACKET_TYPE_STATEHASH);
+            NET_WriteStateHash(relay, &hash);
+            NET_Conn_SendPacket(&clients[i].connection, relay);
+            NET_FreePacket(relay);
+        }
+        else
+        {
+            relay = NET_Conn_NewReliable(&clients[i].connection,
+                                         NET_PACKET_TYPE_STATEHASH);
+            NET_WriteStateHash(relay, &hash);
+        }
+    }
+}
+
 // Send a response back to the client
 
 void NET_SV_SendQueryResponse(net_addr_t *addr)
@@ -1595,6 +1645,9 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
             case NET_PACKET_TYPE_GAMEDATA_RESEND:
                 NET_SV_ParseResendRequest(packet, client);
                 break;
+            case NET_PACKET_TYPE_STATEHASH:
+                NET_SV_ParseStateHash(packet, client);
+                break;
             default:
                 // unknown packet type
 
@@ -33,6 +33,7 @@ static struct
     const char *name;
 } protocol_names[] = {
     {NET_PROTOCOL_CHOCOLATE_DOOM_0, "CHOCOLATE_DOOM_0"},
+    {NET_PROTOCOL_INTERNATIONAL_DOOM_0, "INTERNATIONAL_DOOM_0"},
 };
 
 void NET_WriteConnectData(net_packet_t *packet, net_connect_data_t *data)
@@ -569,6 +570,53 @@ void NET_WritePRNGSeed(net_packet_t *packet, prng_seed_t seed)
     NET_WriteBlob(packet, seed, sizeof(prng_seed_t));
 }
 
+// [JN] The player number is sent off by one, so that -1 (not yet known,
+// when a client sends its own hashes) fits in a byte.
+
+void NET_WriteStateHash(net_packet_t *packet, net_statehash_t *hash)
+{
+    unsigned int i;
+
+    NET_WriteInt8(packet, hash->player + 1);
+    NET_WriteInt8(packet, hash->kind);
+    NET_WriteInt32(packet, hash->tic);
+    NET_WriteInt32(packet, hash->start);
+    NET_WriteInt16(packet, hash->num_words);
+
+    for (i = 0; i < hash->num_words; ++i)
+    {
+        NET_WriteInt32(packet, hash->words[i]);
+    }
+}
+
+boolean NET_ReadStateHash(net_packet_t *packet, net_statehash_t *hash)
+{
+    unsigned int player;
+    unsigned int i;
+
+    if (!NET_ReadInt8(packet, &player)
+     || !NET_ReadInt8(packet, &hash->kind)
+     || !NET_ReadInt32(packet, &hash->tic)
+     || !NET_ReadInt32(packet, &hash->start)
+     || !NET_ReadInt16(packet, &hash->num_words)
+     || hash->num_words > NET_STATEHASH_MAXWORDS)
+    {
+        return false;
+    }
+
+    hash->player = (int) player - 1;
+
+    for (i = 0; i < hash->num_words; ++i)
+    {
+        if (!NET_ReadInt32(packet, &hash->words[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static net_protocol_t ParseProtocolName(const char *name)
 {
     int i;
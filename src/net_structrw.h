@@ -47,6 +47,9 @@ boolean NET_ReadWaitData(net_packet_t *packet, net_waitdata_t *data);
 boolean NET_ReadPRNGSeed(net_packet_t *packet, prng_seed_t seed);
 void NET_WritePRNGSeed(net_packet_t *packet, prng_seed_t seed);
 
+void NET_WriteStateHash(net_packet_t *packet, net_statehash_t *hash);
+boolean NET_ReadStateHash(net_packet_t *packet, net_statehash_t *hash);
+
 // Protocol list exchange.
 net_protocol_t NET_ReadProtocol(net_packet_t *packet);
 void NET_WriteProtocol(net_packet_t *packet, net_protocol_t protocol);
@@ -28,9 +28,12 @@
 #define MINIZ_NO_ZLIB_APIS
 #include "miniz.h"
 
+#include "SDL.h"
+
 #include "i_system.h"
 #include "doomtype.h"
 #include "deh_str.h"
+#include "i_glob.h"
 #include "i_input.h"
 #include "i_swap.h"
 #include "i_video.h"
@@ -176,6 +179,16 @@ static drawpatchpx_t *const drawpatchpx_a[2][2] = {{drawpatchpx11, drawpatchpx10
 
 static fixed_t dx, dxi, dy, dyi;
 
+// [JN] Mark the screen area of a patch drawn at 320x200 coordinates.
+// One pixel of slack covers rounding and the shadow of shadowed patches.
+
+static void V_MarkPatch (int x, int y, const patch_t *patch)
+{
+    V_MarkRect((x * dx) >> FRACBITS, (y * dy) >> FRACBITS,
+               ((SHORT(patch->width) * dx) >> FRACBITS) + 1,
+               ((SHORT(patch->height) * dy) >> FRACBITS) + 1);
+}
+
 void V_DrawPatch(int x, int y, patch_t *patch)
 { 
     int count;
@@ -193,7 +206,7 @@ void V_DrawPatch(int x, int y, patch_t *patch)
     x -= SHORT(patch->leftoffset);
     x += WIDESCREENDELTA; // [crispy] horizontal widescreen offset
 
-    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+    V_MarkPatch(x, y, patch);
 
     col = 0;
     if (x < 0)
@@ -291,7 +304,7 @@ void V_DrawShadowedPatch(int x, int y, patch_t *patch)
     x -= SHORT(patch->leftoffset);
     x += WIDESCREENDELTA; // [crispy] horizontal widescreen offset
 
-    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+    V_MarkPatch(x, y, patch);
 
     col = 0;
     if (x < 0)
@@ -419,7 +432,7 @@ void V_DrawShadowedPatchOptional(int x, int y, int shadow_type, patch_t *patch)
     x -= SHORT(patch->leftoffset);
     x += WIDESCREENDELTA; // [crispy] horizontal widescreen offset
 
-    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+    V_MarkPatch(x, y, patch);
 
     col = 0;
     if (x < 0)
@@ -552,7 +565,7 @@ void V_DrawPatchFlipped(int x, int y, patch_t *patch)
     x -= SHORT(patch->leftoffset); 
     x += WIDESCREENDELTA; // [crispy] horizontal widescreen offset
 
-    V_MarkRect (x, y, SHORT(patch->width), SHORT(patch->height));
+    V_MarkPatch(x, y, patch);
 
     col = 0;
     if (x < 0)
@@ -1030,35 +1043,196 @@ void V_RestoreBuffer(void)
 // SCREEN SHOTS
 //
 
+// [JN] The image is read back on the main thread, as only it may use the
+// renderer, and then compressed and written out by a background encoder
+// thread. Capture buffers are pooled, so only a burst of more than
+// SHOTSLOTS screenshots in a row has to wait for the encoder.
+
+#define SHOTSLOTS 3
+#define MAXSHOTS  10000
+
+typedef struct
+{
+    byte  *pixels;
+    size_t size;
+    int    width;
+    int    height;
+    int    level;
+    char  *filename;
+    boolean pending;
+    unsigned int order;
+} shotslot_t;
+
+static shotslot_t shotslots[SHOTSLOTS];
+static unsigned int shotorder;
+static boolean shotinit;
+static boolean shotquit;
+static SDL_Thread *shotthread;
+static SDL_mutex *shotlock;
+static SDL_cond *shotcond;
+
+// [JN] Indexes taken by existing or pending screenshots of the current
+// format, found with one scan of the screenshot directory.
+static char shotformat[16];
+static byte shotused[MAXSHOTS];
+static int shotnext = -1;
 
 //
 // WritePNGfile
 //
 
-void WritePNGfile (char *filename)
+static void WritePNGfile (const shotslot_t *slot)
 {
-    byte *data;
-    int width, height;
     size_t png_data_size = 0;
+    void *pPNG_data = tdefl_write_image_to_png_file_in_memory_ex(slot->pixels,
+                                                                slot->width,
+                                                                slot->height,
+                                                                4,
+                                                                &png_data_size,
+                                                                slot->level,
+                                                                MZ_FALSE);
+
+    if (pPNG_data)
+    {
+        FILE *handle = M_fopen(slot->filename, "wb");
+
+        if (handle)
+        {
+            fwrite(pPNG_data, 1, png_data_size, handle);
+            fclose(handle);
+        }
 
-    I_RenderReadPixels(&data, &width, &height);
+        mz_free(pPNG_data);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// V_ScreenShotThread
+//  [JN] Encodes pending screenshots in the order they were taken.
+//  Exits once there is nothing left to write and shutdown is requested.
+// -----------------------------------------------------------------------------
+
+static int V_ScreenShotThread (void *unused)
+{
+    SDL_LockMutex(shotlock);
+
+    while (true)
     {
-        void *pPNG_data = tdefl_write_image_to_png_file_in_memory(data, width, height, 4, &png_data_size);
+        shotslot_t *slot = NULL;
 
-        if (!pPNG_data)
+        for (int i = 0 ; i < SHOTSLOTS ; i++)
         {
-            return;
+            if (shotslots[i].pending
+            && (slot == NULL || shotslots[i].order < slot->order))
+            {
+                slot = &shotslots[i];
+            }
         }
-        else
+
+        if (slot == NULL)
         {
-            FILE *handle = M_fopen(filename, "wb");
-            fwrite(pPNG_data, 1, png_data_size, handle);
-            fclose(handle);
-            mz_free(pPNG_data);
+            if (shotquit)
+            {
+                break;
+            }
+
+            SDL_CondWait(shotcond, shotlock);
+            continue;
+        }
+
+        SDL_UnlockMutex(shotlock);
+        WritePNGfile(slot);
+        SDL_LockMutex(shotlock);
+
+        free(slot->filename);
+        slot->filename = NULL;
+        slot->pending = false;
+        SDL_CondBroadcast(shotcond);
+    }
+
+    SDL_UnlockMutex(shotlock);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// V_FinishScreenShots
+//  [JN] Lets the encoder write out everything still pending before exit.
+// -----------------------------------------------------------------------------
+
+static void V_FinishScreenShots (void)
+{
+    if (shotthread == NULL)
+    {
+        return;
+    }
+
+    SDL_LockMutex(shotlock);
+    shotquit = true;
+    SDL_CondBroadcast(shotcond);
+    SDL_UnlockMutex(shotlock);
+
+    SDL_WaitThread(shotthread, NULL);
+    shotthread = NULL;
+}
+
+static void V_StartScreenShots (void)
+{
+    shotinit = true;
+    shotlock = SDL_CreateMutex();
+    shotcond = SDL_CreateCond();
+
+    if (shotlock && shotcond)
+    {
+        shotthread = SDL_CreateThread(V_ScreenShotThread, "V_ScreenShot", NULL);
+    }
+
+    if (shotthread)
+    {
+        I_AtExit(V_FinishScreenShots, true);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// V_ScanScreenShots
+//  [JN] Marks the indexes of the given format already present in the
+//  screenshot directory, instead of probing every file name in turn.
+// -----------------------------------------------------------------------------
+
+static void V_ScanScreenShots (const char *format)
+{
+    glob_t *glob;
+    const char *path;
+    char name[16];
+
+    M_StringCopy(shotformat, format, sizeof(shotformat));
+    memset(shotused, 0, sizeof(shotused));
+    shotnext = 0;
+
+    glob = I_StartGlob(screenshotdir, "*.png", GLOB_FLAG_NOCASE);
+
+    if (glob == NULL)
+    {
+        return;
+    }
+
+    while ((path = I_NextGlob(glob)) != NULL)
+    {
+        const char *base = M_BaseName(path);
+        const char *digits = base + strcspn(base, "0123456789");
+        const int i = atoi(digits);
+
+        if (*digits != '\0' && i < MAXSHOTS)
+        {
+            M_snprintf(name, sizeof(name), format, i, "png");
+
+            if (!strcasecmp(name, base))
+            {
+                shotused[i] = 1;
+            }
         }
     }
 
-    free(data);
+    I_EndGlob(glob);
 }
 
 //
@@ -1067,15 +1241,25 @@ void WritePNGfile (char *filename)
 
 void V_ScreenShot(char *format)
 {
-    int i;
     char lbmname[16]; // haleyjd 20110213: BUG FIX - 12 is too small!
-    char *file;
-    
+    char *file = NULL;
+    shotslot_t *slot;
+
+    if (shotnext < 0 || strcmp(shotformat, format))
+    {
+        V_ScanScreenShots(format);
+    }
+
     // find a file name to save it to
 
-    for (i=0; i<=9999; i++)
+    for ( ; shotnext < MAXSHOTS ; shotnext++)
     {
-        M_snprintf(lbmname, sizeof(lbmname), format, i, "png");
+        if (shotused[shotnext])
+        {
+            continue;
+        }
+
+        M_snprintf(lbmname, sizeof(lbmname), format, shotnext, "png");
         // [JN] Construct full path to screenshot file.
         file = M_StringJoin(screenshotdir, lbmname, NULL);
 
@@ -1083,14 +1267,72 @@ void V_ScreenShot(char *format)
         {
             break;      // file doesn't exist
         }
+
+        free(file);
     }
 
-    if (i == 10000)
+    if (shotnext == MAXSHOTS)
     {
         I_Error ("V_ScreenShot: Couldn't create a PNG");
     }
 
-    WritePNGfile(file);
+    shotused[shotnext++] = 1;
+
+    if (!shotinit)
+    {
+        V_StartScreenShots();
+    }
+
+    // [JN] Without an encoder thread, write the screenshot right away.
+    if (shotthread == NULL)
+    {
+        slot = &shotslots[0];
+        I_RenderReadPixels(&slot->pixels, &slot->size,
+                           &slot->width, &slot->height);
+        slot->level = vid_screenshot_fast ? MZ_BEST_SPEED : MZ_DEFAULT_LEVEL;
+        slot->filename = file;
+        WritePNGfile(slot);
+        free(file);
+        slot->filename = NULL;
+        return;
+    }
+
+    // [JN] Take a free capture buffer, or wait until the encoder frees one.
+    SDL_LockMutex(shotlock);
+
+    while (true)
+    {
+        slot = NULL;
+
+        for (int i = 0 ; i < SHOTSLOTS && slot == NULL ; i++)
+        {
+            if (!shotslots[i].pending)
+            {
+                slot = &shotslots[i];
+            }
+        }
+
+        if (slot)
+        {
+            break;
+        }
+
+        SDL_CondWait(shotcond, shotlock);
+    }
+
+    SDL_UnlockMutex(shotlock);
+
+    // The encoder doesn't touch slots that aren't pending.
+    I_RenderReadPixels(&slot->pixels, &slot->size,
+                       &slot->width, &slot->height);
+    slot->level = vid_screenshot_fast ? MZ_BEST_SPEED : MZ_DEFAULT_LEVEL;
+
+    SDL_LockMutex(shotlock);
+    slot->filename = file;
+    slot->order = shotorder++;
+    slot->pending = true;
+    SDL_CondBroadcast(shotcond);
+    SDL_UnlockMutex(shotlock);
 }
 
 #define MOUSE_SPEED_BOX_WIDTH  120
@@ -18,6 +18,7 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 
 #include "config.h"
 
@@ -41,8 +42,17 @@ static wad_file_class_t *wad_file_classes[] =
 wad_file_t *W_OpenFile(const char *path)
 {
     wad_file_t *result;
+    size_t length = strlen(path);
     int i;
 
+    // [JN] ZIP/PK3 archives have their own class.
+
+    if (length > 4 && (!strcasecmp(path + length - 4, ".pk3")
+                    || !strcasecmp(path + length - 4, ".zip")))
+    {
+        return zip_wad_file.OpenFile(path);
+    }
+
     //!
     // @category obscure
     //
@@ -38,10 +38,15 @@ typedef struct
     // provided buffer.  Returns the number of bytes read.
     size_t (*Read)(wad_file_t *file, unsigned int offset,
                    void *buffer, size_t buffer_len);
+
+    // [JN] Archives only: return the data of the entry at the given
+    // position if it can be used in place, or NULL if it has to be read.
+    byte *(*MapEntry)(wad_file_t *file, unsigned int offset);
 } wad_file_class_t;
 
 
 extern wad_file_class_t stdc_wad_file;
+extern wad_file_class_t zip_wad_file;
 
 #ifdef _WIN32
 extern wad_file_class_t win32_wad_file;
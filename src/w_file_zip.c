@@ -0,0 +1,370 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+// Copyright(C) 2016-2025 Julia Nechaevskaya
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	WAD I/O functions for ZIP/PK3 archives.
+//	Archive entries are presented as lumps: the "position" of a lump
+//	is the index of its entry, and reading it decompresses the entry.
+//
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "miniz.h"
+
+#include "i_swap.h"
+#include "m_misc.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+typedef struct
+{
+    wad_file_t wad;
+    mz_zip_archive zip;
+
+    // Whole archive mapped into memory, or NULL.
+    byte *map;
+    size_t maplength;
+
+    // Data of stored entries inside the mapping, filled in on first use.
+    byte **entries;
+} zip_wad_file_t;
+
+// Marks entries that can't be served from the mapping.
+static byte notmapped;
+
+// Folders that become lump namespaces, in directory order.
+// Entries in any other folder are ignored.
+static const struct
+{
+    const char *folder;
+    const char *start;
+    const char *end;
+} namespaces[] =
+{
+    { "",         NULL,      NULL    },
+    { "sounds",   NULL,      NULL    },
+    { "music",    NULL,      NULL    },
+    { "graphics", NULL,      NULL    },
+    { "sprites",  "S_START", "S_END" },
+    { "flats",    "F_START", "F_END" },
+    { "patches",  "P_START", "P_END" },
+};
+
+static wad_file_t *W_ZIP_OpenFile(const char *path)
+{
+    zip_wad_file_t *result;
+    mz_bool ok;
+
+    result = Z_Malloc(sizeof(zip_wad_file_t), PU_STATIC, 0);
+    memset(result, 0, sizeof(*result));
+    result->wad.file_class = &zip_wad_file;
+    result->wad.mapped = NULL;
+
+#ifdef HAVE_SYS_MMAN_H
+    {
+        const int handle = open(path, O_RDONLY);
+
+        if (handle >= 0)
+        {
+            const off_t length = lseek(handle, 0, SEEK_END);
+            void *map = mmap(NULL, length, PROT_READ|PROT_WRITE,
+                             MAP_PRIVATE, handle, 0);
+
+            if (map != MAP_FAILED)
+            {
+                result->map = map;
+                result->maplength = length;
+            }
+
+            close(handle);
+        }
+    }
+#endif
+
+    if (result->map != NULL)
+    {
+        ok = mz_zip_reader_init_mem(&result->zip, result->map,
+                                    result->maplength, 0);
+    }
+    else
+    {
+        ok = mz_zip_reader_init_file(&result->zip, path, 0);
+    }
+
+    if (!ok)
+    {
+#ifdef HAVE_SYS_MMAN_H
+        if (result->map != NULL)
+        {
+            munmap(result->map, result->maplength);
+        }
+#endif
+        Z_Free(result);
+        return NULL;
+    }
+
+    result->wad.length = result->zip.m_archive_size;
+    result->wad.path = M_StringDuplicate(path);
+    result->entries = calloc(mz_zip_reader_get_num_files(&result->zip),
+                             sizeof(*result->entries));
+
+    return &result->wad;
+}
+
+static void W_ZIP_CloseFile(wad_file_t *wad)
+{
+    zip_wad_file_t *zip_wad = (zip_wad_file_t *) wad;
+
+    mz_zip_reader_end(&zip_wad->zip);
+
+#ifdef HAVE_SYS_MMAN_H
+    if (zip_wad->map != NULL)
+    {
+        munmap(zip_wad->map, zip_wad->maplength);
+    }
+#endif
+
+    free(zip_wad->entries);
+    Z_Free(zip_wad);
+}
+
+// Decompress the entry with the given index into the provided buffer,
+// which must hold all of it. Returns the number of bytes read.
+
+static size_t W_ZIP_Read(wad_file_t *wad, unsigned int offset,
+                         void *buffer, size_t buffer_len)
+{
+    zip_wad_file_t *zip_wad = (zip_wad_file_t *) wad;
+
+    if (buffer_len == 0
+     || offset >= mz_zip_reader_get_num_files(&zip_wad->zip)
+     || !mz_zip_reader_extract_to_mem(&zip_wad->zip, offset,
+                                      buffer, buffer_len, 0))
+    {
+        return 0;
+    }
+
+    return buffer_len;
+}
+
+// Entries stored without compression are returned straight from the
+// mapped archive, without a copy.
+
+static byte *W_ZIP_MapEntry(wad_file_t *wad, unsigned int offset)
+{
+    zip_wad_file_t *zip_wad = (zip_wad_file_t *) wad;
+    mz_zip_archive_file_stat stat;
+    const byte *header;
+
+    if (zip_wad->map == NULL
+     || offset >= mz_zip_reader_get_num_files(&zip_wad->zip))
+    {
+        return NULL;
+    }
+
+    if (zip_wad->entries[offset] != NULL)
+    {
+        return zip_wad->entries[offset] == &notmapped ?
+               NULL : zip_wad->entries[offset];
+    }
+
+    zip_wad->entries[offset] = &notmapped;
+
+    if (!mz_zip_reader_file_stat(&zip_wad->zip, offset, &stat)
+     || stat.m_method != 0
+     || stat.m_local_header_ofs + 30 > zip_wad->maplength)
+    {
+        return NULL;
+    }
+
+    // The data follows the local header and its variable length fields.
+    header = zip_wad->map + stat.m_local_header_ofs;
+
+    if (header[0] == 'P' && header[1] == 'K' && header[2] == 3 && header[3] == 4)
+    {
+        const size_t start = stat.m_local_header_ofs + 30
+                           + (header[26] | (header[27] << 8))
+                           + (header[28] | (header[29] << 8));
+
+        if (start + stat.m_uncomp_size <= zip_wad->maplength)
+        {
+            zip_wad->entries[offset] = zip_wad->map + start;
+        }
+    }
+
+    return zip_wad->entries[offset] == &notmapped ?
+           NULL : zip_wad->entries[offset];
+}
+
+// Lump name from the file name of an entry: no folders, no extension,
+// upper case, at most eight characters.
+
+static boolean W_ZIP_LumpName(const char *path, char *name)
+{
+    const char *base = strrchr(path, '/');
+    const char *ext;
+    int length = 0;
+
+    base = base ? base + 1 : path;
+    ext = strrchr(base, '.');
+
+    // Nested WADs and archives can't be presented as single lumps.
+    if (ext && (!strcasecmp(ext, ".wad") || !strcasecmp(ext, ".pk3")
+             || !strcasecmp(ext, ".zip")))
+    {
+        printf("W_ZIP_ReadDirectory: skipping nested archive %s\n", path);
+        return false;
+    }
+
+    memset(name, 0, 8);
+
+    while (base[length] != '\0' && base + length != ext && length < 8)
+    {
+        name[length] = toupper((int)base[length]);
+        length++;
+    }
+
+    return length > 0;
+}
+
+static int W_ZIP_Namespace(const char *path)
+{
+    const char *slash = strchr(path, '/');
+
+    if (slash == NULL)
+    {
+        return 0;
+    }
+
+    for (int i = 1; i < arrlen(namespaces); i++)
+    {
+        const size_t length = strlen(namespaces[i].folder);
+
+        if (slash - path == (ptrdiff_t)length
+         && !strncasecmp(path, namespaces[i].folder, length))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Build a WAD directory for the archive: entries of the root and the
+// global folders first, then every namespace folder between its markers.
+// Returns the number of lumps in the Z_Malloc'd directory.
+
+int W_ZIP_ReadDirectory(wad_file_t *wad, filelump_t **directory)
+{
+    zip_wad_file_t *zip_wad = (zip_wad_file_t *) wad;
+    const unsigned int numfiles = mz_zip_reader_get_num_files(&zip_wad->zip);
+    signed char *filens = malloc(numfiles + 1);
+    filelump_t *lumps, *lump_p;
+    char path[1024];
+    int numlumps = 0;
+
+    for (unsigned int i = 0; i < numfiles; i++)
+    {
+        char name[8];
+
+        filens[i] = -1;
+
+        if (mz_zip_reader_is_file_a_directory(&zip_wad->zip, i))
+        {
+            continue;
+        }
+
+        mz_zip_reader_get_filename(&zip_wad->zip, i, path, sizeof(path));
+
+        if (W_ZIP_LumpName(path, name))
+        {
+            filens[i] = W_ZIP_Namespace(path);
+            numlumps += filens[i] >= 0;
+        }
+    }
+
+    // Room for every lump plus the namespace markers.
+    lumps = Z_Malloc((numlumps + 2 * arrlen(namespaces)) * sizeof(filelump_t),
+                     PU_STATIC, 0);
+    lump_p = lumps;
+
+    for (int ns = 0; ns < arrlen(namespaces); ns++)
+    {
+        filelump_t *start = lump_p;
+
+        if (namespaces[ns].start)
+        {
+            memset(lump_p, 0, sizeof(*lump_p));
+            strncpy(lump_p->name, namespaces[ns].start, 8);
+            lump_p->filepos = LONG(-1);
+            lump_p++;
+        }
+
+        for (unsigned int i = 0; i < numfiles; i++)
+        {
+            mz_zip_archive_file_stat stat;
+
+            if (filens[i] != ns
+             || !mz_zip_reader_file_stat(&zip_wad->zip, i, &stat))
+            {
+                continue;
+            }
+
+            W_ZIP_LumpName(stat.m_filename, lump_p->name);
+            lump_p->filepos = LONG(i);
+            lump_p->size = LONG((int)stat.m_uncomp_size);
+            lump_p++;
+        }
+
+        if (namespaces[ns].start)
+        {
+            if (lump_p == start + 1)
+            {
+                // Empty namespace, drop its start marker again.
+                lump_p = start;
+                continue;
+            }
+
+            memset(lump_p, 0, sizeof(*lump_p));
+            strncpy(lump_p->name, namespaces[ns].end, 8);
+            lump_p->filepos = LONG(-1);
+            lump_p++;
+        }
+    }
+
+    free(filens);
+
+    *directory = lumps;
+    return lump_p - lumps;
+}
+
+wad_file_class_t zip_wad_file =
+{
+    W_ZIP_OpenFile,
+    W_ZIP_CloseFile,
+    W_ZIP_Read,
+    W_ZIP_MapEntry,
+};
@@ -29,7 +29,9 @@
 
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_timer.h"
 #include "i_video.h"
+#include "m_argv.h"
 #include "m_misc.h"
 #include "v_diskicon.h"
 #include "z_zone.h"
@@ -44,8 +46,55 @@
 lumpinfo_t **lumpinfo;
 unsigned int numlumps = 0;
 
-// Hash table for fast lookups
+// [JN] Directory of packed, upper-cased lump names parallel to lumpinfo[],
+// and an open-addressed table of lump numbers over it. Both are rebuilt
+// by W_GenerateHashTable() whenever the directory changes.
+static uint64_t *lumpnames;
 static lumpindex_t *lumphash;
+static unsigned int lumphash_mask;
+static unsigned int lumphash_shift;
+
+// [JN] Indexes over namespace ranges of the directory, built on request
+// by W_HashNumForNameFromTo() and dropped whenever the directory changes.
+#define NUMNAMESPACES 4
+
+typedef struct
+{
+    lumpindex_t first, last;
+    lumpindex_t *table;
+    unsigned int mask;
+    unsigned int shift;
+} nsindex_t;
+
+static nsindex_t nsindex[NUMNAMESPACES];
+static int numnsindex;
+
+// [JN] Lookup statistics, only gathered during startup and reported at
+// its end, by W_PrintLookupStats().
+static boolean lookupstats = true;
+static unsigned int lookups, lookupmisses, lookupprobes;
+static uint64_t lookuptime, hashtime;
+
+// [JN] Free the name directory with everything indexed over it, so that
+// no lookup probes lump numbers of a directory that has changed.
+static void W_FreeHashTables (void)
+{
+    for (int i = 0; i < numnsindex; i++)
+    {
+        Z_Free(nsindex[i].table);
+        nsindex[i].table = NULL;
+    }
+
+    numnsindex = 0;
+
+    if (lumphash != NULL)
+    {
+        Z_Free(lumphash);
+        Z_Free(lumpnames);
+        lumphash = NULL;
+        lumpnames = NULL;
+    }
+}
 
 // Variables for the reload hack: filename of the PWAD to reload, and the
 // lumps from WADs before the reload file, so we can resent numlumps and
@@ -88,6 +137,27 @@ unsigned int W_LumpNameHash(const char *s)
     return result;
 }
 
+// [JN] Pack a lump name into 8 upper-cased bytes, zero padded,
+// so two names compare equal with a single integer comparison.
+static inline uint64_t W_LumpNameKey (const char *s)
+{
+    byte c[8] = {0};
+    uint64_t key;
+
+    for (int i = 0; i < 8 && s[i] != '\0'; ++i)
+    {
+        c[i] = toupper(s[i]);
+    }
+
+    memcpy(&key, c, sizeof(key));
+    return key;
+}
+
+static inline unsigned int W_KeySlot (uint64_t key, unsigned int shift)
+{
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
 //
 // LUMP BASED ROUTINES.
 //
@@ -141,7 +211,13 @@ wad_file_t *W_AddFile (const char *filename)
 	return NULL;
     }
 
-    if (strcasecmp(filename+strlen(filename)-3 , "wad" ) )
+    if (wad_file->file_class == &zip_wad_file)
+    {
+        // [JN] ZIP/PK3 archive, its entries become lumps.
+
+        numfilelumps = W_ZIP_ReadDirectory(wad_file, &fileinfo);
+    }
+    else if (strcasecmp(filename+strlen(filename)-3 , "wad" ) )
     {
 	// single lump file
 
@@ -226,11 +302,7 @@ wad_file_t *W_AddFile (const char *filename)
 
     Z_Free(fileinfo);
 
-    if (lumphash != NULL)
-    {
-        Z_Free(lumphash);
-        lumphash = NULL;
-    }
+    W_FreeHashTables();
 
     // If this is the reload file, we need to save some details about the
     // file so that we can close it later on when we do a reload.
@@ -264,23 +336,29 @@ int W_NumLumps (void)
 
 lumpindex_t W_CheckNumForName(const char *name)
 {
+    const uint64_t starttime = lookupstats ? I_GetTimeUS() : 0;
     lumpindex_t i;
 
+    lookups++;
+
     // Do we have a hash table yet?
 
     if (lumphash != NULL)
     {
-        int hash;
+        const uint64_t key = W_LumpNameKey(name);
+        unsigned int hash;
 
         // We do! Excellent.
 
-        hash = W_LumpNameHash(name) % numlumps;
-
-        for (i = lumphash[hash]; i != -1; i = lumpinfo[i]->next)
+        for (hash = W_KeySlot(key, lumphash_shift);
+             (i = lumphash[hash]) != -1;
+             hash = (hash + 1) & lumphash_mask)
         {
-            if (!strncasecmp(lumpinfo[i]->name, name, 8))
+            lookupprobes++;
+
+            if (lumpnames[i] == key)
             {
-                return i;
+                break;
             }
         }
     }
@@ -294,14 +372,24 @@ lumpindex_t W_CheckNumForName(const char *name)
         {
             if (!strncasecmp(lumpinfo[i]->name, name, 8))
             {
-                return i;
+                break;
             }
         }
     }
 
     // TFB. Not found.
 
-    return -1;
+    if (i < 0)
+    {
+        lookupmisses++;
+    }
+
+    if (lookupstats)
+    {
+        lookuptime += I_GetTimeUS() - starttime;
+    }
+
+    return i;
 }
 
 // -----------------------------------------------------------------------------
@@ -345,69 +433,152 @@ lumpindex_t W_GetNumForName(const char *name)
 
 // -----------------------------------------------------------------------------
 // W_HashNumForNameFromTo and W_CheckNumForNameFromTo
-//  [PN/JN] Optimized flat lookup with hash.
-//  Builds a one-time open-addressing hash table for the [from, to] range,
-//  using lump name hash modulo the range size. Collision resolution is linear.
-//  This replaces linear search for flat lumps with near-O(1) lookup.
+//  [PN/JN] Optimized namespace lookup with hash.
+//  Builds an open-addressing table over the packed names of the [from, to]
+//  range, so lookups limited to a namespace never rescan it. Up to
+//  NUMNAMESPACES ranges are indexed at once. Only flats are looked up
+//  within their namespace: sprite frames are matched by their prefix
+//  while scanning S_START/S_END once, and patches resolve through the
+//  global table, so that PWAD patches outside P_START/P_END still win.
 // -----------------------------------------------------------------------------
 
-static lumpindex_t *flat_hash = NULL;
-static int hash_size = 0;
+static nsindex_t *W_FindNamespace (lumpindex_t first, lumpindex_t last)
+{
+    for (int i = 0; i < numnsindex; i++)
+    {
+        if (nsindex[i].first == first && nsindex[i].last == last)
+        {
+            return &nsindex[i];
+        }
+    }
+
+    return NULL;
+}
 
 void W_HashNumForNameFromTo (int from, int to, int size)
 {
-    // Compute number of entries in the range
-    hash_size = size;
+    const lumpindex_t first = MIN(from, to);
+    const lumpindex_t last = MAX(from, to);
+    nsindex_t *ns = W_FindNamespace(first, last);
+    unsigned int bits = 1;
+
+    if (lumpnames == NULL)
+    {
+        W_GenerateHashTable();
+    }
+
+    if (ns == NULL)
+    {
+        // Reuse the last slot when all of them are taken
+        ns = &nsindex[numnsindex < NUMNAMESPACES ? numnsindex++ : NUMNAMESPACES - 1];
+    }
 
-    // Allocate hash table (statically sized to the range)
-    flat_hash = Z_Malloc(sizeof(lumpindex_t) * hash_size, PU_STATIC, NULL);
+    if (ns->table != NULL)
+    {
+        Z_Free(ns->table);
+    }
+
+    // Keep the table at most half full
+    size = MAX(size, last - first + 1);
+    while ((1u << bits) < 2u * size)
+    {
+        bits++;
+    }
 
-    // Initialize all entries to -1 (empty)
-    for (int i = 0; i < hash_size; i++)
-        flat_hash[i] = -1;
+    ns->first = first;
+    ns->last = last;
+    ns->mask = (1u << bits) - 1;
+    ns->shift = 64 - bits;
+    ns->table = Z_Malloc(sizeof(lumpindex_t) << bits, PU_STATIC, NULL);
+    memset(ns->table, -1, sizeof(lumpindex_t) << bits);
 
-    // Fill the table with all lump names in the range
-    // Use open addressing for collision resolution
-    for (int i = from; i <= to; i++)
+    // Later lumps replace earlier ones of the same name
+    for (lumpindex_t i = first; i <= last; i++)
     {
-        int h = W_LumpNameHash(lumpinfo[i]->name) % hash_size;
+        unsigned int h = W_KeySlot(lumpnames[i], ns->shift);
 
-        while (flat_hash[h] != -1)
-            h = (h + 1) % hash_size;
+        while (ns->table[h] != -1 && lumpnames[ns->table[h]] != lumpnames[i])
+        {
+            h = (h + 1) & ns->mask;
+        }
 
-        flat_hash[h] = i;
+        ns->table[h] = i;
     }
 }
 
 lumpindex_t W_CheckNumForNameFromTo(const char *name, int from, int to)
 {
-    // Lookup using same hash function
-    int hash = W_LumpNameHash(name) % hash_size;
+    const uint64_t starttime = lookupstats ? I_GetTimeUS() : 0;
+    const lumpindex_t first = MIN(from, to);
+    const lumpindex_t last = MAX(from, to);
+    const nsindex_t *ns = W_FindNamespace(first, last);
+    lumpindex_t i = -1;
 
-    // Probe the table using open addressing
-    for (int probes = 0; probes < hash_size; probes++)
-    {
-        lumpindex_t i = flat_hash[hash];
+    lookups++;
 
-        if (i == -1)
-            break;
+    if (ns != NULL)
+    {
+        const uint64_t key = W_LumpNameKey(name);
 
-        if (!strncasecmp(lumpinfo[i]->name, name, 8))
-            return i;
+        // Probe the table using open addressing
+        for (unsigned int h = W_KeySlot(key, ns->shift);
+             (i = ns->table[h]) != -1;
+             h = (h + 1) & ns->mask)
+        {
+            lookupprobes++;
 
-        hash = (hash + 1) % hash_size;
+            if (lumpnames[i] == key)
+            {
+                break;
+            }
+        }
     }
-    
-    // Fallback: brute-force scan (should never happen)
-    for (int i = from; i >= to; i--)
+    else
     {
-        if (!strncasecmp(lumpinfo[i]->name, name, 8))
+        // Fallback: brute-force scan of a range that isn't indexed
+        for (i = last; i >= first; i--)
+        {
+            if (!strncasecmp(lumpinfo[i]->name, name, 8))
+            {
+                break;
+            }
+        }
+
+        if (i < first)
         {
-            return i;
+            i = -1;
         }
     }
 
-    return -1;
+    if (i < 0)
+    {
+        lookupmisses++;
+    }
+
+    if (lookupstats)
+    {
+        lookuptime += I_GetTimeUS() - starttime;
+    }
+
+    return i;
+}
+
+// -----------------------------------------------------------------------------
+// W_PrintLookupStats
+//  [JN] Report lump name lookups done so far, called at the end of startup,
+//  and stop timing them.
+// -----------------------------------------------------------------------------
+
+void W_PrintLookupStats (void)
+{
+    printf("W_Init: %u lump lookups (%u misses, %.2f probes each) "
+           "in %d us, index built in %d us.\n",
+           lookups, lookupmisses,
+           lookups ? (double)lookupprobes / lookups : 0.0,
+           (int)lookuptime, (int)hashtime);
+
+    // Lookups made from now on aren't timed.
+    lookupstats = false;
 }
 
 //
@@ -457,6 +628,85 @@ void W_ReadLump(lumpindex_t lump, void *dest)
 
 
 
+// -----------------------------------------------------------------------------
+// Archive lump cache
+//  [JN] Lumps decompressed from ZIP/PK3 archives are cached in the zone like
+//  any other lump, but their total size is bounded: past the budget, the
+//  least recently used ones that are not in use are freed.
+// -----------------------------------------------------------------------------
+
+static lumpinfo_t *lru_head, *lru_tail;
+static int lru_resident;
+static int lru_budget = -1;
+
+static void W_UnlinkArchiveLump(lumpinfo_t *lump)
+{
+    if (lump != lru_head && lump->lru_prev == NULL)
+    {
+        return;
+    }
+
+    if (lump->lru_prev)
+        lump->lru_prev->lru_next = lump->lru_next;
+    else
+        lru_head = lump->lru_next;
+
+    if (lump->lru_next)
+        lump->lru_next->lru_prev = lump->lru_prev;
+    else
+        lru_tail = lump->lru_prev;
+
+    lump->lru_prev = lump->lru_next = NULL;
+    lru_resident -= lump->size;
+}
+
+static void W_TouchArchiveLump(lumpinfo_t *lump, int tag)
+{
+    lumpinfo_t *l, *next;
+
+    if (lru_budget < 0)
+    {
+        //!
+        // @arg <mb>
+        // @category obscure
+        //
+        // Memory budget in MiB for lumps decompressed from ZIP/PK3
+        // archives. Default is 64.
+        //
+
+        const int p = M_CheckParmWithArgs("-zipcache", 1);
+
+        lru_budget = (p ? MAX(atoi(myargv[p + 1]), 1) : 64) << 20;
+    }
+
+    // Move to the most recently used end.
+    W_UnlinkArchiveLump(lump);
+    lump->lru_prev = lru_tail;
+    if (lru_tail)
+        lru_tail->lru_next = lump;
+    else
+        lru_head = lump;
+    lru_tail = lump;
+    lru_resident += lump->size;
+    lump->cache_tag = tag;
+
+    for (l = lru_head; l != lump && lru_resident > lru_budget; l = next)
+    {
+        next = l->lru_next;
+
+        // Purged by the zone already, or not in use.
+        if (l->cache == NULL || l->cache_tag >= PU_PURGELEVEL)
+        {
+            if (l->cache != NULL)
+            {
+                Z_Free(l->cache);
+            }
+
+            W_UnlinkArchiveLump(l);
+        }
+    }
+}
+
 //
 // W_CacheLumpNum
 //
@@ -492,12 +742,23 @@ void *W_CacheLumpNum(lumpindex_t lumpnum, int tag)
 
         result = lump->wad_file->mapped + lump->position;
     }
+    else if (lump->wad_file->file_class->MapEntry != NULL
+          && (result = lump->wad_file->file_class->MapEntry(lump->wad_file,
+                                                            lump->position)))
+    {
+        // [JN] Archive entry stored uncompressed in a mapped file.
+    }
     else if (lump->cache != NULL)
     {
         // Already cached, so just switch the zone tag.
 
         result = lump->cache;
         Z_ChangeTag(lump->cache, tag);
+
+        if (lump->wad_file->file_class->MapEntry != NULL)
+        {
+            W_TouchArchiveLump(lump, tag);
+        }
     }
     else
     {
@@ -506,6 +767,11 @@ void *W_CacheLumpNum(lumpindex_t lumpnum, int tag)
         lump->cache = Z_Malloc(W_LumpLength(lumpnum), tag, &lump->cache);
 	W_ReadLump (lumpnum, lump->cache);
         result = lump->cache;
+
+        if (lump->wad_file->file_class->MapEntry != NULL)
+        {
+            W_TouchArchiveLump(lump, tag);
+        }
     }
 	
     return result;
@@ -542,13 +808,15 @@ void W_ReleaseLumpNum(lumpindex_t lumpnum)
 
     lump = lumpinfo[lumpnum];
 
-    if (lump->wad_file->mapped != NULL)
+    if (lump->wad_file->mapped != NULL || lump->cache == NULL)
     {
-        // Memory-mapped file, so nothing needs to be done here.
+        // Memory-mapped file or archive entry, so nothing needs to be
+        // done here.
     }
     else
     {
         Z_ChangeTag(lump->cache, PU_CACHE);
+        lump->cache_tag = PU_CACHE;
     }
 }
 
@@ -627,37 +895,56 @@ void W_Profile (void)
 
 void W_GenerateHashTable(void)
 {
+    const uint64_t starttime = lookupstats ? I_GetTimeUS() : 0;
     lumpindex_t i;
+    unsigned int bits = 1;
 
     // Free the old hash table, if there is one:
-    if (lumphash != NULL)
-    {
-        Z_Free(lumphash);
-    }
+    W_FreeHashTables();
 
     // Generate hash table
     if (numlumps > 0)
     {
-        lumphash = Z_Malloc(sizeof(lumpindex_t) * numlumps, PU_STATIC, NULL);
+        // Pack all names into one contiguous array
+        lumpnames = Z_Malloc(sizeof(*lumpnames) * numlumps, PU_STATIC, NULL);
 
         for (i = 0; i < numlumps; ++i)
         {
-            lumphash[i] = -1;
+            lumpnames[i] = W_LumpNameKey(lumpinfo[i]->name);
         }
 
+        // Power of two size, at most half full
+        while ((1u << bits) < 2 * numlumps)
+        {
+            bits++;
+        }
+
+        lumphash_mask = (1u << bits) - 1;
+        lumphash_shift = 64 - bits;
+        lumphash = Z_Malloc(sizeof(lumpindex_t) << bits, PU_STATIC, NULL);
+        memset(lumphash, -1, sizeof(lumpindex_t) << bits);
+
         for (i = 0; i < numlumps; ++i)
         {
-            unsigned int hash;
+            unsigned int hash = W_KeySlot(lumpnames[i], lumphash_shift);
 
-            hash = W_LumpNameHash(lumpinfo[i]->name) % numlumps;
+            // Hook into the hash table. Each name has a single slot,
+            // taken over by later lumps so that PWADs take precedence.
 
-            // Hook into the hash table
+            while (lumphash[hash] != -1 && lumpnames[lumphash[hash]] != lumpnames[i])
+            {
+                hash = (hash + 1) & lumphash_mask;
+            }
 
-            lumpinfo[i]->next = lumphash[hash];
             lumphash[hash] = i;
         }
     }
 
+    if (lookupstats)
+    {
+        hashtime += I_GetTimeUS() - starttime;
+    }
+
     // All done!
 }
 
@@ -680,6 +967,8 @@ void W_Reload(void)
     // We must free any lumps being cached from the PWAD we're about to reload:
     for (i = reloadlump; i < numlumps; ++i)
     {
+        W_UnlinkArchiveLump(lumpinfo[i]);
+
         if (lumpinfo[i]->cache != NULL)
         {
             Z_Free(lumpinfo[i]->cache);
@@ -62,8 +62,9 @@ struct lumpinfo_s
     int		size;
     void       *cache;
 
-    // Used for hash table lookups
-    lumpindex_t next;
+    // [JN] Decompressed archive lumps: LRU chain and zone tag of the cache.
+    lumpinfo_t *lru_prev, *lru_next;
+    int         cache_tag;
 };
 
 
@@ -71,6 +72,7 @@ extern lumpinfo_t **lumpinfo;
 extern unsigned int numlumps;
 
 wad_file_t *W_AddFile(const char *filename);
+int W_ZIP_ReadDirectory(wad_file_t *wad, filelump_t **directory);
 void W_Reload(void);
 
 int W_CheckMultipleLumps (char *name);
@@ -86,6 +88,7 @@ void *W_CacheLumpNum(lumpindex_t lump, int tag);
 void *W_CacheLumpName(const char *name, int tag);
 
 void W_GenerateHashTable(void);
+void W_PrintLookupStats(void);
 
 extern unsigned int W_LumpNameHash(const char *s);
 